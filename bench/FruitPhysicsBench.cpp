@@ -0,0 +1,132 @@
+/**
+ *  Headless fruit physics benchmark.
+ *
+ *  Spawns a seeded batch of fruit over the terrain, steps it for a number of frames while
+ *  recording every frame to a binary trace, then replays the trace from its first frame and
+ *  checks that stepping reproduces every recorded frame bit for bit.
+ *
+ *  Usage: fruitphysics [--seed N] [--fruit N] [--frames N] [--trace FILE]
+ *  Exits non-zero if the replay diverges from the recording.
+ */
+
+#include "trees/FruitSimulation.h"
+#include "trees/FruitTrace.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+    unsigned int seed = 1;
+    int numFruit = 1000;
+    int numFrames = 600;
+    std::string traceFile = "fruit.trace";
+};
+
+static bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--seed") && hasValue) {
+            options.seed = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--fruit") && hasValue) {
+            options.numFruit = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--frames") && hasValue) {
+            options.numFrames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--trace") && hasValue) {
+            options.traceFile = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--seed N] [--fruit N] [--frames N] [--trace FILE]" << std::endl;
+            return false;
+        }
+    }
+    return options.numFruit > 0 && options.numFrames > 0;
+}
+
+/** Step the simulation, writing every frame to the trace. Only the physics steps are timed. */
+static bool record(const BenchOptions &options, double &stepSeconds) {
+    FruitSimulation simulation;
+    simulation.spawnFruit(options.seed, options.numFruit);
+
+    FruitTraceWriter writer(options.traceFile);
+    if (!writer.begin(options.seed, simulation) || !writer.writeFrame(simulation)) {
+        return false;
+    }
+
+    stepSeconds = 0.0;
+    for (int frame = 0; frame < options.numFrames; frame++) {
+        auto start = std::chrono::steady_clock::now();
+        simulation.step();
+        stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!writer.writeFrame(simulation)) {
+            return false;
+        }
+    }
+    return writer.finish();
+}
+
+/** Restore frame 0 from the trace, step, and compare against each following recorded frame */
+static bool replay(const BenchOptions &options) {
+    FruitTraceReader reader(options.traceFile);
+    if (!reader.open()) {
+        return false;
+    }
+
+    FruitSimulation simulation;
+    for (float fruitScale : reader.getScales()) {
+        simulation.addFruit(glm::scale(glm::vec3(fruitScale)));
+    }
+
+    std::vector<FruitTraceState> recorded;
+    std::vector<FruitTraceState> replayed;
+    if (!reader.readFrame(recorded)) {
+        std::cerr << options.traceFile << " has no frames" << std::endl;
+        return false;
+    }
+    restoreFrame(simulation, recorded);
+
+    for (unsigned int frame = 1; frame < reader.getHeader().numFrames; frame++) {
+        if (!reader.readFrame(recorded)) {
+            std::cerr << options.traceFile << " is truncated at frame " << frame << std::endl;
+            return false;
+        }
+        simulation.step();
+        captureFrame(simulation, replayed);
+        for (int i = 0; i < simulation.getNumFruit(); i++) {
+            if (!(replayed[i] == recorded[i])) {
+                std::cerr << "replay diverged at frame " << frame << ", fruit " << i << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    double stepSeconds = 0.0;
+    if (!record(options, stepSeconds)) {
+        std::cerr << "recording " << options.traceFile << " failed" << std::endl;
+        return 1;
+    }
+
+    double stepsPerSecond = options.numFrames / stepSeconds;
+    std::cout << "seed " << options.seed << ", " << options.numFruit << " fruit, "
+              << options.numFrames << " frames" << std::endl;
+    std::cout << "  " << stepsPerSecond << " steps/s, "
+              << stepsPerSecond * options.numFruit << " fruit-steps/s" << std::endl;
+
+    if (!replay(options)) {
+        std::cout << "  replay: MISMATCH" << std::endl;
+        return 1;
+    }
+    std::cout << "  replay: bit-exact" << std::endl;
+    return 0;
+}
@@ -0,0 +1,257 @@
+/**
+ *  Headless ray-primitive intersection benchmark.
+ *
+ *  Scatters a seeded set of transformed cubes, cones, cylinders and spheres, then finds the
+ *  nearest hit for a batch of random rays three ways:
+ *    per-ray inverse  the CTM is inverted for every primitive on every ray, as RayScene did
+ *                     before it baked RayPrimitive records
+ *    baked linear     every baked record is tested, with no matrix inversions
+ *    baked BVH        the baked records are tested through the BVH
+ *  and reports rays per second for each. All three must agree on every hit. The same rays are
+ *  then traced as shadow rays, comparing the any-hit occlusion query against using the
+ *  nearest hit to decide occlusion. Finally a grid of coherent camera rays is traced one at a
+ *  time and in 2x2 packets through the BVH.
+ *
+ *  Usage: rayintersection [--seed N] [--primitives N] [--rays N]
+ *  Exits non-zero if any of the methods disagree.
+ */
+
+#include "scenegraph/RayPrimitives.h"
+
+#include "glm/gtx/transform.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct BenchOptions {
+    unsigned int seed = 1;
+    int numPrimitives = 2000;
+    int numRays = 20000;
+};
+
+// Primitives are scattered over [-sceneExtent, sceneExtent]^3
+const float sceneExtent = 20.f;
+
+static bool parseOptions(int argc, char *argv[], BenchOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--seed") && hasValue) {
+            options.seed = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--primitives") && hasValue) {
+            options.numPrimitives = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--rays") && hasValue) {
+            options.numRays = atoi(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--seed N] [--primitives N] [--rays N]" << std::endl;
+            return false;
+        }
+    }
+    return options.numPrimitives > 0 && options.numRays > 0;
+}
+
+static void makeScene(const BenchOptions &options, std::vector<CS123ScenePrimitive> &primitives,
+                      std::vector<glm::mat4> &matrices) {
+    const PrimitiveType types[] = { PrimitiveType::PRIMITIVE_CUBE, PrimitiveType::PRIMITIVE_CONE,
+                                    PrimitiveType::PRIMITIVE_CYLINDER, PrimitiveType::PRIMITIVE_SPHERE };
+    std::mt19937 generator(options.seed);
+    std::uniform_real_distribution<float> position(-sceneExtent, sceneExtent);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::uniform_real_distribution<float> scale(0.2f, 2.f);
+    std::uniform_real_distribution<float> angle(0.f, 2.f * PI);
+
+    CS123SceneMaterial material;
+    material.clear();
+    for (int i = 0; i < options.numPrimitives; i++) {
+        glm::vec3 axis = glm::vec3(unit(generator), unit(generator), unit(generator)) + glm::vec3(0.f, 0.01f, 0.f);
+        glm::vec3 translation = glm::vec3(position(generator), position(generator), position(generator));
+        glm::vec3 size = glm::vec3(scale(generator), scale(generator), scale(generator));
+        float rotation = angle(generator);
+        matrices.push_back(glm::translate(translation) * glm::rotate(rotation, glm::normalize(axis))
+                           * glm::scale(size));
+        primitives.push_back(CS123ScenePrimitive(types[i % 4], material));
+    }
+}
+
+static void makeRays(const BenchOptions &options, std::vector<Ray> &rays) {
+    std::mt19937 generator(options.seed + 1);
+    std::uniform_real_distribution<float> position(-sceneExtent, sceneExtent);
+    for (int i = 0; i < options.numRays; i++) {
+        glm::vec3 start = glm::vec3(position(generator), position(generator), 2.f * sceneExtent);
+        glm::vec3 target = glm::vec3(position(generator), position(generator), position(generator));
+        rays.push_back(Ray(start, glm::normalize(target - start)));
+    }
+}
+
+/**
+ *  Rays from a pinhole camera through a square grid of pixels, ordered so that every
+ *  rayPacketSize consecutive rays cover one 2x2 block, as RayScene packs primary rays.
+ */
+static void makeCameraRays(const BenchOptions &options, std::vector<Ray> &rays) {
+    int side = 2 * std::max(1, static_cast<int>(sqrt(options.numRays)) / 2);
+    glm::vec3 eye = glm::vec3(0.f, 0.f, 3.f * sceneExtent);
+    for (int row = 0; row < side; row += 2) {
+        for (int col = 0; col < side; col += 2) {
+            for (int i = 0; i < rayPacketSize; i++) {
+                float x = (col + i % 2 + 0.5f) / side - 0.5f;
+                float y = 0.5f - (row + i / 2 + 0.5f) / side;
+                glm::vec3 target = glm::vec3(2.f * sceneExtent * x, 2.f * sceneExtent * y, sceneExtent);
+                rays.push_back(Ray(eye, glm::normalize(target - eye)));
+            }
+        }
+    }
+}
+
+/** The intersection loop RayScene used before primitives were baked */
+static int perRayInverseHit(const Ray &ray, const std::vector<CS123ScenePrimitive> &primitives,
+                            const std::vector<glm::mat4> &matrices) {
+    static ImplicitSphere sphere;
+    static ImplicitCylinder cylinder;
+    static ImplicitCone cone;
+    static ImplicitCube cube;
+    float tBest = INFINITY;
+    int nearestPrimitive = -1;
+    for (int i = 0; i < primitives.size(); i++) {
+        glm::mat4 inverseCtm = glm::inverse(matrices[i]);
+        glm::vec3 objectSpaceDirection = glm::mat3(inverseCtm) * ray.direction;
+        glm::vec3 objectSpaceEye = glm::vec3(inverseCtm * glm::vec4(ray.startPoint, 1.0f));
+        Ray objectSpaceRay = Ray(objectSpaceEye, objectSpaceDirection);
+        Intersection intersection;
+        if (primitives[i].type == PrimitiveType::PRIMITIVE_CYLINDER) {
+            intersection = cylinder.intersect(objectSpaceRay);
+        } else if (primitives[i].type == PrimitiveType::PRIMITIVE_CONE) {
+            intersection = cone.intersect(objectSpaceRay);
+        } else if (primitives[i].type == PrimitiveType::PRIMITIVE_CUBE) {
+            intersection = cube.intersect(objectSpaceRay);
+        } else if (primitives[i].type == PrimitiveType::PRIMITIVE_SPHERE) {
+            intersection = sphere.intersect(objectSpaceRay);
+        }
+        if (intersection.t >= EPSILON && intersection.t < tBest) {
+            tBest = intersection.t;
+            nearestPrimitive = i;
+        }
+    }
+    return nearestPrimitive;
+}
+
+/** Trace every ray with one method, recording the hit primitive per ray; returns rays/s */
+template <typename HitFunction>
+static double timeRays(const std::vector<Ray> &rays, std::vector<int> &hits, HitFunction nearestHit) {
+    hits.resize(rays.size());
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rays.size(); i++) {
+        hits[i] = nearestHit(rays[i]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return rays.size() / seconds;
+}
+
+/** As timeRays, but intersecting consecutive groups of rays as one packet */
+static double timePackets(const RayPrimitiveTable &table, const std::vector<Ray> &rays,
+                          std::vector<int> &hits) {
+    hits.resize(rays.size());
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i + rayPacketSize <= rays.size(); i += rayPacketSize) {
+        Intersection nearest[rayPacketSize];
+        table.closestHit(RayPacket(&rays[i]), &hits[i], nearest);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return rays.size() / seconds;
+}
+
+static int countMismatches(const std::vector<int> &expected, const std::vector<int> &actual) {
+    int mismatches = 0;
+    for (int i = 0; i < expected.size(); i++) {
+        if (expected[i] != actual[i]) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    std::vector<CS123ScenePrimitive> primitives;
+    std::vector<glm::mat4> matrices;
+    std::vector<Ray> rays;
+    makeScene(options, primitives, matrices);
+    makeRays(options, rays);
+
+    auto buildStart = std::chrono::steady_clock::now();
+    RayPrimitiveTable table;
+    table.build(primitives, matrices);
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+    std::vector<int> perRayInverseHits;
+    std::vector<int> linearHits;
+    std::vector<int> bvhHits;
+    double perRayInverseRate = timeRays(rays, perRayInverseHits, [&](const Ray &ray) {
+        return perRayInverseHit(ray, primitives, matrices);
+    });
+    double linearRate = timeRays(rays, linearHits, [&](const Ray &ray) {
+        Intersection nearest;
+        return table.closestHit(ray, false, nearest);
+    });
+    double bvhRate = timeRays(rays, bvhHits, [&](const Ray &ray) {
+        Intersection nearest;
+        return table.closestHit(ray, true, nearest);
+    });
+
+    std::cout << "seed " << options.seed << ", " << options.numPrimitives << " primitives, "
+              << options.numRays << " rays" << std::endl;
+    std::cout << "  baking: " << buildSeconds * 1000.0 << " ms ("
+              << sizeof(RayPrimitive) << " byte records)" << std::endl;
+    std::cout << "  per-ray inverse: " << perRayInverseRate << " rays/s" << std::endl;
+    std::cout << "  baked linear:    " << linearRate << " rays/s ("
+              << linearRate / perRayInverseRate << "x)" << std::endl;
+    std::cout << "  baked BVH:       " << bvhRate << " rays/s ("
+              << bvhRate / perRayInverseRate << "x)" << std::endl;
+
+    std::vector<int> nearestOccluded;
+    std::vector<int> anyOccluded;
+    double nearestShadowRate = timeRays(rays, nearestOccluded, [&](const Ray &ray) {
+        Intersection nearest;
+        return table.closestHit(ray, true, nearest) >= 0 ? 1 : 0;
+    });
+    double anyShadowRate = timeRays(rays, anyOccluded, [&](const Ray &ray) {
+        return table.anyHit(ray, INFINITY, true) ? 1 : 0;
+    });
+    std::cout << "  shadow, nearest: " << nearestShadowRate << " rays/s" << std::endl;
+    std::cout << "  shadow, any-hit: " << anyShadowRate << " rays/s ("
+              << anyShadowRate / nearestShadowRate << "x)" << std::endl;
+
+    std::vector<Ray> cameraRays;
+    makeCameraRays(options, cameraRays);
+    std::vector<int> singleCameraHits;
+    std::vector<int> packetCameraHits;
+    double singleCameraRate = timeRays(cameraRays, singleCameraHits, [&](const Ray &ray) {
+        Intersection nearest;
+        return table.closestHit(ray, true, nearest);
+    });
+    double packetCameraRate = timePackets(table, cameraRays, packetCameraHits);
+    std::cout << "  camera, single:  " << singleCameraRate << " rays/s" << std::endl;
+    std::cout << "  camera, packets: " << packetCameraRate << " rays/s ("
+              << packetCameraRate / singleCameraRate << "x)" << std::endl;
+
+    int linearMismatches = countMismatches(perRayInverseHits, linearHits);
+    int bvhMismatches = countMismatches(perRayInverseHits, bvhHits);
+    int shadowMismatches = countMismatches(nearestOccluded, anyOccluded);
+    int packetMismatches = countMismatches(singleCameraHits, packetCameraHits);
+    if (linearMismatches > 0 || bvhMismatches > 0 || shadowMismatches > 0 || packetMismatches > 0) {
+        std::cout << "  hits: MISMATCH (" << linearMismatches << " linear, " << bvhMismatches
+                  << " BVH, " << shadowMismatches << " shadow, " << packetMismatches << " packet)"
+                  << std::endl;
+        return 1;
+    }
+    std::cout << "  hits: identical" << std::endl;
+    return 0;
+}
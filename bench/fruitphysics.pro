@@ -0,0 +1,47 @@
+# -------------------------------------------------
+# Headless fruit physics benchmark: records a seeded simulation to a trace,
+# then replays it and checks the replay is bit-exact. No window or GL context
+# is created; the GL sources are only linked because Terrain owns an OpenGLShape.
+# -------------------------------------------------
+TARGET = fruitphysics
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -std=c++14
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3
+
+unix:!macx {
+    LIBS += -lGL -lGLU
+}
+macx {
+    LIBS += -framework OpenGL
+}
+win32 {
+    DEFINES += GLEW_STATIC
+    LIBS += -lopengl32 -lglu32
+}
+
+SOURCES += \
+    FruitPhysicsBench.cpp \
+    ../trees/FruitSimulation.cpp \
+    ../trees/FruitTrace.cpp \
+    ../trees/FruitTransformation.cpp \
+    ../trees/terrain.cpp \
+    ../shapes/OpenGLShape.cpp \
+    ../gl/datatype/VBOAttribMarker.cpp \
+    ../gl/datatype/VBO.cpp \
+    ../gl/datatype/IBO.cpp \
+    ../gl/datatype/VAO.cpp \
+    ../glew-1.10.0/src/glew.c
+
+HEADERS += \
+    ../trees/FruitSimulation.h \
+    ../trees/FruitTrace.h \
+    ../trees/FruitTransformation.h \
+    ../trees/terrain.h
+
+INCLUDEPATH += .. ../glm ../glew-1.10.0/include
+DEPENDPATH += .. ../glm ../glew-1.10.0/include
+DEFINES += GLM_SWIZZLE GLM_FORCE_RADIANS
@@ -0,0 +1,36 @@
+# -------------------------------------------------
+# Headless ray intersection benchmark: compares inverting every CTM per ray
+# against the baked RayPrimitive records, with and without the BVH, and checks
+# all three find the same nearest hits. Needs neither Qt nor a GL context.
+# -------------------------------------------------
+TARGET = rayintersection
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -std=c++14
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3
+
+SOURCES += \
+    RayIntersectionBench.cpp \
+    ../scenegraph/RayPrimitives.cpp \
+    ../scenegraph/BVH.cpp \
+    ../scenegraph/RayGeometry.cpp \
+    ../scenegraph/ImplicitShape.cpp \
+    ../scenegraph/ImplicitSphere.cpp \
+    ../scenegraph/ImplicitCylinder.cpp \
+    ../scenegraph/ImplicitCone.cpp \
+    ../scenegraph/ImplicitCube.cpp \
+    ../scenegraph/ImplicitTrunk.cpp \
+    ../scenegraph/ImplicitLeaf.cpp \
+    ../scenegraph/RayHeightfield.cpp
+
+HEADERS += \
+    ../scenegraph/RayPrimitives.h \
+    ../scenegraph/BVH.h \
+    ../scenegraph/RayGeometry.h
+
+INCLUDEPATH += .. ../lib ../scenegraph ../glm
+DEPENDPATH += .. ../lib ../scenegraph ../glm
+DEFINES += GLM_SWIZZLE GLM_FORCE_RADIANS
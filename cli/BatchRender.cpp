@@ -0,0 +1,308 @@
+/**
+ *  Headless batch renderer.
+ *
+ *  Parses a scene file with CS123XmlSceneParser, ray traces it with RayScene exactly as the
+ *  GUI's Ray tab does, but without a window or GL context, and writes the image to disk. The
+ *  time spent parsing, building the RayScene (baking primitives, the BVH and textures),
+ *  rendering and writing the output is printed, so the same binary serves render jobs and
+ *  performance regressions.
+ *
+ *  Usage: batchrender SCENE.xml -o OUTPUT [--width N] [--height N] [--samples N] [--threads N]
+ *                     [--memory-mb N] [--stats FILE] [--cache DIR]
+ *         batchrender --assemble TILES -o OUTPUT
+ *    --samples N    pixels on edges are refined with an N x N grid of samples; 1 turns this off
+ *    --threads N    worker threads, or 0 (the default) for one per hardware thread
+ *    --memory-mb N  limit on the renderer's per-pixel state, or 0 (the default) for none; it
+ *                   must fit at least one band of 34 rows (about 0.5 MB per 1000 pixels of width)
+ *    --stats FILE   count rays, BVH nodes and primitive tests, time every tile and pass, and
+ *                   write the results to FILE as JSON
+ *    --cache DIR    keep a RaySceneCache of the scene in DIR; later renders of the same scene
+ *                   file map it instead of parsing the scene and building the BVH
+ *  An OUTPUT ending in .tiles is a RayTileFileTarget tile file: tiles are streamed to it as
+ *  they finish, so with a memory budget images of any size can be rendered. Otherwise the
+ *  format follows the file suffix and can be any format QImageWriter supports. --assemble reads
+ *  such a tile file back, checks that its tiles cover every pixel exactly once, and writes them
+ *  out as an image.
+ *  Exits non-zero if the scene cannot be read or the image cannot be written.
+ */
+
+#include "CS123XmlSceneParser.h"
+#include "RayScene.h"
+#include "Settings.h"
+
+#include <QCoreApplication>
+#include <QImage>
+#include <QImageWriter>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+struct RenderOptions {
+    std::string sceneFile;
+    std::string outputFile;
+    int width = 800;
+    int height = 600;
+    int samplesPerSide = 2;
+    int numThreads = 0;
+    int memoryBudgetMB = 0;
+    std::string statsFile;
+    std::string cacheDirectory;
+    std::string tileFileToAssemble;
+};
+
+const std::string tileFileSuffix = ".tiles";
+
+static bool parseOptions(int argc, char *argv[], RenderOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-o") && hasValue) {
+            options.outputFile = argv[++i];
+        } else if (!strcmp(argv[i], "--width") && hasValue) {
+            options.width = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--height") && hasValue) {
+            options.height = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--samples") && hasValue) {
+            options.samplesPerSide = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && hasValue) {
+            options.numThreads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--memory-mb") && hasValue) {
+            options.memoryBudgetMB = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--stats") && hasValue) {
+            options.statsFile = argv[++i];
+        } else if (!strcmp(argv[i], "--cache") && hasValue) {
+            options.cacheDirectory = argv[++i];
+        } else if (!strcmp(argv[i], "--assemble") && hasValue) {
+            options.tileFileToAssemble = argv[++i];
+        } else if (argv[i][0] != '-' && options.sceneFile.empty()) {
+            options.sceneFile = argv[i];
+        } else {
+            options.sceneFile.clear();
+            options.tileFileToAssemble.clear();
+            break;
+        }
+    }
+    // Exactly one of a scene to render and a tile file to assemble
+    if (options.sceneFile.empty() == options.tileFileToAssemble.empty() || options.outputFile.empty()
+            || options.width <= 0 || options.height <= 0 || options.samplesPerSide <= 0
+            || options.numThreads < 0 || options.memoryBudgetMB < 0) {
+        std::cerr << "usage: " << argv[0] << " SCENE.xml -o OUTPUT [--width N] [--height N]"
+                  << " [--samples N] [--threads N] [--memory-mb N] [--stats FILE] [--cache DIR]"
+                  << std::endl;
+        std::cerr << "       " << argv[0] << " --assemble TILES -o OUTPUT" << std::endl;
+        return false;
+    }
+    size_t minimumBudget = RayScene::getMinimumMemoryBudget(options.width);
+    if (options.memoryBudgetMB > 0
+            && static_cast<size_t>(options.memoryBudgetMB) * 1024 * 1024 < minimumBudget) {
+        std::cerr << "--memory-mb " << options.memoryBudgetMB << " is too small for a width of "
+                  << options.width << "; at least " << (minimumBudget + 1024 * 1024 - 1) / (1024 * 1024)
+                  << " MB is needed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ *  Turn on every ray tracing feature. The GUI's saved settings are deliberately not loaded,
+ *  so a render only depends on its command line.
+ */
+static void applyRaySettings(const RenderOptions &options) {
+    settings.useSuperSampling = options.samplesPerSide > 1;
+    settings.numSuperSamples = options.samplesPerSide;
+    settings.useAntiAliasing = false;
+    settings.useShadows = true;
+    settings.useTextureMapping = true;
+    settings.useReflection = true;
+    settings.useRefraction = true;
+    settings.useMultiThreading = true;
+    settings.usePointLights = true;
+    settings.useDirectionalLights = true;
+    settings.useSpotLights = true;
+    settings.useKDTree = true;
+}
+
+static bool endsWith(const std::string &string, const std::string &suffix) {
+    return string.size() >= suffix.size()
+            && string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ *  Render straight into a tile file, returning false if it cannot be written. renderSeconds is
+ *  set to the time spent in the renderer, which includes streaming the tiles out but not
+ *  opening the file or writing its index.
+ */
+static bool renderToTileFile(RayScene &rayScene, CS123SceneCameraData &camera,
+                             const RenderOptions &options, double &renderSeconds) {
+    RayTileFileTarget target(options.outputFile, options.width, options.height);
+    if (!target.begin()) {
+        return false;
+    }
+    auto renderStart = std::chrono::steady_clock::now();
+    rayScene.renderRayScene(&camera, target, []() {});
+    renderSeconds = secondsSince(renderStart);
+    return target.finish();
+}
+
+/**
+ *  Render into an image and save it, returning false if it cannot be written. renderSeconds is
+ *  set to the time spent in the renderer, leaving out encoding and writing the image.
+ */
+static bool renderToImage(RayScene &rayScene, CS123SceneCameraData &camera,
+                          const RenderOptions &options, double &renderSeconds) {
+    QImage image(options.width, options.height, QImage::Format_RGBX8888 /* matches RGBA */);
+    RayImageTarget target(reinterpret_cast<RGBA *>(image.bits()), options.width, options.height, false);
+    auto renderStart = std::chrono::steady_clock::now();
+    rayScene.renderRayScene(&camera, target, []() {});
+    renderSeconds = secondsSince(renderStart);
+
+    QImageWriter writer(QString::fromStdString(options.outputFile));
+    if (!writer.write(image)) {
+        std::cerr << "could not write " << options.outputFile << ": "
+                  << writer.errorString().toStdString() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** Read a tile file back and write it out as an image, returning false if either fails */
+static bool assembleTileFile(const RenderOptions &options) {
+    RayTileFileReader reader;
+    if (!reader.open(options.tileFileToAssemble)) {
+        return false;
+    }
+    QImage image(reader.getWidth(), reader.getHeight(), QImage::Format_RGBX8888 /* matches RGBA */);
+    RayImageTarget target(reinterpret_cast<RGBA *>(image.bits()), reader.getWidth(), reader.getHeight(),
+                          false);
+    if (!reader.read(target)) {
+        return false;
+    }
+
+    QImageWriter writer(QString::fromStdString(options.outputFile));
+    if (!writer.write(image)) {
+        std::cerr << "could not write " << options.outputFile << ": "
+                  << writer.errorString().toStdString() << std::endl;
+        return false;
+    }
+    std::cout << options.tileFileToAssemble << ": " << reader.getWidth() << "x" << reader.getHeight()
+              << ", wrote " << options.outputFile << std::endl;
+    return true;
+}
+
+/** Write the statistics of the last render as JSON, returning false if they cannot be written */
+static bool writeStats(const RayStats &stats, const std::string &filename) {
+    std::ofstream file(filename);
+    file << stats.toJson();
+    file.close();
+    if (file.fail()) {
+        std::cerr << "could not write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    // Only needed so QImageWriter can find its format plugins; no display is used
+    QCoreApplication app(argc, argv);
+
+    RenderOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+    if (!options.tileFileToAssemble.empty()) {
+        return assembleTileFile(options) ? 0 : 1;
+    }
+    applyRaySettings(options);
+
+    std::unique_ptr<RayScene> cachedScene;
+    CS123SceneCameraData camera;
+    std::string sceneHash;
+    std::string cacheFile;
+    auto cacheStart = std::chrono::steady_clock::now();
+    if (!options.cacheDirectory.empty()) {
+        sceneHash = RaySceneCache::hashFile(options.sceneFile);
+        cacheFile = RaySceneCache::getCacheFilename(options.cacheDirectory, sceneHash);
+        auto cache = std::make_shared<RaySceneCache>();
+        if (!sceneHash.empty() && cache->open(cacheFile, sceneHash)) {
+            cachedScene = std::make_unique<RayScene>(cache);
+            camera = cache->getHeader().camera;
+        }
+    }
+    double cacheSeconds = secondsSince(cacheStart);
+
+    // Without a cache, parse the scene and build it from scratch
+    double parseSeconds = 0.0;
+    double buildSeconds = 0.0;
+    std::unique_ptr<RayScene> builtScene;
+    if (!cachedScene) {
+        auto parseStart = std::chrono::steady_clock::now();
+        CS123XmlSceneParser parser(options.sceneFile);
+        if (!parser.parse()) {
+            std::cerr << "could not parse " << options.sceneFile << std::endl;
+            return 1;
+        }
+        Scene scene;
+        Scene::parse(&scene, &parser);
+        parser.getCameraData(camera);
+        parseSeconds = secondsSince(parseStart);
+
+        auto buildStart = std::chrono::steady_clock::now();
+        builtScene = std::make_unique<RayScene>(scene);
+        buildSeconds = secondsSince(buildStart);
+        if (!sceneHash.empty()) {
+            builtScene->writeCache(cacheFile, sceneHash, camera);
+        }
+    }
+    RayScene &rayScene = cachedScene ? *cachedScene : *builtScene;
+    rayScene.setNumThreads(options.numThreads);
+    rayScene.setMemoryBudget(static_cast<size_t>(options.memoryBudgetMB) * 1024 * 1024);
+    rayScene.setCollectStats(!options.statsFile.empty());
+
+    camera.pos[3] = 1;
+    camera.look[3] = 0;
+    camera.up[3] = 0;
+
+    // Encoding and writing the output are timed separately from rendering, which is what
+    // performance regressions are tracked by
+    double renderSeconds = 0.0;
+    auto outputStart = std::chrono::steady_clock::now();
+    bool written = endsWith(options.outputFile, tileFileSuffix)
+            ? renderToTileFile(rayScene, camera, options, renderSeconds)
+            : renderToImage(rayScene, camera, options, renderSeconds);
+    if (!written) {
+        return 1;
+    }
+    double writeSeconds = secondsSince(outputStart) - renderSeconds;
+
+    int numThreads = options.numThreads > 0 ? options.numThreads
+                                            : std::max(1u, std::thread::hardware_concurrency());
+    double numPixels = static_cast<double>(options.width) * options.height;
+    std::cout << options.sceneFile << ": " << options.width << "x" << options.height << ", "
+              << options.samplesPerSide << "x" << options.samplesPerSide << " samples, "
+              << numThreads << " threads" << std::endl;
+    if (cachedScene) {
+        std::cout << "  cache:  " << cacheSeconds * 1000.0 << " ms (" << cacheFile << ")" << std::endl;
+    } else {
+        std::cout << "  parse:  " << parseSeconds * 1000.0 << " ms" << std::endl;
+        std::cout << "  build:  " << buildSeconds * 1000.0 << " ms" << std::endl;
+    }
+    std::cout << "  render: " << renderSeconds * 1000.0 << " ms ("
+              << numPixels / renderSeconds / 1e6 << " Mpixels/s)" << std::endl;
+    std::cout << "  write:  " << writeSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  wrote " << options.outputFile << std::endl;
+    if (!options.statsFile.empty()) {
+        if (!writeStats(rayScene.getStats(), options.statsFile)) {
+            return 1;
+        }
+        std::cout << "  wrote " << options.statsFile << std::endl;
+    }
+    return 0;
+}
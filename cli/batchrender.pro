@@ -0,0 +1,56 @@
+# -------------------------------------------------
+# Headless batch renderer: ray traces a scene file to an image from the command
+# line, printing timings. Uses QtGui only for QImage, so it needs neither a
+# display nor a GL context.
+# -------------------------------------------------
+QT += gui
+QT -= widgets opengl
+TARGET = batchrender
+TEMPLATE = app
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++14
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE += -O3
+
+SOURCES += \
+    BatchRender.cpp \
+    ../lib/CS123XmlSceneParser.cpp \
+    ../lib/RGBA.cpp \
+    ../ui/Settings.cpp \
+    ../scenegraph/Scene.cpp \
+    ../scenegraph/RayScene.cpp \
+    ../scenegraph/RayPrimitives.cpp \
+    ../scenegraph/RayTexture.cpp \
+    ../scenegraph/RayRenderTarget.cpp \
+    ../scenegraph/RayLights.cpp \
+    ../scenegraph/RayStats.cpp \
+    ../scenegraph/RaySceneCache.cpp \
+    ../scenegraph/BVH.cpp \
+    ../scenegraph/RayGeometry.cpp \
+    ../scenegraph/ImplicitShape.cpp \
+    ../scenegraph/ImplicitSphere.cpp \
+    ../scenegraph/ImplicitCylinder.cpp \
+    ../scenegraph/ImplicitCone.cpp \
+    ../scenegraph/ImplicitCube.cpp \
+    ../scenegraph/ImplicitTrunk.cpp \
+    ../scenegraph/ImplicitLeaf.cpp \
+    ../scenegraph/RayHeightfield.cpp
+
+HEADERS += \
+    ../lib/CS123XmlSceneParser.h \
+    ../lib/CS123SceneArena.h \
+    ../ui/Settings.h \
+    ../scenegraph/Scene.h \
+    ../scenegraph/RayScene.h \
+    ../scenegraph/RayRenderTarget.h \
+    ../scenegraph/RayLights.h \
+    ../scenegraph/RayStats.h \
+    ../scenegraph/RaySceneCache.h \
+    ../scenegraph/RayPrimitives.h
+
+INCLUDEPATH += .. ../glm ../camera ../lib ../scenegraph ../ui
+DEPENDPATH += .. ../glm ../camera ../lib ../scenegraph ../ui
+DEFINES += _USE_MATH_DEFINES
+DEFINES += GLM_SWIZZLE GLM_FORCE_RADIANS
@@ -1,7 +1,7 @@
 # -------------------------------------------------
 # Project created by QtCreator 2010-08-22T14:12:19
 # -------------------------------------------------
-QT += opengl xml
+QT += opengl
 TARGET = final
 TEMPLATE = app
 
@@ -31,12 +31,23 @@ SOURCES += \
     scenegraph/ImplicitCylinder.cpp \
     scenegraph/ImplicitShape.cpp \
     scenegraph/ImplicitSphere.cpp \
+    scenegraph/ImplicitTrunk.cpp \
+    scenegraph/ImplicitLeaf.cpp \
     scenegraph/RayGeometry.cpp \
     scenegraph/Scene.cpp \
     scenegraph/OpenGLScene.cpp \
     scenegraph/ShapesScene.cpp \
     scenegraph/SceneviewScene.cpp \
     scenegraph/RayScene.cpp \
+    scenegraph/BVH.cpp \
+    scenegraph/RayPrimitives.cpp \
+    scenegraph/RayHeightfield.cpp \
+    scenegraph/RayTexture.cpp \
+    scenegraph/RayRenderTarget.cpp \
+    scenegraph/RayLights.cpp \
+    scenegraph/RayStats.cpp \
+    scenegraph/RaySceneCache.cpp \
+    scenegraph/SphereBVH.cpp \
     shapes/CircleBase.cpp \
     shapes/Cone.cpp \
     shapes/Cube.cpp \
@@ -49,6 +60,8 @@ SOURCES += \
     shapes/Sphere.cpp \
     shapes/Tessellator.cpp \
     shapes/Trunk.cpp \
+    trees/FruitSimulation.cpp \
+    trees/FruitTrace.cpp \
     trees/FruitTransformation.cpp \
     trees/LSystem.cpp \
     trees/MeshGenerator.cpp \
@@ -91,12 +104,23 @@ HEADERS += \
     scenegraph/ImplicitCylinder.h \
     scenegraph/ImplicitShape.h \
     scenegraph/ImplicitSphere.h \
+    scenegraph/ImplicitTrunk.h \
+    scenegraph/ImplicitLeaf.h \
     scenegraph/RayGeometry.h \
     scenegraph/Scene.h \
     scenegraph/OpenGLScene.h \
     scenegraph/ShapesScene.h \
     scenegraph/SceneviewScene.h \
     scenegraph/RayScene.h \
+    scenegraph/BVH.h \
+    scenegraph/RayPrimitives.h \
+    scenegraph/RayHeightfield.h \
+    scenegraph/RayTexture.h \
+    scenegraph/RayRenderTarget.h \
+    scenegraph/RayLights.h \
+    scenegraph/RayStats.h \
+    scenegraph/RaySceneCache.h \
+    scenegraph/SphereBVH.h \
     shapes/CircleBase.h \
     shapes/Cone.h \
     shapes/Cube.h \
@@ -110,6 +134,8 @@ HEADERS += \
     shapes/Tessellator.h \
     shapes/TriMesh.h \
     shapes/Trunk.h \
+    trees/FruitSimulation.h \
+    trees/FruitTrace.h \
     trees/FruitTransformation.h \
     trees/LSystem.h \
     trees/MeshGenerator.h \
@@ -139,6 +165,7 @@ HEADERS += \
     gl/shaders/CS123Shader.h \
     gl/util/FullScreenQuad.h \
     lib/CS123XmlSceneParser.h \
+    lib/CS123SceneArena.h \
     lib/CS123SceneData.h \
     lib/CS123ISceneParser.h \
     lib/ResourceLoader.h \
@@ -162,6 +189,7 @@ OTHER_FILES += shaders/shader.frag \
     shaders/normals/normalsArrow.vert \
     shaders/normals/normalsArrow.gsh \
     shaders/normals/normalsArrow.frag \
+    shaders/picking/picking.frag \
     shaders/deferredlighting/gbuffer/gbuffer.frag \
     shaders/deferredlighting/gbuffer/gbuffer.vert \
     shaders/deferredlighting/lighting/lighting.frag \
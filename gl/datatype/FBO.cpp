@@ -18,24 +18,21 @@ FBO::FBO(int numberOfColorAttachments, DEPTH_STENCIL_ATTACHMENT attachmentType,
     m_width(width),
     m_height(height)
 {
-    // TODO [Task 2]
-    // Generate a new framebuffer using m_handle
+    glGenFramebuffers(1, &m_handle);
 
-    // TODO [Task 3]
-    // Call bind() and fill it in with glBindFramebuffer
-    // Call generateColorAttachments() and fill in generateColorAttachment()
-
-    // TODO [Task 8] Call generateDepthStencilAttachment()
+    bind();
+    generateColorAttachments(numberOfColorAttachments, wrapMethod, filterMethod, type);
+    generateDepthStencilAttachment();
 
     // This will make sure your framebuffer was generated correctly!
     checkFramebufferStatus();
 
-    // TODO [Task 3] Call unbind() and fill it in
+    unbind();
 }
 
 FBO::~FBO()
 {
-    // TODO Don't forget to delete!
+    glDeleteFramebuffers(1, &m_handle);
 }
 
 void FBO::generateColorAttachments(int count, TextureParameters::WRAP_METHOD wrapMethod,
@@ -45,14 +42,17 @@ void FBO::generateColorAttachments(int count, TextureParameters::WRAP_METHOD wra
         generateColorAttachment(i, wrapMethod, filterMethod, type);
         buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
     }
-    // TODO [Task 3] Call glDrawBuffers
+    if (!buffers.empty()) {
+        glDrawBuffers(buffers.size(), buffers.data());
+    }
 }
 
 void FBO::generateDepthStencilAttachment() {
     switch(m_depthStencilAttachmentType) {
         case DEPTH_STENCIL_ATTACHMENT::DEPTH_ONLY:
             m_depthAttachment = std::make_unique<DepthBuffer>(m_width, m_height);
-            // TODO [Task 8]
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                                      m_depthAttachment->id());
             break;
         case DEPTH_STENCIL_ATTACHMENT::DEPTH_STENCIL:
             // Left as an exercise to students
@@ -67,26 +67,40 @@ void FBO::generateColorAttachment(int i, TextureParameters::WRAP_METHOD wrapMeth
     Texture2D tex(nullptr, m_width, m_height, type);
     TextureParametersBuilder builder;
 
-    // TODO [Task 2]
-    // - Set the filter method using builder.setFilter() with filterMethod
-    // - Set the wrap method using builder.setWrap() with wrapMethod
+    builder.setFilter(filterMethod);
+    builder.setWrap(wrapMethod);
 
     TextureParameters parameters = builder.build();
     parameters.applyTo(tex);
 
-    // TODO [Task 3] Call glFramebufferTexture2D using tex.id()
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, tex.id(), 0);
 
     m_colorAttachments.push_back(std::move(tex));
 }
 
 void FBO::bind() {
-    // TODO [Task 3]
+    glBindFramebuffer(GL_FRAMEBUFFER, m_handle);
 
-    // TODO [Task 4] // Resize the viewport to our FBO's size
+    // Resize the viewport to our FBO's size
+    glViewport(0, 0, m_width, m_height);
 }
 
 void FBO::unbind() {
-    // TODO [Task 3]
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * Read one texel of an integer (GL_UNSIGNED_INT) color attachment. The FBO must be bound.
+ * (x, y) are in GL window coordinates, with y = 0 at the bottom.
+ */
+GLuint FBO::readUnsignedInt(int attachment, int x, int y) const {
+    GLuint value = 0;
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        return value;
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+    glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &value);
+    return value;
 }
 
 const Texture2D& FBO::getColorAttachment(int i) const {
@@ -96,3 +110,7 @@ const Texture2D& FBO::getColorAttachment(int i) const {
 const RenderBuffer& FBO::getDepthStencilAttachment() const {
     return *m_depthAttachment.get();
 }
+
+size_t FBO::getNumColorAttachments() const {
+    return m_colorAttachments.size();
+}
@@ -30,6 +30,10 @@ public:
 
     size_t getNumColorAttachments() const;
 
+    GLuint readUnsignedInt(int attachment, int x, int y) const;
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
 private:
     void generateColorAttachments(int count, TextureParameters::WRAP_METHOD wrapMethod,
                                   TextureParameters::FILTER_METHOD filterMethod, GLenum type);
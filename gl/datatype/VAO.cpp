@@ -82,6 +82,27 @@ void VAO::draw(int count) {
     }
 }
 
+void VAO::drawInstanced(int instanceCount) {
+    switch(m_drawMethod) {
+        case VAO::DRAW_ARRAYS:
+            glDrawArraysInstanced(m_triangleLayout, 0, m_numVertices, instanceCount);
+            break;
+        case VAO::DRAW_INDEXED:
+            break;
+    }
+}
+
+/**
+ * Bind an additional buffer of per-instance attributes into this VAO. The buffer's markers
+ * should have a non-zero divisor; the buffer can keep being updated after it is attached.
+ */
+void VAO::addInstanceBuffer(const VBO &vbo) {
+    bind();
+    vbo.bindAndEnable();
+    unbind();
+    vbo.unbind();
+}
+
 void VAO::bind() {
     glBindVertexArray(m_handle);
 }
@@ -25,6 +25,8 @@ public:
     void bind();
     void draw();
     void draw(int count);
+    void drawInstanced(int instanceCount);
+    void addInstanceBuffer(const VBO &vbo);
     DRAW_METHOD drawMethod();
     void unbind();
 
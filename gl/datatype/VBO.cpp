@@ -13,18 +13,20 @@ unsigned int calculateFloatsPerVertex(const std::vector<VBOAttribMarker> &marker
     return max;
 }
 
-VBO::VBO(const float *data, int sizeInFloats, std::vector<VBOAttribMarker> markers, GEOMETRY_LAYOUT layout) :
+VBO::VBO(const float *data, int sizeInFloats, std::vector<VBOAttribMarker> markers, GEOMETRY_LAYOUT layout,
+         USAGE usage) :
     m_handle(-1),
     m_markers(markers),
     m_bufferSizeInFloats(sizeInFloats),
     m_numberOfFloatsPerVertex(calculateFloatsPerVertex(markers)),
     m_stride(m_numberOfFloatsPerVertex * sizeof(GLfloat)),
-    m_triangleLayout(layout)
+    m_triangleLayout(layout),
+    m_usage(usage)
 {
     glGenBuffers(1, &m_handle);
 
     glBindBuffer(GL_ARRAY_BUFFER, m_handle);
-    glBufferData(GL_ARRAY_BUFFER, sizeInFloats * sizeof(GLfloat), &data[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeInFloats * sizeof(GLfloat), data, m_usage);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
@@ -35,7 +37,8 @@ VBO::VBO(VBO &&that) :
     m_bufferSizeInFloats(that.m_bufferSizeInFloats),
     m_numberOfFloatsPerVertex(that.m_numberOfFloatsPerVertex),
     m_stride(that.m_stride),
-    m_triangleLayout(that.m_triangleLayout)
+    m_triangleLayout(that.m_triangleLayout),
+    m_usage(that.m_usage)
 {
     that.m_handle = 0;
 }
@@ -50,6 +53,7 @@ VBO& VBO::operator=(VBO &&that) {
     m_numberOfFloatsPerVertex = that.m_numberOfFloatsPerVertex;
     m_stride = that.m_stride;
     m_triangleLayout = that.m_triangleLayout;
+    m_usage = that.m_usage;
 
     that.m_handle = 0;
 
@@ -71,9 +75,21 @@ void VBO::bindAndEnable() const {
         VBOAttribMarker am = m_markers[i];
         glEnableVertexAttribArray(am.name);
         glVertexAttribPointer(am.name, am.numElements, am.dataType, am.dataNormalize, m_stride, reinterpret_cast<GLvoid*>(am.offset));
+        glVertexAttribDivisor(am.name, am.divisor);
     }
 }
 
+/**
+ * Replace the contents of the buffer. Re-specifying the whole store orphans the old one, so the
+ * driver does not have to wait for draws that are still reading it.
+ */
+void VBO::update(const float *data, int sizeInFloats) {
+    bind();
+    glBufferData(GL_ARRAY_BUFFER, sizeInFloats * sizeof(GLfloat), data, m_usage);
+    unbind();
+    m_bufferSizeInFloats = sizeInFloats;
+}
+
 void VBO::unbind() const {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
@@ -16,14 +16,20 @@ public:
                            LAYOUT_TRIANGLE_FAN = GL_TRIANGLE_FAN,
                            LAYOUT_LINE_STRIP = GL_LINE_STRIP };
 
+    enum USAGE { USAGE_STATIC = GL_STATIC_DRAW,
+                 USAGE_DYNAMIC = GL_DYNAMIC_DRAW,
+                 USAGE_STREAM = GL_STREAM_DRAW };
+
     /**
      * @brief VBO
      * @param data Pointer to the beginning of the data.
      * @param sizeInFloats Number of floats in the array.
      * @param markers List of VBOAttribMarkers that describe how the data is laid out.
      * @param layout Layout of the vertex data.
+     * @param usage Hint for how often the data will be re-specified with update().
      */
-    VBO(const float *data, int sizeInFloats, std::vector<VBOAttribMarker> markers, GEOMETRY_LAYOUT layout = LAYOUT_TRIANGLES);
+    VBO(const float *data, int sizeInFloats, std::vector<VBOAttribMarker> markers, GEOMETRY_LAYOUT layout = LAYOUT_TRIANGLES,
+        USAGE usage = USAGE_STATIC);
     VBO(const VBO&) = delete;
     VBO& operator=(const VBO&) = delete;
     VBO(VBO &&that);
@@ -31,6 +37,7 @@ public:
     ~VBO();
 
     void bindAndEnable() const;
+    void update(const float *data, int sizeInFloats);
     GEOMETRY_LAYOUT triangleLayout() const;
     int numberOfVertices() const;
     int numberOfFloatsPerVertex() const;
@@ -46,6 +53,7 @@ private:
     int m_numberOfFloatsPerVertex;
     GLuint m_stride;
     GEOMETRY_LAYOUT m_triangleLayout;
+    USAGE m_usage;
 };
 
 }}
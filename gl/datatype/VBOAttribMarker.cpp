@@ -2,12 +2,14 @@
 
 namespace CS123 { namespace GL {
 
-VBOAttribMarker::VBOAttribMarker(GLuint name, GLuint numElementsPerVertex, int offset, DATA_TYPE type , bool normalize) :
+VBOAttribMarker::VBOAttribMarker(GLuint name, GLuint numElementsPerVertex, int offset, DATA_TYPE type , bool normalize,
+                                 GLuint divisor) :
     name(name),
     dataType(type),
     dataNormalize(normalize ? GLTRUE : GLFALSE),
     numElements(numElementsPerVertex),
-    offset(offset)
+    offset(offset),
+    divisor(divisor)
 {
 }
 
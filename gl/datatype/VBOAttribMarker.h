@@ -18,14 +18,17 @@ struct VBOAttribMarker {
      * @param offset Offset in BYTES from the start of the array to the beginning of the first element
      * @param type Primitive type (FLOAT, INT, UNSIGNED_BYTE)
      * @param normalize
+     * @param divisor 0 for per-vertex data, or N to advance the attribute once every N instances
      */
-    VBOAttribMarker(GLuint name, GLuint numElementsPerVertex, int offset, DATA_TYPE type = FLOAT, bool normalize = false);
+    VBOAttribMarker(GLuint name, GLuint numElementsPerVertex, int offset, DATA_TYPE type = FLOAT, bool normalize = false,
+                    GLuint divisor = 0);
 
     GLuint name;
     DATA_TYPE dataType;
     DATA_NORMALIZE dataNormalize;
     GLuint numElements;
     size_t offset;
+    GLuint divisor;
 };
 
 }}
@@ -28,6 +28,18 @@ namespace CS123 { namespace GL { namespace ShaderAttrib {
     // Starting at this index,
     const GLuint SPECIAL0 = 9;
 
+    // Per-instance attributes (location 10 is taken by the normal arrow offsets)
+    const GLuint INSTANCE_TRANSLATION_SCALE = 11;
+    const GLuint INSTANCE_ORIENTATION = 12;
+    const GLuint INSTANCE_SWAY_COS = 13;
+    const GLuint INSTANCE_SWAY_SIN = 14;
+
+    // Rows of a per-instance affine model matrix. Instanced shapes have no extra texture
+    // coordinate sets, so these share the TEXCOORD1-3 locations.
+    const GLuint INSTANCE_MODEL_ROW0 = 6;
+    const GLuint INSTANCE_MODEL_ROW1 = 7;
+    const GLuint INSTANCE_MODEL_ROW2 = 8;
+
 
 
 }}}
@@ -11,7 +11,7 @@ namespace CS123 { namespace GL {
 Texture::Texture() :
     m_handle(0)
 {
-    // TODO [Task 2] Generate the texture
+    glGenTextures(1, &m_handle);
 }
 
 Texture::Texture(Texture &&that) :
@@ -29,7 +29,7 @@ Texture& Texture::operator=(Texture &&that) {
 
 Texture::~Texture()
 {
-    // TODO Don't forget to delete!
+    glDeleteTextures(1, &m_handle);
 }
 
 unsigned int Texture::id() const {
@@ -14,7 +14,7 @@
 
 // Forward declare structs to contain parsed data.
 struct CS123SceneCameraData;
-struct CS123SceneNode;
+struct CS123SceneGraph;
 struct CS123SceneGlobalData;
 struct CS123SceneLightData;
 
@@ -35,8 +35,8 @@ public:
     // On return data will contain the global scene data
     virtual bool getGlobalData(CS123SceneGlobalData& data) const = 0;
 
-    // Returns the root node of the scene graph
-    virtual CS123SceneNode* getRootNode() const = 0;
+    // Returns the scene graph, which stays valid for the life of the parser
+    virtual const CS123SceneGraph& getSceneGraph() const = 0;
 
     virtual ~CS123ISceneParser() {}
 
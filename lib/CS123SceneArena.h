@@ -0,0 +1,103 @@
+#ifndef __CS123SCENEARENA__
+#define __CS123SCENEARENA__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @class CS123SceneArena
+ *
+ * A bump allocator for the arrays of a parsed scene graph. Arrays are placed one after the other
+ * in large blocks, and nothing is freed until the arena is destroyed, which destroys the arrays
+ * in reverse order and frees the blocks. If the space the arrays need is reserved up front, they
+ * all share one block, so the whole scene graph is a single allocation. Pointers into the arena
+ * stay valid for the life of the arena.
+ */
+class CS123SceneArena {
+
+public:
+    CS123SceneArena() : m_next(nullptr), m_remaining(0) {}
+
+    ~CS123SceneArena() {
+        for (auto i = m_destructors.rbegin(); i != m_destructors.rend(); i++) {
+            i->destroy(i->objects, i->count);
+        }
+    }
+
+    CS123SceneArena(const CS123SceneArena &) = delete;
+    CS123SceneArena &operator=(const CS123SceneArena &) = delete;
+
+    // Make sure the next allocations, totalling at most size bytes with their alignment padding,
+    // all come from the same block
+    void reserve(size_t size) {
+        if (size > m_remaining) {
+            size_t newBlockSize = size > blockSize ? size : blockSize;
+            m_blocks.emplace_back(new char[newBlockSize]);
+            m_next = m_blocks.back().get();
+            m_remaining = newBlockSize;
+        }
+    }
+
+    // Value-initialize an array of count Ts in the arena
+    template <typename T>
+    T *createArray(size_t count) {
+        T *objects = static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < count; i++) {
+            new (objects + i) T();
+        }
+        if (!std::is_trivially_destructible<T>::value && count > 0) {
+            m_destructors.push_back({ objects, count, [](void *p, size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    static_cast<T *>(p)[i].~T();
+                }
+            } });
+        }
+        return objects;
+    }
+
+    // Space needed to create an array of count Ts, padding included
+    template <typename T>
+    static size_t getArraySize(size_t count) {
+        return count * sizeof(T) + alignof(T) - 1;
+    }
+
+private:
+    // Arrays bigger than a quarter of a block that do not fit get a block of their own
+    static const size_t blockSize = 64 * 1024;
+
+    void *allocate(size_t size, size_t alignment) {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(m_next) % alignment) % alignment;
+        if (padding + size > m_remaining) {
+            // new[] aligns blocks for any fundamental type
+            if (size > blockSize / 4) {
+                m_blocks.emplace_back(new char[size]);
+                return m_blocks.back().get();
+            }
+            m_blocks.emplace_back(new char[blockSize]);
+            m_next = m_blocks.back().get();
+            m_remaining = blockSize;
+            padding = 0;
+        }
+        void *p = m_next + padding;
+        m_next += padding + size;
+        m_remaining -= padding + size;
+        return p;
+    }
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char *m_next;
+    size_t m_remaining;
+    // The arrays that need destroying, and how
+    struct Destructor {
+        void *objects;
+        size_t count;
+        void (*destroy)(void *objects, size_t count);
+    };
+    std::vector<Destructor> m_destructors;
+};
+
+#endif
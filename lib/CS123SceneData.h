@@ -25,7 +25,8 @@ enum class PrimitiveType {
     PRIMITIVE_MESH,
     PRIMITIVE_LEAF,
     PRIMITIVE_FRUIT,
-    PRIMITIVE_TRUNK
+    PRIMITIVE_TRUNK,
+    PRIMITIVE_TERRAIN
 };
 
 // Enumeration for types of transformations that can be applied to objects, lights, and cameras.
@@ -164,13 +165,38 @@ struct CS123SceneTransformation {
                          // a custom matrix.
 };
 
-// Structure for non-primitive scene objects
+// Structure for non-primitive scene objects. A node's transformations, primitives and children
+// are contiguous ranges of the CS123SceneGraph's arrays, given as the index of the first one and
+// their number.
 struct CS123SceneNode {
-   std::vector<CS123SceneTransformation*> transformations;
+   int firstTransformation;
+   int numTransformations;
 
-   std::vector<CS123ScenePrimitive*> primitives;
+   int firstPrimitive;
+   int numPrimitives;
 
-   std::vector<CS123SceneNode*> children;
+   // Range in CS123SceneGraph::children, which holds node indices. A master object is a single
+   // node that every node referring to it lists as a child.
+   int firstChild;
+   int numChildren;
+};
+
+// A parsed scene graph, stored as flat arrays that nodes refer to by index
+struct CS123SceneGraph {
+   const CS123SceneNode *nodes;
+   int numNodes;
+
+   const CS123SceneTransformation *transformations;
+   int numTransformations;
+
+   const CS123ScenePrimitive *primitives;
+   int numPrimitives;
+
+   const int *children;
+   int numChildren;
+
+   // Index of the root node, or -1 if the scene has none
+   int root;
 };
 
 #endif
@@ -8,16 +8,19 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include <QFile>
+
 #include <assert.h>
 #include <iostream>
 #include <string.h>
 #include <string>
+#include <utility>
 
-#define ERROR_AT(e) "error at line " << e.lineNumber() << " col " << e.columnNumber() << ": "
-#define PARSE_ERROR(e) std::cout << ERROR_AT(e) << "could not parse <" << e.tagName().toStdString() \
-    << ">" << std::endl
-#define UNSUPPORTED_ELEMENT(e) std::cout << ERROR_AT(e) << "unsupported element <" \
-    << e.tagName().toStdString() << ">" << std::endl;
+#define ERROR_AT(xml) "error at line " << xml.lineNumber() << " col " << xml.columnNumber() << ": "
+#define PARSE_ERROR(xml) std::cout << ERROR_AT(xml) << "could not parse <" \
+    << xml.name().toString().toStdString() << ">" << std::endl
+#define UNSUPPORTED_ELEMENT(xml) std::cout << ERROR_AT(xml) << "unsupported element <" \
+    << xml.name().toString().toStdString() << ">" << std::endl;
 
 CS123XmlSceneParser::CS123XmlSceneParser(const std::string& name) 
 {
@@ -27,33 +30,16 @@ CS123XmlSceneParser::CS123XmlSceneParser(const std::string& name)
     memset(&m_globalData, 0, sizeof(CS123SceneGlobalData));
     m_objects.clear();
     m_lights.clear();
-    m_nodes.clear();
+    m_numNodes = 0;
+
+    // Empty until the file has been parsed
+    memset(&m_graph, 0, sizeof(CS123SceneGraph));
+    m_graph.root = -1;
 }
 
 CS123XmlSceneParser::~CS123XmlSceneParser()
 {
-    std::vector<CS123SceneLightData*>::iterator lights;
-    for (lights = m_lights.begin(); lights != m_lights.end(); lights++) {
-        delete *lights;
-    }
-
-    // Delete all Scene Nodes
-    for (unsigned int node = 0; node < m_nodes.size(); node++) {
-        for (size_t i = 0; i < (m_nodes[node])->transformations.size(); i++) {
-            delete (m_nodes[node])->transformations[i];
-        }
-        for (size_t i = 0; i < (m_nodes[node])->primitives.size(); i++) {
-            delete (m_nodes[node])->primitives[i];
-        }
-        (m_nodes[node])->transformations.clear();
-        (m_nodes[node])->primitives.clear();
-        (m_nodes[node])->children.clear();
-        delete m_nodes[node];
-    }
-
-    m_nodes.clear();
-    m_lights.clear();
-    m_objects.clear();
+    // m_arena frees the scene graph
 }
 
 bool CS123XmlSceneParser::getGlobalData(CS123SceneGlobalData& data) const {
@@ -75,15 +61,12 @@ bool CS123XmlSceneParser::getLightData(int i, CS123SceneLightData& data) const {
         std::cout << "invalid light index %d" << std::endl;
         return false;
     }
-    data = *m_lights[i];
+    data = m_lights[i];
     return true;
 }
 
-CS123SceneNode* CS123XmlSceneParser::getRootNode() const {
-    std::map<std::string, CS123SceneNode*>::iterator node = m_objects.find("root");
-    if (node == m_objects.end())
-        return nullptr;
-    return m_objects["root"];
+const CS123SceneGraph& CS123XmlSceneParser::getSceneGraph() const {
+    return m_graph;
 }
 
 // This is where it all goes down...
@@ -95,21 +78,15 @@ bool CS123XmlSceneParser::parse() {
         return false;
     }
 
-    // Load the XML document
-    QDomDocument doc;
-    QString errorMessage;
-    int errorLine, errorColumn;
-    if (!doc.setContent(&file, &errorMessage, &errorLine, &errorColumn)) {
-        std::cout << "parse error at line " << errorLine << " col " << errorColumn << ": "
-             << errorMessage.toStdString() << std::endl;
-        return false;
-    }
-    file.close();
-
-    // Get the root element
-    QDomElement scenefile = doc.documentElement();
-    if (scenefile.tagName() != "scenefile") {
-        std::cout << "missing <scenefile>" << std::endl;
+    // Find the root element
+    QXmlStreamReader xml(&file);
+    if (!xml.readNextStartElement() || xml.name() != "scenefile") {
+        if (xml.hasError()) {
+            std::cout << "parse error at line " << xml.lineNumber() << " col " << xml.columnNumber() << ": "
+                 << xml.errorString().toStdString() << std::endl;
+        } else {
+            std::cout << "missing <scenefile>" << std::endl;
+        }
         return false;
     }
 
@@ -125,29 +102,35 @@ bool CS123XmlSceneParser::parse() {
     m_globalData.kd = 0.5f;
     m_globalData.ks = 0.5f;
 
-    // Iterate over child elements
-    QDomNode childNode = scenefile.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "globaldata") {
-            if (!parseGlobalData(e))
-                return false;
-        } else if (e.tagName() == "lightdata") {
-            if (!parseLightData(e))
-                return false;
-        } else if (e.tagName() == "cameradata") {
-            if (!parseCameraData(e))
-                return false;
-        } else if (e.tagName() == "object") {
-            if (!parseObjectData(e))
-                return false;
-        } else if (!e.isNull()) {
-            UNSUPPORTED_ELEMENT(e);
-            return false;
+    // Read the child elements as they come. Each parse function consumes its element, up to and
+    // including the end tag, and stops early if the reader finds the file is not well-formed.
+    bool parsed = true;
+    while (parsed && xml.readNextStartElement()) {
+        if (xml.name() == "globaldata") {
+            parsed = parseGlobalData(xml);
+        } else if (xml.name() == "lightdata") {
+            parsed = parseLightData(xml);
+        } else if (xml.name() == "cameradata") {
+            parsed = parseCameraData(xml);
+        } else if (xml.name() == "object") {
+            parsed = parseObjectData(xml);
+        } else {
+            UNSUPPORTED_ELEMENT(xml);
+            parsed = false;
         }
-        childNode = childNode.nextSibling();
     }
 
+    if (xml.hasError()) {
+        std::cout << "parse error at line " << xml.lineNumber() << " col " << xml.columnNumber() << ": "
+             << xml.errorString().toStdString() << std::endl;
+        return false;
+    }
+    if (!parsed) {
+        return false;
+    }
+
+    buildSceneGraph();
+
     std::cout << "finished parsing " << file_name << std::endl;
     return true;
 }
@@ -156,10 +139,10 @@ bool CS123XmlSceneParser::parse() {
  * Helper function to parse a single value, the name of which is stored in
  * name.  For example, to parse <length v="0"/>, name would need to be "v".
  */
-bool parseInt(const QDomElement &single, int &a, const char *name) {
+bool parseInt(const QXmlStreamAttributes &single, int &a, const char *name) {
     if (!single.hasAttribute(name))
         return false;
-    a = single.attribute(name).toInt();
+    a = single.value(name).toInt();
     return true;
 }
 
@@ -167,10 +150,10 @@ bool parseInt(const QDomElement &single, int &a, const char *name) {
  * Helper function to parse a single value, the name of which is stored in
  * name.  For example, to parse <length v="0"/>, name would need to be "v".
  */
-template <typename T> bool parseSingle(const QDomElement &single, T &a, const QString &str) {
+template <typename T> bool parseSingle(const QXmlStreamAttributes &single, T &a, const QString &str) {
     if (!single.hasAttribute(str))
         return false;
-    a = single.attribute(str).toDouble();
+    a = single.value(str).toDouble();
     return true;
 }
 
@@ -180,7 +163,7 @@ template <typename T> bool parseSingle(const QDomElement &single, T &a, const QS
  * <pos x="0" y="0" z="0"/>, chars would need to be "xyz".
  */
 template <typename T> bool parseTriple(
-        const QDomElement &triple,
+        const QXmlStreamAttributes &triple,
         T &a,
         T &b,
         T &c,
@@ -191,9 +174,9 @@ template <typename T> bool parseTriple(
         !triple.hasAttribute(str_b) ||
         !triple.hasAttribute(str_c))
         return false;
-    a = triple.attribute(str_a).toDouble();
-    b = triple.attribute(str_b).toDouble();
-    c = triple.attribute(str_c).toDouble();
+    a = triple.value(str_a).toDouble();
+    b = triple.value(str_b).toDouble();
+    c = triple.value(str_c).toDouble();
     return true;
 }
 
@@ -203,7 +186,7 @@ template <typename T> bool parseTriple(
  * <color r="0" g="0" b="0" a="0"/>, chars would need to be "rgba".
  */
 template <typename T> bool parseQuadruple(
-        const QDomElement &quadruple,
+        const QXmlStreamAttributes &quadruple,
         T &a,
         T &b,
         T &c,
@@ -217,10 +200,10 @@ template <typename T> bool parseQuadruple(
         !quadruple.hasAttribute(str_c) ||
         !quadruple.hasAttribute(str_d))
         return false;
-    a = quadruple.attribute(str_a).toDouble();
-    b = quadruple.attribute(str_b).toDouble();
-    c = quadruple.attribute(str_c).toDouble();
-    d = quadruple.attribute(str_d).toDouble();
+    a = quadruple.value(str_a).toDouble();
+    b = quadruple.value(str_b).toDouble();
+    c = quadruple.value(str_c).toDouble();
+    d = quadruple.value(str_d).toDouble();
     return true;
 }
 
@@ -237,27 +220,27 @@ template <typename T> bool parseQuadruple(
  *   <row a="0" b="0" c="0" d="1"/>
  * </matrix>
  */
-bool parseMatrix(const QDomElement &matrix, glm::mat4 &m) {
+bool parseMatrix(QXmlStreamReader &xml, glm::mat4 &m) {
     float *valuePtr = glm::value_ptr(m);
-    QDomNode childNode = matrix.firstChild();
     int col = 0;
 
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.isElement()) {
+    while (xml.readNextStartElement()) {
+        // Rows after the fourth are ignored
+        if (col < 4) {
+            QXmlStreamAttributes e = xml.attributes();
             float a, b, c, d;
             if (!parseQuadruple(e, a, b, c, d, "a", "b", "c", "d")
                     && !parseQuadruple(e, a, b, c, d, "v1", "v2", "v3", "v4")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
             valuePtr[0*4 + col] = a;
             valuePtr[1*4 + col] = b;
             valuePtr[2*4 + col] = c;
             valuePtr[3*4 + col] = d;
-            if (++col == 4) break;
+            col++;
         }
-        childNode = childNode.nextSibling();
+        xml.skipCurrentElement();
     }
 
     return (col == 4);
@@ -267,7 +250,7 @@ bool parseMatrix(const QDomElement &matrix, glm::mat4 &m) {
  * Helper function to parse a color.  Will parse an element with r, g, b, and
  * a attributes (the a attribute is optional and defaults to 1).
  */
-bool parseColor(const QDomElement &color, CS123SceneColor &c) {
+bool parseColor(const QXmlStreamAttributes &color, CS123SceneColor &c) {
     c.a = 1;
     return parseQuadruple(color, c.r, c.g, c.b, c.a, "r", "g", "b", "a") ||
            parseQuadruple(color, c.r, c.g, c.b, c.a, "x", "y", "z", "w") ||
@@ -279,46 +262,46 @@ bool parseColor(const QDomElement &color, CS123SceneColor &c) {
  * Helper function to parse a texture map tag.  Example texture map tag:
  * <texture file="/course/cs123/data/image/andyVanDam.jpg" u="1" v="1"/>
  */
-bool parseMap(const QDomElement &e, CS123SceneFileMap &map) {
+bool parseMap(const QXmlStreamAttributes &e, CS123SceneFileMap &map) {
     if (!e.hasAttribute("file"))
         return false;
-    map.filename = e.attribute("file").toStdString();
-    map.repeatU = e.hasAttribute("u") ? e.attribute("u").toFloat() : 1;
-    map.repeatV = e.hasAttribute("v") ? e.attribute("v").toFloat() : 1;
+    map.filename = e.value("file").toString().toStdString();
+    map.repeatU = e.hasAttribute("u") ? e.value("u").toFloat() : 1;
+    map.repeatV = e.hasAttribute("v") ? e.value("v").toFloat() : 1;
     map.isUsed = true;
     return true;
 }
 
+
 /**
  * Parse a <globaldata> tag and fill in m_globalData.
  */
-bool CS123XmlSceneParser::parseGlobalData(const QDomElement &globaldata) {
+bool CS123XmlSceneParser::parseGlobalData(QXmlStreamReader &xml) {
     // Iterate over child elements
-    QDomNode childNode = globaldata.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "ambientcoeff") {
+    while (xml.readNextStartElement()) {
+        QXmlStreamAttributes e = xml.attributes();
+        if (xml.name() == "ambientcoeff") {
             if (!parseSingle(e, m_globalData.ka, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "diffusecoeff") {
+        } else if (xml.name() == "diffusecoeff") {
             if (!parseSingle(e, m_globalData.kd, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "specularcoeff") {
+        } else if (xml.name() == "specularcoeff") {
             if (!parseSingle(e, m_globalData.ks, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "transparentcoeff") {
+        } else if (xml.name() == "transparentcoeff") {
             if (!parseSingle(e, m_globalData.kt, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
         }
-        childNode = childNode.nextSibling();
+        xml.skipCurrentElement();
     }
 
     return true;
@@ -327,10 +310,10 @@ bool CS123XmlSceneParser::parseGlobalData(const QDomElement &globaldata) {
 /**
  * Parse a <lightdata> tag and add a new CS123SceneLightData to m_lights.
  */
-bool CS123XmlSceneParser::parseLightData(const QDomElement &lightdata) {
+bool CS123XmlSceneParser::parseLightData(QXmlStreamReader &xml) {
     // Create a default light
-    CS123SceneLightData* light = new CS123SceneLightData();
-    m_lights.push_back(light);
+    m_lights.emplace_back();
+    CS123SceneLightData* light = &m_lights.back();
     memset(light, 0, sizeof(CS123SceneLightData));
     light->pos = glm::vec4(3.f, 3.f, 3.f, 1.f);
     light->dir = glm::vec4(0.f, 0.f, 0.f, 0.f);
@@ -338,107 +321,107 @@ bool CS123XmlSceneParser::parseLightData(const QDomElement &lightdata) {
     light->function = glm::vec3(1, 0, 0);
 
     // Iterate over child elements
-    QDomNode childNode = lightdata.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "id") {
+    while (xml.readNextStartElement()) {
+        QXmlStreamAttributes e = xml.attributes();
+        if (xml.name() == "id") {
             if (!parseInt(e, light->id, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "type") {
+        } else if (xml.name() == "type") {
             if (!e.hasAttribute("v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-            if (e.attribute("v") == "directional") light->type = LightType::LIGHT_DIRECTIONAL;
-            else if (e.attribute("v") == "point") light->type = LightType::LIGHT_POINT;
-            else if (e.attribute("v") == "spot") light->type = LightType::LIGHT_SPOT;
-            else if (e.attribute("v") == "area") light->type = LightType::LIGHT_AREA;
+            if (e.value("v") == "directional") light->type = LightType::LIGHT_DIRECTIONAL;
+            else if (e.value("v") == "point") light->type = LightType::LIGHT_POINT;
+            else if (e.value("v") == "spot") light->type = LightType::LIGHT_SPOT;
+            else if (e.value("v") == "area") light->type = LightType::LIGHT_AREA;
             else {
-                std::cout << ERROR_AT(e) << "unknown light type " << e.attribute("v").toStdString() << std::endl;
+                std::cout << ERROR_AT(xml) << "unknown light type " << e.value("v").toString().toStdString()
+                          << std::endl;
                 return false;
             }
-        } else if (e.tagName() == "color") {
+        } else if (xml.name() == "color") {
             if (!parseColor(e, light->color)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "function") {
+        } else if (xml.name() == "function") {
             if (!parseTriple(e, light->function.x, light->function.y, light->function.z, "a", "b", "c") &&
                 !parseTriple(e, light->function.x, light->function.y, light->function.z, "x", "y", "z") &&
                 !parseTriple(e, light->function.x, light->function.y, light->function.z, "v1", "v2", "v3")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "position") {
+        } else if (xml.name() == "position") {
             if (light->type == LightType::LIGHT_DIRECTIONAL) {
-                std::cout << ERROR_AT(e) << "position is not applicable to directional lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "position is not applicable to directional lights" << std::endl;
                 return false;
             }
             if (!parseTriple(e, light->pos.x, light->pos.y, light->pos.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "direction") {
+        } else if (xml.name() == "direction") {
             if (light->type == LightType::LIGHT_POINT) {
-                std::cout << ERROR_AT(e) << "direction is not applicable to point lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "direction is not applicable to point lights" << std::endl;
                 return false;
             }
             if (!parseTriple(e, light->dir.x, light->dir.y, light->dir.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "radius") {
+        } else if (xml.name() == "radius") {
             if (light->type != LightType::LIGHT_SPOT) {
-                std::cout << ERROR_AT(e) << "radius is only applicable to spot lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "radius is only applicable to spot lights" << std::endl;
                 return false;
             }
             if (!parseSingle(e, light->radius, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "penumbra") {
+        } else if (xml.name() == "penumbra") {
             if (light->type != LightType::LIGHT_SPOT) {
-                std::cout << ERROR_AT(e) << "penumbra is only applicable to spot lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "penumbra is only applicable to spot lights" << std::endl;
                 return false;
             }
             if (!parseSingle(e, light->penumbra, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "angle") {
+        } else if (xml.name() == "angle") {
             if (light->type != LightType::LIGHT_SPOT) {
-                std::cout << ERROR_AT(e) << "angle is only applicable to spot lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "angle is only applicable to spot lights" << std::endl;
                 return false;
             }
             if (!parseSingle(e, light->angle, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "width") {
+        } else if (xml.name() == "width") {
             if (light->type != LightType::LIGHT_AREA) {
-                std::cout << ERROR_AT(e) << "width is only applicable to area lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "width is only applicable to area lights" << std::endl;
                 return false;
             }
             if (!parseSingle(e, light->width, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "height") {
+        } else if (xml.name() == "height") {
             if (light->type != LightType::LIGHT_AREA) {
-                std::cout << ERROR_AT(e) << "height is only applicable to area lights" << std::endl;
+                std::cout << ERROR_AT(xml) << "height is only applicable to area lights" << std::endl;
                 return false;
             }
             if (!parseSingle(e, light->height, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (!e.isNull()) {
-            UNSUPPORTED_ELEMENT(e);
+        } else {
+            UNSUPPORTED_ELEMENT(xml);
             return false;
         }
-        childNode = childNode.nextSibling();
+        xml.skipCurrentElement();
     }
 
     return true;
@@ -447,27 +430,26 @@ bool CS123XmlSceneParser::parseLightData(const QDomElement &lightdata) {
 /**
  * Parse a <cameradata> tag and fill in m_cameraData.
  */
-bool CS123XmlSceneParser::parseCameraData(const QDomElement &cameradata) {
+bool CS123XmlSceneParser::parseCameraData(QXmlStreamReader &xml) {
     bool focusFound = false;
     bool lookFound = false;
 
     // Iterate over child elements
-    QDomNode childNode = cameradata.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "pos") {
+    while (xml.readNextStartElement()) {
+        QXmlStreamAttributes e = xml.attributes();
+        if (xml.name() == "pos") {
             if (!parseTriple(e, m_cameraData.pos.x, m_cameraData.pos.y, m_cameraData.pos.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
             m_cameraData.pos.w = 1;
-        } else if (e.tagName() == "look" || e.tagName() == "focus") {
+        } else if (xml.name() == "look" || xml.name() == "focus") {
             if (!parseTriple(e, m_cameraData.look.x, m_cameraData.look.y, m_cameraData.look.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
 
-            if (e.tagName() == "focus") {
+            if (xml.name() == "focus") {
                 // Store the focus point in the look vector (we will later subtract
                 // the camera position from this to get the actual look vector)
                 m_cameraData.look.w = 1;
@@ -477,42 +459,42 @@ bool CS123XmlSceneParser::parseCameraData(const QDomElement &cameradata) {
                 m_cameraData.look.w = 0;
                 lookFound = true;
             }
-        } else if (e.tagName() == "up") {
+        } else if (xml.name() == "up") {
             if (!parseTriple(e, m_cameraData.up.x, m_cameraData.up.y, m_cameraData.up.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
             m_cameraData.up.w = 0;
-        } else if (e.tagName() == "heightangle") {
+        } else if (xml.name() == "heightangle") {
             if (!parseSingle(e, m_cameraData.heightAngle, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "aspectratio") {
+        } else if (xml.name() == "aspectratio") {
             if (!parseSingle(e, m_cameraData.aspectRatio, "v"))
             {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "aperture") {
+        } else if (xml.name() == "aperture") {
             if (!parseSingle(e, m_cameraData.aperture, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "focallength") {
+        } else if (xml.name() == "focallength") {
             if (!parseSingle(e, m_cameraData.focalLength, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (!e.isNull()) {
-            UNSUPPORTED_ELEMENT(e);
+        } else {
+            UNSUPPORTED_ELEMENT(xml);
             return false;
         }
-        childNode = childNode.nextSibling();
+        xml.skipCurrentElement();
     }
 
     if (focusFound && lookFound) {
-        std::cout << ERROR_AT(cameradata) << "camera can not have both look and focus" << std::endl;
+        std::cout << ERROR_AT(xml) << "camera can not have both look and focus" << std::endl;
         return false;
     }
 
@@ -526,49 +508,45 @@ bool CS123XmlSceneParser::parseCameraData(const QDomElement &cameradata) {
 }
 
 /**
- * Parse an <object> tag and create a new CS123SceneNode in m_nodes.
+ * Parse an <object> tag and add a new node to the scene graph.
  */
-bool CS123XmlSceneParser::parseObjectData(const QDomElement &object) {
+bool CS123XmlSceneParser::parseObjectData(QXmlStreamReader &xml) {
+    QXmlStreamAttributes object = xml.attributes();
     if (!object.hasAttribute("name")) {
-        PARSE_ERROR(object);
+        PARSE_ERROR(xml);
         return false;
     }
 
-    if (object.attribute("type") != "tree") {
+    if (object.value("type") != "tree") {
         std::cout << "top-level <object> elements must be of type tree" << std::endl;
         return false;
     }
 
-    std::string name = object.attribute("name").toStdString();
+    std::string name = object.value("name").toString().toStdString();
 
     // Check that this object does not exist
-    if (m_objects[name]) {
-        std::cout << ERROR_AT(object) << "two objects with the same name: " << name << std::endl;
+    if (m_objects.count(name)) {
+        std::cout << ERROR_AT(xml) << "two objects with the same name: " << name << std::endl;
         return false;
     }
 
     // Create the object and add to the map
-    CS123SceneNode *node = new CS123SceneNode;
-    m_nodes.push_back(node);
+    int node = addNode();
     m_objects[name] = node;
 
     // Iterate over child elements
-    QDomNode childNode = object.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "transblock") {
-            CS123SceneNode *child = new CS123SceneNode;
-            m_nodes.push_back(child);
-            if (!parseTransBlock(e, child)) {
-                PARSE_ERROR(e);
-                return false;
-            }
-            node->children.push_back(child);
-        } else if (!e.isNull()) {
-            UNSUPPORTED_ELEMENT(e);
+    while (xml.readNextStartElement()) {
+        if (xml.name() == "transblock") {
+            int child = addNode();
+            if (!parseTransBlock(xml, child)) {
+                std::cout << ERROR_AT(xml) << "could not parse <transblock>" << std::endl;
+                return false;
+            }
+            addChild(node, child);
+        } else {
+            UNSUPPORTED_ELEMENT(xml);
             return false;
         }
-        childNode = childNode.nextSibling();
     }
 
     return true;
@@ -588,91 +566,88 @@ bool CS123XmlSceneParser::parseObjectData(const QDomElement &object) {
  *   <object type="primitive" name="sphere"/>
  * </transblock>
  */
-bool CS123XmlSceneParser::parseTransBlock(const QDomElement &transblock, CS123SceneNode* node) {
+bool CS123XmlSceneParser::parseTransBlock(QXmlStreamReader &xml, int node) {
     // Iterate over child elements
-    QDomNode childNode = transblock.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "translate") {
-            CS123SceneTransformation *t = new CS123SceneTransformation();
-            node->transformations.push_back(t);
+    while (xml.readNextStartElement()) {
+        QXmlStreamAttributes e = xml.attributes();
+        if (xml.name() == "translate") {
+            CS123SceneTransformation *t = addTransformation(node);
             t->type = TRANSFORMATION_TRANSLATE;
 
             if (!parseTriple(e, t->translate.x, t->translate.y, t->translate.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "rotate") {
-            CS123SceneTransformation *t = new CS123SceneTransformation();
-            node->transformations.push_back(t);
+            xml.skipCurrentElement();
+        } else if (xml.name() == "rotate") {
+            CS123SceneTransformation *t = addTransformation(node);
             t->type = TRANSFORMATION_ROTATE;
 
             float angle;
             if (!parseQuadruple(e, t->rotate.x, t->rotate.y, t->rotate.z, angle, "x", "y", "z", "angle")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
 
             // Convert to radians
             t->angle = angle * M_PI / 180;
-        } else if (e.tagName() == "scale") {
-            CS123SceneTransformation *t = new CS123SceneTransformation();
-            node->transformations.push_back(t);
+            xml.skipCurrentElement();
+        } else if (xml.name() == "scale") {
+            CS123SceneTransformation *t = addTransformation(node);
             t->type = TRANSFORMATION_SCALE;
 
             if (!parseTriple(e, t->scale.x, t->scale.y, t->scale.z, "x", "y", "z")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "matrix") {
-            CS123SceneTransformation* t = new CS123SceneTransformation();
-            node->transformations.push_back(t);
+            xml.skipCurrentElement();
+        } else if (xml.name() == "matrix") {
+            CS123SceneTransformation* t = addTransformation(node);
             t->type = TRANSFORMATION_MATRIX;
 
-            if (!parseMatrix(e, t->matrix)) {
-                PARSE_ERROR(e);
+            // parseMatrix reads the rows, and with them the end of the element
+            if (!parseMatrix(xml, t->matrix)) {
+                std::cout << ERROR_AT(xml) << "could not parse <matrix>" << std::endl;
                 return false;
             }
-        } else if (e.tagName() == "object") {
-            if (e.attribute("type") == "master") {
-                std::string masterName = e.attribute("name").toStdString();
-                if (!m_objects[masterName]) {
-                    std::cout << ERROR_AT(e) << "invalid master object reference: " << masterName << std::endl;
+        } else if (xml.name() == "object") {
+            if (e.value("type") == "master") {
+                std::string masterName = e.value("name").toString().toStdString();
+                std::map<std::string, int>::iterator master = m_objects.find(masterName);
+                if (master == m_objects.end()) {
+                    std::cout << ERROR_AT(xml) << "invalid master object reference: " << masterName << std::endl;
                     return false;
                 }
-                node->children.push_back(m_objects[masterName]);
-            } else if (e.attribute("type") == "tree") {
-                QDomNode subNode = e.firstChild();
-                while (!subNode.isNull()) {
-                    QDomElement e = subNode.toElement();
-                    if (e.tagName() == "transblock") {
-                        CS123SceneNode* n = new CS123SceneNode;
-                        m_nodes.push_back(n);
-                        node->children.push_back(n);
-                        if (!parseTransBlock(e, n)) {
-                            PARSE_ERROR(e);
+                addChild(node, master->second);
+                xml.skipCurrentElement();
+            } else if (e.value("type") == "tree") {
+                while (xml.readNextStartElement()) {
+                    if (xml.name() == "transblock") {
+                        int n = addNode();
+                        addChild(node, n);
+                        if (!parseTransBlock(xml, n)) {
+                            std::cout << ERROR_AT(xml) << "could not parse <transblock>" << std::endl;
                             return false;
                         }
-                    } else if (!e.isNull()) {
-                        UNSUPPORTED_ELEMENT(e);
+                    } else {
+                        UNSUPPORTED_ELEMENT(xml);
                         return false;
                     }
-                    subNode = subNode.nextSibling();
                 }
-            } else if (e.attribute("type") == "primitive") {
-                if (!parsePrimitive(e, node)) {
-                    PARSE_ERROR(e);
+            } else if (e.value("type") == "primitive") {
+                if (!parsePrimitive(xml, node)) {
+                    std::cout << ERROR_AT(xml) << "could not parse <object>" << std::endl;
                     return false;
                 }
             } else {
-                std::cout << ERROR_AT(e) << "invalid object type: " << e.attribute("type").toStdString() << std::endl;
+                std::cout << ERROR_AT(xml) << "invalid object type: " << e.value("type").toString().toStdString()
+                          << std::endl;
                 return false;
             }
-        } else if (!e.isNull()) {
-            UNSUPPORTED_ELEMENT(e);
+        } else {
+            UNSUPPORTED_ELEMENT(xml);
             return false;
         }
-        childNode = childNode.nextSibling();
     }
 
     return true;
@@ -681,19 +656,19 @@ bool CS123XmlSceneParser::parseTransBlock(const QDomElement &transblock, CS123Sc
 /**
  * Parse an <object type="primitive"> tag into node.
  */
-bool CS123XmlSceneParser::parsePrimitive(const QDomElement &prim, CS123SceneNode* node) {
+bool CS123XmlSceneParser::parsePrimitive(QXmlStreamReader &xml, int node) {
     // Default primitive
-    CS123ScenePrimitive* primitive = new CS123ScenePrimitive();
+    CS123ScenePrimitive* primitive = addPrimitive(node);
     CS123SceneMaterial& mat = primitive->material;
     mat.clear();
     primitive->type = PrimitiveType::PRIMITIVE_CUBE;
     mat.textureMap.isUsed = false;
     mat.bumpMap.isUsed = false;
     mat.cDiffuse.r = mat.cDiffuse.g = mat.cDiffuse.b = 1;
-    node->primitives.push_back(primitive);
 
     // Parse primitive type
-    std::string primType = prim.attribute("name").toStdString();
+    QXmlStreamAttributes prim = xml.attributes();
+    std::string primType = prim.value("name").toString().toStdString();
     if (primType == "sphere") primitive->type = PrimitiveType::PRIMITIVE_SPHERE;
     else if (primType == "cube") primitive->type = PrimitiveType::PRIMITIVE_CUBE;
     else if (primType == "cylinder") primitive->type = PrimitiveType::PRIMITIVE_CYLINDER;
@@ -702,9 +677,9 @@ bool CS123XmlSceneParser::parsePrimitive(const QDomElement &prim, CS123SceneNode
     else if (primType == "mesh") {
         primitive->type = PrimitiveType::PRIMITIVE_MESH;
         if (prim.hasAttribute("meshfile")) {
-            primitive->meshfile = prim.attribute("meshfile").toStdString();
+            primitive->meshfile = prim.value("meshfile").toString().toStdString();
         } else if (prim.hasAttribute("filename")) {
-            primitive->meshfile = prim.attribute("filename").toStdString();
+            primitive->meshfile = prim.value("filename").toString().toStdString();
         } else {
             std::cout << "mesh object must specify filename" << std::endl;
             return false;
@@ -712,70 +687,176 @@ bool CS123XmlSceneParser::parsePrimitive(const QDomElement &prim, CS123SceneNode
     }
 
     // Iterate over child elements
-    QDomNode childNode = prim.firstChild();
-    while (!childNode.isNull()) {
-        QDomElement e = childNode.toElement();
-        if (e.tagName() == "diffuse") {
+    while (xml.readNextStartElement()) {
+        QXmlStreamAttributes e = xml.attributes();
+        if (xml.name() == "diffuse") {
             if (!parseColor(e, mat.cDiffuse)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "ambient") {
+        } else if (xml.name() == "ambient") {
             if (!parseColor(e, mat.cAmbient)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "reflective") {
+        } else if (xml.name() == "reflective") {
             if (!parseColor(e, mat.cReflective)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "specular") {
+        } else if (xml.name() == "specular") {
             if (!parseColor(e, mat.cSpecular)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "emissive") {
+        } else if (xml.name() == "emissive") {
             if (!parseColor(e, mat.cEmissive)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "transparent") {
+        } else if (xml.name() == "transparent") {
             if (!parseColor(e, mat.cTransparent)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "shininess") {
+        } else if (xml.name() == "shininess") {
             if (!parseSingle(e, mat.shininess, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "ior") {
+        } else if (xml.name() == "ior") {
             if (!parseSingle(e, mat.ior, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "texture") {
+        } else if (xml.name() == "texture") {
             if (!parseMap(e, mat.textureMap)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "bumpmap") {
+        } else if (xml.name() == "bumpmap") {
             if (!parseMap(e, mat.bumpMap)) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
-        } else if (e.tagName() == "blend") {
+        } else if (xml.name() == "blend") {
             if (!parseSingle(e, mat.blend, "v")) {
-                PARSE_ERROR(e);
+                PARSE_ERROR(xml);
                 return false;
             }
         } else {
-            UNSUPPORTED_ELEMENT(e);
+            UNSUPPORTED_ELEMENT(xml);
             return false;
         }
-        childNode = childNode.nextSibling();
+        xml.skipCurrentElement();
     }
 
     return true;
 }
+
+/**
+ * Add a node to the scene graph, returning its index.
+ */
+int CS123XmlSceneParser::addNode() {
+    return m_numNodes++;
+}
+
+/**
+ * Add a transformation to the end of a node's transformations. The pointer is only valid until
+ * the next one is added.
+ */
+CS123SceneTransformation* CS123XmlSceneParser::addTransformation(int node) {
+    m_transformations.emplace_back();
+    m_transformationNodes.push_back(node);
+    return &m_transformations.back();
+}
+
+/**
+ * Add a primitive to the end of a node's primitives. The pointer is only valid until the next
+ * one is added.
+ */
+CS123ScenePrimitive* CS123XmlSceneParser::addPrimitive(int node) {
+    m_primitives.emplace_back();
+    m_primitiveNodes.push_back(node);
+    return &m_primitives.back();
+}
+
+void CS123XmlSceneParser::addChild(int node, int child) {
+    m_children.push_back(child);
+    m_childNodes.push_back(node);
+}
+
+/**
+ * Lay out the scene graph in m_arena: the nodes, then every node's transformations, primitives
+ * and children, each in file order and grouped by node so that a node refers to them as a range.
+ * The whole graph is one allocation.
+ */
+void CS123XmlSceneParser::buildSceneGraph() {
+    int numTransformations = m_transformations.size();
+    int numPrimitives = m_primitives.size();
+    int numChildren = m_children.size();
+    m_arena.reserve(CS123SceneArena::getArraySize<CS123SceneNode>(m_numNodes)
+                    + CS123SceneArena::getArraySize<CS123SceneTransformation>(numTransformations)
+                    + CS123SceneArena::getArraySize<CS123ScenePrimitive>(numPrimitives)
+                    + CS123SceneArena::getArraySize<int>(numChildren));
+    CS123SceneNode *nodes = m_arena.createArray<CS123SceneNode>(m_numNodes);
+    CS123SceneTransformation *transformations =
+            m_arena.createArray<CS123SceneTransformation>(numTransformations);
+    CS123ScenePrimitive *primitives = m_arena.createArray<CS123ScenePrimitive>(numPrimitives);
+    int *children = m_arena.createArray<int>(numChildren);
+
+    // Count what each node has, and from that where its ranges start
+    for (int i = 0; i < numTransformations; i++) {
+        nodes[m_transformationNodes[i]].numTransformations++;
+    }
+    for (int i = 0; i < numPrimitives; i++) {
+        nodes[m_primitiveNodes[i]].numPrimitives++;
+    }
+    for (int i = 0; i < numChildren; i++) {
+        nodes[m_childNodes[i]].numChildren++;
+    }
+    int firstTransformation = 0, firstPrimitive = 0, firstChild = 0;
+    for (int i = 0; i < m_numNodes; i++) {
+        CS123SceneNode &node = nodes[i];
+        node.firstTransformation = firstTransformation;
+        node.firstPrimitive = firstPrimitive;
+        node.firstChild = firstChild;
+        firstTransformation += node.numTransformations;
+        firstPrimitive += node.numPrimitives;
+        firstChild += node.numChildren;
+        node.numTransformations = node.numPrimitives = node.numChildren = 0;
+    }
+
+    // Then fill in the ranges, counting again as they grow
+    for (int i = 0; i < numTransformations; i++) {
+        CS123SceneNode &node = nodes[m_transformationNodes[i]];
+        transformations[node.firstTransformation + node.numTransformations++] = m_transformations[i];
+    }
+    for (int i = 0; i < numPrimitives; i++) {
+        CS123SceneNode &node = nodes[m_primitiveNodes[i]];
+        primitives[node.firstPrimitive + node.numPrimitives++] = std::move(m_primitives[i]);
+    }
+    for (int i = 0; i < numChildren; i++) {
+        CS123SceneNode &node = nodes[m_childNodes[i]];
+        children[node.firstChild + node.numChildren++] = m_children[i];
+    }
+
+    std::map<std::string, int>::iterator root = m_objects.find("root");
+    m_graph.nodes = nodes;
+    m_graph.numNodes = m_numNodes;
+    m_graph.transformations = transformations;
+    m_graph.numTransformations = numTransformations;
+    m_graph.primitives = primitives;
+    m_graph.numPrimitives = numPrimitives;
+    m_graph.children = children;
+    m_graph.numChildren = numChildren;
+    m_graph.root = root == m_objects.end() ? -1 : root->second;
+
+    // The file order is no longer needed
+    std::vector<CS123SceneTransformation>().swap(m_transformations);
+    std::vector<int>().swap(m_transformationNodes);
+    std::vector<CS123ScenePrimitive>().swap(m_primitives);
+    std::vector<int>().swap(m_primitiveNodes);
+    std::vector<int>().swap(m_children);
+    std::vector<int>().swap(m_childNodes);
+}
@@ -2,12 +2,13 @@
 #define __CS123XMLSCENEPARSER__
 
 #include "CS123ISceneParser.h"
+#include "CS123SceneArena.h"
 #include "CS123SceneData.h"
 
 #include <vector>
 #include <map>
 
-#include <QtXml>
+#include <QXmlStreamReader>
 
 /**
  * @class CS123XmlSceneParser
@@ -16,6 +17,10 @@
  *
  * The parser is designed to replace the TinyXML parser that was in turn designed to replace the
  * Flex/Yacc/Bison parser.
+ *
+ * The file is read in a single pass with a QXmlStreamReader, so no document tree is ever built:
+ * each element is turned into scene data as soon as it is read. Once the file has been read, the
+ * scene graph is laid out as flat arrays in m_arena, where it stays until the parser is destroyed.
  */
 class CS123XmlSceneParser : public CS123ISceneParser {
 
@@ -33,7 +38,7 @@ public:
 
     virtual bool getCameraData(CS123SceneCameraData& data) const;
 
-    virtual CS123SceneNode* getRootNode() const;
+    virtual const CS123SceneGraph& getSceneGraph() const;
 
     virtual int getNumLights() const;
 
@@ -44,19 +49,38 @@ public:
 private:
     // The filename should be contained within this parser implementation.
     // If you want to parse a new file, instantiate a different parser.
-    bool parseGlobalData(const QDomElement &globaldata);
-    bool parseCameraData(const QDomElement &cameradata);
-    bool parseLightData(const QDomElement &lightdata);
-    bool parseObjectData(const QDomElement &object);
-    bool parseTransBlock(const QDomElement &transblock, CS123SceneNode* node);
-    bool parsePrimitive(const QDomElement &prim, CS123SceneNode* node);
+    bool parseGlobalData(QXmlStreamReader &xml);
+    bool parseCameraData(QXmlStreamReader &xml);
+    bool parseLightData(QXmlStreamReader &xml);
+    bool parseObjectData(QXmlStreamReader &xml);
+    bool parseTransBlock(QXmlStreamReader &xml, int node);
+    bool parsePrimitive(QXmlStreamReader &xml, int node);
+
+    int addNode();
+    CS123SceneTransformation* addTransformation(int node);
+    CS123ScenePrimitive* addPrimitive(int node);
+    void addChild(int node, int child);
+    void buildSceneGraph();
 
     std::string file_name;
-    mutable std::map<std::string, CS123SceneNode*> m_objects;
+    // Index of the node of each named object
+    std::map<std::string, int> m_objects;
     CS123SceneCameraData m_cameraData;
-    std::vector<CS123SceneLightData*> m_lights;
+    std::vector<CS123SceneLightData> m_lights;
     CS123SceneGlobalData m_globalData;
-    std::vector<CS123SceneNode*> m_nodes;
+
+    // The scene graph as it is read: every transformation, primitive and child in file order,
+    // along with the index of the node it belongs to. buildSceneGraph groups them by node.
+    int m_numNodes;
+    std::vector<CS123SceneTransformation> m_transformations;
+    std::vector<int> m_transformationNodes;
+    std::vector<CS123ScenePrimitive> m_primitives;
+    std::vector<int> m_primitiveNodes;
+    std::vector<int> m_children;
+    std::vector<int> m_childNodes;
+
+    CS123SceneGraph m_graph;
+    CS123SceneArena m_arena;
 };
 
 #endif
@@ -0,0 +1,223 @@
+#include "BVH.h"
+
+// Number of centroid bins evaluated per split
+const int numSAHBins = 16;
+// Leaves are always made at or below this many primitives...
+const int minLeafSize = 2;
+// ...and never above this many, unless the primitives cannot be separated
+const int maxLeafSize = 8;
+// Cost of traversing a node relative to intersecting one primitive
+const float traversalCost = 1.f;
+// Keeps the tree shallow enough for the fixed-size traversal stacks
+const int maxBuildDepth = 48;
+
+BoundingBox::BoundingBox() :
+    min(glm::vec3(INFINITY)),
+    max(glm::vec3(-INFINITY))
+{
+}
+
+BoundingBox::BoundingBox(glm::vec3 min, glm::vec3 max) :
+    min(min),
+    max(max)
+{
+}
+
+void BoundingBox::grow(const BoundingBox &that) {
+    min = glm::min(min, that.min);
+    max = glm::max(max, that.max);
+}
+
+void BoundingBox::grow(glm::vec3 point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+glm::vec3 BoundingBox::centroid() const {
+    return 0.5f * (min + max);
+}
+
+float BoundingBox::surfaceArea() const {
+    if (isEmpty()) {
+        return 0.f;
+    }
+    glm::vec3 extent = max - min;
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+bool BoundingBox::isEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+bool BoundingBox::contains(glm::vec3 point) const {
+    return point.x >= min.x && point.y >= min.y && point.z >= min.z
+            && point.x <= max.x && point.y <= max.y && point.z <= max.z;
+}
+
+BoundingBox transformedBounds(const BoundingBox &objectBounds, const glm::mat4 &objectToWorld) {
+    BoundingBox bounds;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 objectSpaceCorner = glm::vec4((corner & 1) ? objectBounds.max.x : objectBounds.min.x,
+                                                (corner & 2) ? objectBounds.max.y : objectBounds.min.y,
+                                                (corner & 4) ? objectBounds.max.z : objectBounds.min.z, 1.f);
+        bounds.grow(glm::vec3(objectToWorld * objectSpaceCorner));
+    }
+    return bounds;
+}
+
+BoundingBox transformedUnitBounds(const glm::mat4 &objectToWorld) {
+    return transformedBounds(BoundingBox(glm::vec3(-radius), glm::vec3(radius)), objectToWorld);
+}
+
+
+BVH::BVH() :
+    m_nodeData(nullptr),
+    m_numNodes(0),
+    m_indexData(nullptr),
+    m_numIndices(0)
+{
+}
+
+void BVH::build(const std::vector<BoundingBox> &primitiveBounds) {
+    m_nodes.clear();
+    m_primitiveIndices.resize(primitiveBounds.size());
+    m_nodeData = nullptr;
+    m_numNodes = 0;
+    m_indexData = m_primitiveIndices.data();
+    m_numIndices = m_primitiveIndices.size();
+    if (primitiveBounds.empty()) {
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(primitiveBounds.size());
+    for (int i = 0; i < primitiveBounds.size(); i++) {
+        m_primitiveIndices[i] = i;
+        centroids[i] = primitiveBounds[i].centroid();
+    }
+    m_nodes.reserve(2 * primitiveBounds.size());
+    buildRecursive(primitiveBounds, centroids, 0, primitiveBounds.size(), 0);
+    m_nodeData = m_nodes.data();
+    m_numNodes = m_nodes.size();
+}
+
+void BVH::attach(const Node *nodes, int numNodes, const int *primitiveIndices, int numPrimitiveIndices) {
+    m_nodes.clear();
+    m_primitiveIndices.clear();
+    m_nodeData = nodes;
+    m_numNodes = numNodes;
+    m_indexData = primitiveIndices;
+    m_numIndices = numPrimitiveIndices;
+}
+
+/**
+ *  Build the subtree over m_primitiveIndices[begin, end). Centroids are binned along the
+ *  longest axis of their bounds and the split with the lowest surface area heuristic cost
+ *  is taken, unless making a leaf is cheaper.
+ */
+int BVH::buildRecursive(const std::vector<BoundingBox> &bounds, const std::vector<glm::vec3> &centroids,
+                        int begin, int end, int depth) {
+    int nodeIndex = m_nodes.size();
+    m_nodes.push_back(Node());
+
+    BoundingBox nodeBounds;
+    BoundingBox centroidBounds;
+    for (int i = begin; i < end; i++) {
+        nodeBounds.grow(bounds[m_primitiveIndices[i]]);
+        centroidBounds.grow(centroids[m_primitiveIndices[i]]);
+    }
+    m_nodes[nodeIndex].bounds = nodeBounds;
+
+    int count = end - begin;
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    if (count <= minLeafSize || extent[axis] <= 0.f || depth >= maxBuildDepth) {
+        m_nodes[nodeIndex].offset = begin;
+        m_nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+
+    // Bin centroids along the split axis
+    int binCounts[numSAHBins] = {};
+    BoundingBox binBounds[numSAHBins];
+    float binScale = numSAHBins / extent[axis];
+    auto binOf = [&](int primitive) {
+        int bin = static_cast<int>((centroids[primitive][axis] - centroidBounds.min[axis]) * binScale);
+        return std::min(bin, numSAHBins - 1);
+    };
+    for (int i = begin; i < end; i++) {
+        int bin = binOf(m_primitiveIndices[i]);
+        binCounts[bin]++;
+        binBounds[bin].grow(bounds[m_primitiveIndices[i]]);
+    }
+
+    // Sweep from the right to get the cost of everything right of each split, then from the left
+    float rightCost[numSAHBins];
+    BoundingBox rightBounds;
+    int rightCount = 0;
+    for (int bin = numSAHBins - 1; bin > 0; bin--) {
+        rightBounds.grow(binBounds[bin]);
+        rightCount += binCounts[bin];
+        rightCost[bin] = rightCount * rightBounds.surfaceArea();
+    }
+    float bestCost = INFINITY;
+    int bestSplit = -1;
+    BoundingBox leftBounds;
+    int leftCount = 0;
+    for (int split = 1; split < numSAHBins; split++) {
+        leftBounds.grow(binBounds[split - 1]);
+        leftCount += binCounts[split - 1];
+        float cost = leftCount * leftBounds.surfaceArea() + rightCost[split];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = split;
+        }
+    }
+
+    float splitCost = traversalCost + bestCost / nodeBounds.surfaceArea();
+    if (bestSplit < 0 || (splitCost >= count && count <= maxLeafSize)) {
+        m_nodes[nodeIndex].offset = begin;
+        m_nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+
+    int *middle = std::partition(m_primitiveIndices.data() + begin, m_primitiveIndices.data() + end,
+                                 [&](int primitive) { return binOf(primitive) < bestSplit; });
+    int mid = middle - m_primitiveIndices.data();
+    if (mid == begin || mid == end) {
+        // All centroids landed on one side; fall back to an even split
+        mid = (begin + end) / 2;
+        std::nth_element(m_primitiveIndices.begin() + begin, m_primitiveIndices.begin() + mid,
+                         m_primitiveIndices.begin() + end, [&](int a, int b) {
+            return centroids[a][axis] < centroids[b][axis];
+        });
+    }
+
+    buildRecursive(bounds, centroids, begin, mid, depth + 1);
+    int right = buildRecursive(bounds, centroids, mid, end, depth + 1);
+    m_nodes[nodeIndex].offset = right;
+    m_nodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+bool BVH::isEmpty() const {
+    return m_numNodes == 0;
+}
+
+int BVH::getNumNodes() const {
+    return m_numNodes;
+}
+
+const BVH::Node *BVH::getNodes() const {
+    return m_nodeData;
+}
+
+int BVH::getNumPrimitiveIndices() const {
+    return m_numIndices;
+}
+
+const int *BVH::getPrimitiveIndices() const {
+    return m_indexData;
+}
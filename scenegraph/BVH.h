@@ -0,0 +1,374 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "RayGeometry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/** An axis-aligned bounding box */
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    BoundingBox();
+    BoundingBox(glm::vec3 min, glm::vec3 max);
+    void grow(const BoundingBox &that);
+    void grow(glm::vec3 point);
+    glm::vec3 centroid() const;
+    float surfaceArea() const;
+    bool isEmpty() const;
+    bool contains(glm::vec3 point) const;
+};
+
+// World space bounds of an object space box
+BoundingBox transformedBounds(const BoundingBox &objectBounds, const glm::mat4 &objectToWorld);
+// World space bounds of an implicit shape, which fills [-radius, radius]^3 in object space
+BoundingBox transformedUnitBounds(const glm::mat4 &objectToWorld);
+
+/**
+ * @class BVH
+ *
+ * Bounding volume hierarchy over the world space bounds of a set of primitives, built top-down
+ * with the binned surface area heuristic. The tree only knows primitive indices; the caller
+ * supplies the primitive test to the traversals:
+ *
+ *   closestHit(ray, tBest, hit)   hit(i, tBest) tests primitive i and, if it is hit closer
+ *                                 than tBest, lowers tBest and returns true
+ *   anyHit(ray, tMax, occludes)   occludes(i, tMax) returns whether primitive i blocks the ray
+ *                                 before tMax; traversal stops at the first one that does
+ *   closestHit(packet, tBest, hit)
+ *                                 as closestHit for each ray of the packet, visiting each node
+ *                                 once for the whole packet; hit(i, ray, tBest) tests primitive i
+ *                                 against packet ray number ray and lowers tBest[ray]
+ *   forEachContaining(point, visit)
+ *                                 visit(i) for every primitive whose bounds contain the point
+ *
+ * All traversals use a fixed-size stack and never allocate. The ray traversals add the number of
+ * nodes they visit to numNodesVisited if it is given.
+ *
+ * The tree is two flat arrays, which a BVH either builds and owns or, through attach, views in
+ * memory owned by someone else, such as a mapped scene cache.
+ */
+class BVH
+{
+public:
+    struct Node {
+        BoundingBox bounds;
+        // Interior: index of the right child (the left child follows this node).
+        // Leaf: index of the first primitive in the primitive index array.
+        int offset;
+        // Number of primitives in a leaf, 0 for interior nodes
+        int count;
+    };
+
+    BVH();
+    // The arrays may be views, so a BVH is never copied
+    BVH(const BVH &that) = delete;
+    BVH &operator=(const BVH &that) = delete;
+
+    void build(const std::vector<BoundingBox> &primitiveBounds);
+    // Use arrays saved from an earlier build instead of building; they must outlive this BVH
+    void attach(const Node *nodes, int numNodes, const int *primitiveIndices, int numPrimitiveIndices);
+    bool isEmpty() const;
+    int getNumNodes() const;
+    const Node *getNodes() const;
+    int getNumPrimitiveIndices() const;
+    const int *getPrimitiveIndices() const;
+
+    template <typename HitFunction>
+    void closestHit(const Ray &ray, float &tBest, HitFunction hit,
+                    uint64_t *numNodesVisited = nullptr) const;
+    template <typename OcclusionFunction>
+    bool anyHit(const Ray &ray, float tMax, OcclusionFunction occludes,
+                uint64_t *numNodesVisited = nullptr) const;
+    template <typename PacketHitFunction>
+    void closestHit(const RayPacket &packet, float tBest[rayPacketSize], PacketHitFunction hit,
+                    uint64_t *numNodesVisited = nullptr) const;
+    template <typename VisitFunction>
+    void forEachContaining(glm::vec3 point, VisitFunction visit) const;
+
+    // Slab test: t at which the ray enters box, clamped to 0, or INFINITY if it misses it
+    // before tMax
+    static float intersectBox(const BoundingBox &box, const glm::vec3 &origin,
+                              const glm::vec3 &inverseDirection, float tMax);
+
+private:
+    static const int maxTraversalDepth = 64;
+
+    int buildRecursive(const std::vector<BoundingBox> &bounds, const std::vector<glm::vec3> &centroids,
+                       int begin, int end, int depth);
+    static float intersectBox(const BoundingBox &box, const RayPacket &packet,
+                              const float tMax[rayPacketSize], float tEnter[rayPacketSize]);
+
+    // Storage for a tree built here; empty if the arrays were attached
+    std::vector<Node> m_nodes;
+    std::vector<int> m_primitiveIndices;
+    // The arrays the traversals read
+    const Node *m_nodeData;
+    int m_numNodes;
+    const int *m_indexData;
+    int m_numIndices;
+};
+
+inline float BVH::intersectBox(const BoundingBox &box, const glm::vec3 &origin,
+                               const glm::vec3 &inverseDirection, float tMax) {
+    glm::vec3 t0 = (box.min - origin) * inverseDirection;
+    glm::vec3 t1 = (box.max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return tEnter <= tExit ? tEnter : INFINITY;
+}
+
+/**
+ *  Slab test for every ray of a packet. tEnter[i] is set to the entry t of ray i, or INFINITY if
+ *  it misses; the smallest of them is returned.
+ */
+inline float BVH::intersectBox(const BoundingBox &box, const RayPacket &packet,
+                               const float tMax[rayPacketSize], float tEnter[rayPacketSize]) {
+    // Written with comparisons rather than std::min/max, which keeps the loop branch-free so
+    // the compiler can turn it into vector min/max instructions
+    for (int i = 0; i < rayPacketSize; i++) {
+        float tx0 = (box.min.x - packet.originX[i]) * packet.inverseDirectionX[i];
+        float tx1 = (box.max.x - packet.originX[i]) * packet.inverseDirectionX[i];
+        float ty0 = (box.min.y - packet.originY[i]) * packet.inverseDirectionY[i];
+        float ty1 = (box.max.y - packet.originY[i]) * packet.inverseDirectionY[i];
+        float tz0 = (box.min.z - packet.originZ[i]) * packet.inverseDirectionZ[i];
+        float tz1 = (box.max.z - packet.originZ[i]) * packet.inverseDirectionZ[i];
+        float entryX = tx0 < tx1 ? tx0 : tx1;
+        float entryY = ty0 < ty1 ? ty0 : ty1;
+        float entryZ = tz0 < tz1 ? tz0 : tz1;
+        float exitX = tx0 < tx1 ? tx1 : tx0;
+        float exitY = ty0 < ty1 ? ty1 : ty0;
+        float exitZ = tz0 < tz1 ? tz1 : tz0;
+        float entry = entryX > entryY ? entryX : entryY;
+        entry = entry > entryZ ? entry : entryZ;
+        entry = entry > 0.f ? entry : 0.f;
+        float exit = exitX < exitY ? exitX : exitY;
+        exit = exit < exitZ ? exit : exitZ;
+        exit = exit < tMax[i] ? exit : tMax[i];
+        tEnter[i] = entry <= exit ? entry : INFINITY;
+    }
+    float tNearest = tEnter[0];
+    for (int i = 1; i < rayPacketSize; i++) {
+        tNearest = tEnter[i] < tNearest ? tEnter[i] : tNearest;
+    }
+    return tNearest;
+}
+
+/** Front-to-back traversal, culling subtrees that start beyond the closest hit so far */
+template <typename HitFunction>
+void BVH::closestHit(const Ray &ray, float &tBest, HitFunction hit, uint64_t *numNodesVisited) const {
+    if (m_numNodes == 0) {
+        return;
+    }
+    glm::vec3 inverseDirection = 1.f / ray.direction;
+    int stack[maxTraversalDepth];
+    float stackT[maxTraversalDepth];
+    int stackSize = 0;
+
+    float tRoot = intersectBox(m_nodeData[0].bounds, ray.startPoint, inverseDirection, tBest);
+    if (tRoot == INFINITY) {
+        return;
+    }
+    stack[stackSize] = 0;
+    stackT[stackSize++] = tRoot;
+
+    int numVisited = 0;
+    while (stackSize > 0) {
+        stackSize--;
+        if (stackT[stackSize] > tBest) {
+            continue;
+        }
+        int nodeIndex = stack[stackSize];
+        const Node &node = m_nodeData[nodeIndex];
+        numVisited++;
+        if (node.count > 0) {
+            for (int i = node.offset; i < node.offset + node.count; i++) {
+                hit(m_indexData[i], tBest);
+            }
+            continue;
+        }
+
+        int near = nodeIndex + 1;
+        int far = node.offset;
+        float tNear = intersectBox(m_nodeData[near].bounds, ray.startPoint, inverseDirection, tBest);
+        float tFar = intersectBox(m_nodeData[far].bounds, ray.startPoint, inverseDirection, tBest);
+        if (tNear > tFar) {
+            std::swap(near, far);
+            std::swap(tNear, tFar);
+        }
+        // Push the farther child first so the nearer one is visited next
+        if (tFar != INFINITY && stackSize < maxTraversalDepth) {
+            stack[stackSize] = far;
+            stackT[stackSize++] = tFar;
+        }
+        if (tNear != INFINITY && stackSize < maxTraversalDepth) {
+            stack[stackSize] = near;
+            stackT[stackSize++] = tNear;
+        }
+    }
+    if (numNodesVisited) {
+        *numNodesVisited += numVisited;
+    }
+}
+
+/**
+ *  Depth-first traversal that returns as soon as any primitive blocks the ray. Children are
+ *  tested before they are pushed and the nearer one is visited first, as in closestHit, since a
+ *  blocker is most likely to be found close to the ray's start.
+ */
+template <typename OcclusionFunction>
+bool BVH::anyHit(const Ray &ray, float tMax, OcclusionFunction occludes, uint64_t *numNodesVisited) const {
+    if (m_numNodes == 0) {
+        return false;
+    }
+    glm::vec3 inverseDirection = 1.f / ray.direction;
+    int stack[maxTraversalDepth];
+    int stackSize = 0;
+
+    if (intersectBox(m_nodeData[0].bounds, ray.startPoint, inverseDirection, tMax) == INFINITY) {
+        return false;
+    }
+    stack[stackSize++] = 0;
+
+    int numVisited = 0;
+    bool isOccluded = false;
+    while (stackSize > 0 && !isOccluded) {
+        int nodeIndex = stack[--stackSize];
+        const Node &node = m_nodeData[nodeIndex];
+        numVisited++;
+        if (node.count > 0) {
+            for (int i = node.offset; i < node.offset + node.count && !isOccluded; i++) {
+                isOccluded = occludes(m_indexData[i], tMax);
+            }
+            continue;
+        }
+
+        int near = nodeIndex + 1;
+        int far = node.offset;
+        float tNear = intersectBox(m_nodeData[near].bounds, ray.startPoint, inverseDirection, tMax);
+        float tFar = intersectBox(m_nodeData[far].bounds, ray.startPoint, inverseDirection, tMax);
+        if (tNear > tFar) {
+            std::swap(near, far);
+            std::swap(tNear, tFar);
+        }
+        // Push the farther child first so the nearer one is visited next
+        if (tFar != INFINITY && stackSize < maxTraversalDepth) {
+            stack[stackSize++] = far;
+        }
+        if (tNear != INFINITY && stackSize < maxTraversalDepth) {
+            stack[stackSize++] = near;
+        }
+    }
+    if (numNodesVisited) {
+        *numNodesVisited += numVisited;
+    }
+    return isOccluded;
+}
+
+/**
+ *  Packet traversal: a node is visited while any ray of the packet still enters it before that
+ *  ray's closest hit, and primitives in a leaf are only tested against the rays that enter it.
+ *  Children are visited in the order the packet as a whole reaches them.
+ */
+template <typename PacketHitFunction>
+void BVH::closestHit(const RayPacket &packet, float tBest[rayPacketSize], PacketHitFunction hit,
+                     uint64_t *numNodesVisited) const {
+    if (m_numNodes == 0) {
+        return;
+    }
+    int stack[maxTraversalDepth];
+    float stackT[maxTraversalDepth][rayPacketSize];
+    int stackSize = 0;
+
+    if (intersectBox(m_nodeData[0].bounds, packet, tBest, stackT[stackSize]) == INFINITY) {
+        return;
+    }
+    stack[stackSize++] = 0;
+
+    int numVisited = 0;
+    while (stackSize > 0) {
+        stackSize--;
+        bool isActive[rayPacketSize];
+        bool anyActive = false;
+        for (int i = 0; i < rayPacketSize; i++) {
+            isActive[i] = stackT[stackSize][i] <= tBest[i];
+            anyActive = anyActive || isActive[i];
+        }
+        if (!anyActive) {
+            continue;
+        }
+        int nodeIndex = stack[stackSize];
+        const Node &node = m_nodeData[nodeIndex];
+        numVisited++;
+        if (node.count > 0) {
+            for (int ray = 0; ray < rayPacketSize; ray++) {
+                if (!isActive[ray]) {
+                    continue;
+                }
+                for (int i = node.offset; i < node.offset + node.count; i++) {
+                    hit(m_indexData[i], ray, tBest[ray]);
+                }
+            }
+            continue;
+        }
+
+        int near = nodeIndex + 1;
+        int far = node.offset;
+        float tNearEnter[rayPacketSize];
+        float tFarEnter[rayPacketSize];
+        float tNear = intersectBox(m_nodeData[near].bounds, packet, tBest, tNearEnter);
+        float tFar = intersectBox(m_nodeData[far].bounds, packet, tBest, tFarEnter);
+        float *nearEnter = tNearEnter;
+        float *farEnter = tFarEnter;
+        if (tNear > tFar) {
+            std::swap(near, far);
+            std::swap(tNear, tFar);
+            std::swap(nearEnter, farEnter);
+        }
+        // Push the farther child first so the nearer one is visited next
+        if (tFar != INFINITY && stackSize < maxTraversalDepth) {
+            std::copy(farEnter, farEnter + rayPacketSize, stackT[stackSize]);
+            stack[stackSize++] = far;
+        }
+        if (tNear != INFINITY && stackSize < maxTraversalDepth) {
+            std::copy(nearEnter, nearEnter + rayPacketSize, stackT[stackSize]);
+            stack[stackSize++] = near;
+        }
+    }
+    if (numNodesVisited) {
+        *numNodesVisited += numVisited;
+    }
+}
+
+/** Depth-first traversal of every node whose bounds contain the point */
+template <typename VisitFunction>
+void BVH::forEachContaining(glm::vec3 point, VisitFunction visit) const {
+    if (m_numNodes == 0) {
+        return;
+    }
+    int stack[maxTraversalDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node &node = m_nodeData[stack[--stackSize]];
+        if (!node.bounds.contains(point)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.offset; i < node.offset + node.count; i++) {
+                visit(m_indexData[i]);
+            }
+        } else if (stackSize + 2 <= maxTraversalDepth) {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = static_cast<int>(&node - m_nodeData) + 1;
+        }
+    }
+}
+
+#endif // BVH_H
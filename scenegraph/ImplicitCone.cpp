@@ -11,42 +11,62 @@ ImplicitCone::ImplicitCone()
  *  (base at y = -0.5, tip at y = 0.5, radius 0.5 at base)
  *  Returns t-value of intersection, or -1 if none exists.
  */
-Intersection ImplicitCone::intersect(Ray ray) {
-    std::vector<Intersection> intersections;
+Intersection ImplicitCone::intersect(const Ray &ray) const {
+    NearestHit nearest = findNearestHit(ray);
+    if (nearest.t < 0) {
+        return Intersection();
+    }
+    glm::vec3 intersection = pointAlongRay(ray, nearest.t);
+    glm::vec3 normal;
+    if (nearest.surface == TIP) {
+        normal = glm::vec3(0.f, 1.0f, 0.f);
+    } else if (nearest.surface == BASE) {
+        normal = glm::vec3(0.f, -1.0f, 0.f);
+    } else {
+        normal = getConeSideNormal(intersection);
+    }
+    return Intersection(nearest.t, intersection, normal);
+}
+
+/** t-value of the nearest intersection with the cone, or -1, without computing a normal */
+float ImplicitCone::intersectT(const Ray &ray) const {
+    return findNearestHit(ray).t;
+}
+
+NearestHit ImplicitCone::findNearestHit(const Ray &ray) const {
+    NearestHit nearest;
 
     // Check for intersection with infinite cone
-    std::vector<float> infiniteConeTValues = intersectInfiniteCone(ray);
-    for (int i = 0; i < infiniteConeTValues.size(); i++) {
+    float infiniteConeTValues[2];
+    int numTValues = intersectInfiniteCone(ray, infiniteConeTValues);
+    for (int i = 0; i < numTValues; i++) {
         float t = infiniteConeTValues[i];
-        glm::vec3 intersection = pointAlongRay(ray, t);
-        if (abs(intersection.y - 0.5f) < EPSILON) {
-            glm::vec3 tipNormal = glm::vec3(0.f, 1.0f, 0.f);
-            intersections.push_back(Intersection(t, intersection, tipNormal));
+        float y = ray.startPoint.y + t * ray.direction.y;
+        if (abs(y - 0.5f) < EPSILON) {
+            nearest.offer(t, TIP);
         }
-        else if (intersection.y >= -0.5 && intersection.y < 0.5) {
-            glm::vec3 normal = getConeSideNormal(intersection);
-            intersections.push_back(Intersection(t, intersection, normal));
+        else if (y >= -0.5 && y < 0.5) {
+            nearest.offer(t, SIDE);
         }
     }
 
     // Check for intersection with bottom cap
     Plane bottomPlane = Plane(glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f, -1.0f, 0.f));
     float tBottom = intersectPlane(ray, bottomPlane);
-    glm::vec3 bottomIntersection = pointAlongRay(ray, tBottom);
-    if (m_implicitShape->isWithinHorizontalCircle(bottomIntersection)) {
-        glm::vec3 normal = glm::vec3(0.f, -1.0f, 0.f);
-        intersections.push_back(Intersection(tBottom, bottomIntersection, normal));
+    if (m_implicitShape->isWithinHorizontalCircle(pointAlongRay(ray, tBottom))) {
+        nearest.offer(tBottom, BASE);
     }
 
-    return m_implicitShape->nearestIntersection(intersections);
+    return nearest;
 }
 
 
 /**
- *  Return t-values for up to 2 intersections with an infinite cone
+ *  Write t-values for up to 2 intersections with an infinite cone
  *  (centered around the origin, radius 0.5 at y = -0.5, tip at y = 0.5)
+ *  and return how many there are
  */
-std::vector<float> ImplicitCone::intersectInfiniteCone(Ray ray) {
+int ImplicitCone::intersectInfiniteCone(const Ray &ray, float tValues[2]) const {
     glm::vec3 direction = ray.direction;
     glm::vec3 eye = ray.startPoint;
 
@@ -55,11 +75,11 @@ std::vector<float> ImplicitCone::intersectInfiniteCone(Ray ray) {
     float b = 2 * (eye.x * direction.x + eye.z * direction.z) - 0.5 * eye.y * direction.y
             + 0.25 * direction.y;
     float c = eye.x * eye.x + eye.z * eye.z - 0.25 * eye.y * eye.y + 0.25 * eye.y - 0.0625;
-    return m_implicitShape->solveQuadratic(a, b, c);
+    return m_implicitShape->solveQuadratic(a, b, c, tValues);
 }
 
 /** Get normal from the cone side based on the gradient of the cone's implicit equation */
-glm::vec3 ImplicitCone::getConeSideNormal(glm::vec3 point) {
+glm::vec3 ImplicitCone::getConeSideNormal(glm::vec3 point) const {
     float x = point.x;
     float y = point.y;
     float z = point.z;
@@ -69,7 +89,7 @@ glm::vec3 ImplicitCone::getConeSideNormal(glm::vec3 point) {
 
 
 /** Map a position on the cone surface to a UV coord for texture mapping */
-UV ImplicitCone::mapToUV(glm::vec3 pos) {
+UV ImplicitCone::mapToUV(glm::vec3 pos) const {
     float x = pos.x;
     float y = pos.y;
     float z = pos.z;
@@ -8,12 +8,16 @@ class ImplicitCone
 {
 public:
     ImplicitCone();
-    Intersection intersect(Ray ray);
-    UV mapToUV(glm::vec3 pos);
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
 private:
+    enum Surface { SIDE, TIP, BASE };
+
     std::unique_ptr<ImplicitShape> m_implicitShape;
-    std::vector<float> intersectInfiniteCone(Ray ray);
-    glm::vec3 getConeSideNormal(glm::vec3 point);
+    NearestHit findNearestHit(const Ray &ray) const;
+    int intersectInfiniteCone(const Ray &ray, float tValues[2]) const;
+    glm::vec3 getConeSideNormal(glm::vec3 point) const;
 };
 
 #endif // IMPLICITCONE_H
@@ -6,83 +6,63 @@ ImplicitCube::ImplicitCube()
 }
 
 /** Compute intersection with cube that has range [-0.5, 0.5] in all dimensions */
-Intersection ImplicitCube::intersect(Ray ray) {
-    std::vector<Intersection> intersections;
-
-    // Check for intersection with top of cube
-    Plane topPlane = Plane(glm::vec3(0.f, 0.5f, 0.f), glm::vec3(0.f, 1.0f, 0.f));
-    float tTop = intersectPlane(ray, topPlane);
-    glm::vec3 topIntersection = pointAlongRay(ray, tTop);
-    if (isWithinXZSquare(topIntersection)) {
-        glm::vec3 normal = glm::vec3(0.f, 1.0f, 0.f);
-        intersections.push_back(Intersection(tTop, topIntersection, normal));
-    }
-
-    // Check for intersection with bottom of cube
-    Plane bottomPlane = Plane(glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f, -1.0f, 0.f));
-    float tBottom = intersectPlane(ray, bottomPlane);
-    glm::vec3 bottomIntersection = pointAlongRay(ray, tBottom);
-    if (isWithinXZSquare(bottomIntersection)) {
-        glm::vec3 normal = glm::vec3(0.f, -1.0f, 0.f);
-        intersections.push_back(Intersection(tBottom, bottomIntersection, normal));
-    }
-
-    // Check for intersection with side in positive X plane
-    Plane posXPlane = Plane(glm::vec3(0.5f, 0.f, 0.f), glm::vec3(1.0f, 0.f, 0.f));
-    float tPosX = intersectPlane(ray, posXPlane);
-    glm::vec3 posXIntersection = pointAlongRay(ray, tPosX);
-    if (isWithinYZSquare(posXIntersection)) {
-        glm::vec3 normal = glm::vec3(1.0f, 0.f, 0.f);
-        intersections.push_back(Intersection(tPosX, posXIntersection, normal));
-    }
-
-    // Check for intersection with side in negative X plane
-    Plane negXPlane = Plane(glm::vec3(-0.5f, 0.f, 0.f), glm::vec3(-1.0f, 0.f, 0.f));
-    float tNegX = intersectPlane(ray, negXPlane);
-    glm::vec3 negXIntersection = pointAlongRay(ray, tNegX);
-    if (isWithinYZSquare(negXIntersection)) {
-        glm::vec3 normal = glm::vec3(-1.0f, 0.f, 0.f);
-        intersections.push_back(Intersection(tNegX, negXIntersection, normal));
+Intersection ImplicitCube::intersect(const Ray &ray) const {
+    NearestHit nearest = findNearestHit(ray);
+    if (nearest.t < 0) {
+        return Intersection();
     }
-
-    // Check for intersection with side in positive Z plane
-    Plane posZPlane = Plane(glm::vec3(0.f, 0.f, 0.5f), glm::vec3(0.f, 0.f, 1.0f));
-    float tPosZ = intersectPlane(ray, posZPlane);
-    glm::vec3 posZIntersection = pointAlongRay(ray, tPosZ);
-    if (isWithinXYSquare(posZIntersection)) {
-        glm::vec3 normal = glm::vec3(0.f, 0.f, 1.0f);
-        intersections.push_back(Intersection(tPosZ, posZIntersection, normal));
-    }
-
-    // Check for intersection with side in negative Z plane
-    Plane negZPlane = Plane(glm::vec3(0.f, 0.f, -0.5f), glm::vec3(0.f, 0.f, -1.0f));
-    float tNegZ = intersectPlane(ray, negZPlane);
-    glm::vec3 negZIntersection = pointAlongRay(ray, tNegZ);
-    if (isWithinXYSquare(negZIntersection)) {
-        glm::vec3 normal = glm::vec3(0.f, 0.f, -1.0f);
-        intersections.push_back(Intersection(tNegZ, negZIntersection, normal));
-    }
-
-    return m_implicitShape->nearestIntersection(intersections);
+    glm::vec3 intersection = pointAlongRay(ray, nearest.t);
+    // The face hit is the one the point lies on along the normal's axis
+    int axis = nearest.surface;
+    glm::vec3 normal = glm::vec3(0.f);
+    normal[axis] = intersection[axis] > 0 ? 1.0f : -1.0f;
+    intersection[axis] = normal[axis] * radius;
+    return Intersection(nearest.t, intersection, normal);
 }
 
-/** Whether point has -0.5 <= x, z <= 0.5 */
-bool ImplicitCube::isWithinXZSquare(glm::vec3 point) {
-    return abs(point.x) <= 0.5 && abs(point.z) <= 0.5;
+/** t-value of the nearest intersection with the cube, or -1, without computing a normal */
+float ImplicitCube::intersectT(const Ray &ray) const {
+    return findNearestHit(ray).t;
 }
 
-/** Whether point has -0.5 <= x, y <= 0.5 */
-bool ImplicitCube::isWithinXYSquare(glm::vec3 point) {
-    return abs(point.x) <= 0.5 && abs(point.y) <= 0.5;
-}
+/**
+ *  Slab test: the ray is inside the cube between the largest of the per-axis entry t-values
+ *  and the smallest of the exit t-values. The nearest hit is the entry, or the exit if the ray
+ *  starts inside the cube.
+ */
+NearestHit ImplicitCube::findNearestHit(const Ray &ray) const {
+    float tEnter = -INFINITY;
+    float tExit = INFINITY;
+    int enterAxis = 0;
+    int exitAxis = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float inverseDirection = 1.f / ray.direction[axis];
+        float t0 = (-radius - ray.startPoint[axis]) * inverseDirection;
+        float t1 = (radius - ray.startPoint[axis]) * inverseDirection;
+        float tNear = t0 < t1 ? t0 : t1;
+        float tFar = t0 < t1 ? t1 : t0;
+        if (tNear > tEnter) {
+            tEnter = tNear;
+            enterAxis = axis;
+        }
+        if (tFar < tExit) {
+            tExit = tFar;
+            exitAxis = axis;
+        }
+    }
 
-/** Whether point has -0.5 <= y, z <= 0.5 */
-bool ImplicitCube::isWithinYZSquare(glm::vec3 point) {
-    return abs(point.y) <= 0.5 && abs(point.z) <= 0.5;
+    NearestHit nearest;
+    if (tEnter <= tExit) {
+        nearest.offer(tEnter, enterAxis);
+        if (nearest.t < 0) {
+            nearest.offer(tExit, exitAxis);
+        }
+    }
+    return nearest;
 }
 
 /** Map a position on the cube surface to a UV coord for texture mapping */
-UV ImplicitCube::mapToUV(glm::vec3 pos) {
+UV ImplicitCube::mapToUV(glm::vec3 pos) const {
     float x = pos.x;
     float y = pos.y;
     float z = pos.z;
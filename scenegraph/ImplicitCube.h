@@ -8,13 +8,12 @@ class ImplicitCube
 {
 public:
     ImplicitCube();
-    Intersection intersect(Ray ray);
-    UV mapToUV(glm::vec3 pos);
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
 private:
-    std::unique_ptr<ImplicitShape> m_implicitShape;
-    bool isWithinXZSquare(glm::vec3 point);
-    bool isWithinXYSquare(glm::vec3 point);
-    bool isWithinYZSquare(glm::vec3 point);
+    // Surfaces are numbered by the axis of the face's normal
+    NearestHit findNearestHit(const Ray &ray) const;
 };
 
 #endif // IMPLICITCUBE_H
@@ -11,57 +11,75 @@ ImplicitCylinder::ImplicitCylinder()
  *  (radius 0.5, centered at origin with caps at y = 0.5, -0.5)
  *  Returns t-value of intersection, or -1 if none exists.
  */
-Intersection ImplicitCylinder::intersect(Ray ray) {
-    std::vector<Intersection> intersections;
+Intersection ImplicitCylinder::intersect(const Ray &ray) const {
+    NearestHit nearest = findNearestHit(ray);
+    if (nearest.t < 0) {
+        return Intersection();
+    }
+    glm::vec3 intersection = pointAlongRay(ray, nearest.t);
+    glm::vec3 normal;
+    if (nearest.surface == TOP_CAP) {
+        normal = glm::vec3(0, 1.0f, 0);
+    } else if (nearest.surface == BOTTOM_CAP) {
+        normal = glm::vec3(0, -1.0f, 0);
+    } else {
+        normal = glm::normalize(glm::vec3(intersection.x, 0.f, intersection.z));
+    }
+    return Intersection(nearest.t, intersection, normal);
+}
+
+/** t-value of the nearest intersection with the cylinder, or -1, without computing a normal */
+float ImplicitCylinder::intersectT(const Ray &ray) const {
+    return findNearestHit(ray).t;
+}
+
+NearestHit ImplicitCylinder::findNearestHit(const Ray &ray) const {
+    NearestHit nearest;
 
     // Check for intersection with infinite cylinder
-    std::vector<float> infiniteCylinderTValues = intersectInfiniteCylinder(ray);
-    for (int i = 0; i < infiniteCylinderTValues.size(); i++) {
+    float infiniteCylinderTValues[2];
+    int numTValues = intersectInfiniteCylinder(ray, infiniteCylinderTValues);
+    for (int i = 0; i < numTValues; i++) {
         float t = infiniteCylinderTValues[i];
-        glm::vec3 intersection = pointAlongRay(ray, t);
-        if (intersection.y >= -0.5 && intersection.y <= 0.5) {
-            glm::vec3 normal = glm::normalize(glm::vec3(intersection.x, 0.f, intersection.z));
-            intersections.push_back(Intersection(t, intersection, normal));
+        float y = ray.startPoint.y + t * ray.direction.y;
+        if (y >= -0.5 && y <= 0.5) {
+            nearest.offer(t, SIDE);
         }
     }
 
     // Check for intersection with top cap
     Plane topPlane = Plane(glm::vec3(0.f, 0.5f, 0.f), glm::vec3(0.f, 1.0f, 0.f));
     float tTop = intersectPlane(ray, topPlane);
-    glm::vec3 topIntersection = pointAlongRay(ray, tTop);
-    if (m_implicitShape->isWithinHorizontalCircle(topIntersection)) {
-        glm::vec3 normal = glm::vec3(0, 1.0f, 0);
-        intersections.push_back(Intersection(tTop, topIntersection, normal));
+    if (m_implicitShape->isWithinHorizontalCircle(pointAlongRay(ray, tTop))) {
+        nearest.offer(tTop, TOP_CAP);
     }
 
     // Check for intersection with bottom cap
     Plane bottomPlane = Plane(glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f, -1.0f, 0.f));
     float tBottom = intersectPlane(ray, bottomPlane);
-    glm::vec3 bottomIntersection = pointAlongRay(ray, tBottom);
-    if (m_implicitShape->isWithinHorizontalCircle(bottomIntersection)) {
-        glm::vec3 normal = glm::vec3(0, -1.0f, 0);
-        intersections.push_back(Intersection(tBottom, bottomIntersection, normal));
+    if (m_implicitShape->isWithinHorizontalCircle(pointAlongRay(ray, tBottom))) {
+        nearest.offer(tBottom, BOTTOM_CAP);
     }
 
-    return m_implicitShape->nearestIntersection(intersections);
+    return nearest;
 }
 
 /**
- *  Return t-values for up to 2 intersections with an infinite vertical cylinder
- *  (radius 0.5, centered around the origin)
+ *  Write t-values for up to 2 intersections with an infinite vertical cylinder
+ *  (radius 0.5, centered around the origin) and return how many there are
  */
-std::vector<float> ImplicitCylinder::intersectInfiniteCylinder(Ray ray) {
+int ImplicitCylinder::intersectInfiniteCylinder(const Ray &ray, float tValues[2]) const {
     glm::vec3 direction = ray.direction;
     glm::vec3 eye = ray.startPoint;
 
     float a = direction.x * direction.x + direction.z * direction.z;
     float b = 2 * (eye.x * direction.x + eye.z * direction.z);
     float c = eye.x * eye.x + eye.z * eye.z - 0.25f;
-    return m_implicitShape->solveQuadratic(a, b, c);
+    return m_implicitShape->solveQuadratic(a, b, c, tValues);
 }
 
 /** Map a position on the cylinder surface to a UV coord for texture mapping */
-UV ImplicitCylinder::mapToUV(glm::vec3 pos) {
+UV ImplicitCylinder::mapToUV(glm::vec3 pos) const {
     float x = pos.x;
     float y = pos.y;
     float z = pos.z;
@@ -8,11 +8,15 @@ class ImplicitCylinder
 {
 public:
     ImplicitCylinder();
-    Intersection intersect(Ray ray);
-    UV mapToUV(glm::vec3 pos);
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
 private:
+    enum Surface { SIDE, TOP_CAP, BOTTOM_CAP };
+
     std::unique_ptr<ImplicitShape> m_implicitShape;
-    std::vector<float> intersectInfiniteCylinder(Ray ray);
+    NearestHit findNearestHit(const Ray &ray) const;
+    int intersectInfiniteCylinder(const Ray &ray, float tValues[2]) const;
 };
 
 #endif // IMPLICITCYLINDER_H
@@ -0,0 +1,52 @@
+#include "ImplicitLeaf.h"
+
+ImplicitLeaf::ImplicitLeaf()
+{
+}
+
+
+/**
+ *  Compute intersection with the leaf primitive. The normal faces back along the ray, since
+ *  the leaf is drawn from both sides.
+ *  Returns t-value of intersection, or -1 if none exists.
+ */
+Intersection ImplicitLeaf::intersect(const Ray &ray) const {
+    float t = intersectT(ray);
+    if (t < 0) {
+        return Intersection();
+    }
+    glm::vec3 intersection = pointAlongRay(ray, t);
+    glm::vec3 normal = glm::vec3(0.f, 0.f, ray.direction.z > 0 ? -1.0f : 1.0f);
+    return Intersection(t, intersection, normal);
+}
+
+/** t-value of the intersection with the leaf, or -1, without computing a normal */
+float ImplicitLeaf::intersectT(const Ray &ray) const {
+    if (ray.direction.z == 0) {
+        return -1;
+    }
+    float t = -ray.startPoint.z / ray.direction.z;
+    if (t < EPSILON || !isWithinOutline(pointAlongRay(ray, t))) {
+        return -1;
+    }
+    return t;
+}
+
+/** Whether a point in the leaf's plane lies inside its outline */
+bool ImplicitLeaf::isWithinOutline(glm::vec3 point) const {
+    if (point.x < 0 || point.x > 1) {
+        return false;
+    }
+    float position = point.x * (leafOutlinePoints - 1);
+    int segment = std::min(static_cast<int>(position), leafOutlinePoints - 2);
+    float halfWidth = glm::mix(leafHalfWidths[segment], leafHalfWidths[segment + 1],
+                               position - segment);
+    return abs(point.y) <= halfWidth;
+}
+
+/** Map a position on the leaf to a UV coord, with u along the midrib */
+UV ImplicitLeaf::mapToUV(glm::vec3 pos) const {
+    float u = pos.x;
+    float v = 0.5f - pos.y / (2 * leafMaxHalfWidth);
+    return UV(u, v);
+}
@@ -0,0 +1,33 @@
+#ifndef IMPLICITLEAF_H
+#define IMPLICITLEAF_H
+
+#include "ImplicitShape.h"
+
+/** Number of evenly spaced points along the leaf's midrib that its outline is defined at */
+const int leafOutlinePoints = 5;
+
+/**
+ *  Half-width of the leaf at each outline point, from the stem at x = 0 to the tip at x = 1.
+ *  Matches the vertex grid in Leaf::makeFrontVertexGrid.
+ */
+const float leafHalfWidths[leafOutlinePoints] = { 0.f, 0.2f, 0.25f, 0.2f, 0.f };
+const float leafMaxHalfWidth = 0.25f;
+
+
+/**
+ *  Flat, two-sided leaf in the z = 0 plane, matching the Leaf shape. Every triangle of the
+ *  leaf mesh lies in that plane, so the mesh is intersected as the plane clipped to the
+ *  leaf's piecewise linear outline.
+ */
+class ImplicitLeaf
+{
+public:
+    ImplicitLeaf();
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
+private:
+    bool isWithinOutline(glm::vec3 point) const;
+};
+
+#endif // IMPLICITLEAF_H
@@ -5,57 +5,10 @@ ImplicitShape::ImplicitShape()
 {
 }
 
-/**
- *  Returns the intersection that has the smallest non-negative t-value.
- *  If all intersections have negative t-values, returns an intersection with t = -1
- */
-Intersection ImplicitShape::nearestIntersection(std::vector<Intersection> intersections) {
-    float minTValue = INFINITY;
-    float minIndex = 0;
-    for (int i = 0; i < intersections.size(); i++) {
-        float t = intersections[i].t;
-        if (t >= EPSILON && t < minTValue) {
-            minTValue = t;
-            minIndex = i;
-        }
-    }
-    if (minTValue == INFINITY) {
-        // Return null intersection (t = -1)
-        return Intersection();
-    } else {
-        return intersections[minIndex];
-    }
-}
-
-
-/**
- *  Returns the intersection that has the smallest non-negative t-value.
- *  If all intersections have negative t-values, returns an intersection with t = -1
- *  Note: same as nearestIntersection, just handles IntersectionWithPrimitive type
- */
-IntersectionWithPrimitive ImplicitShape::nearestIntersectionWithPrimitive(
-        std::vector<IntersectionWithPrimitive> intersections) {
-    float minTValue = INFINITY;
-    float minIndex = 0;
-    for (int i = 0; i < intersections.size(); i++) {
-        float t = intersections[i].t;
-        if (t >= EPSILON && t < minTValue) {
-            minTValue = t;
-            minIndex = i;
-        }
-    }
-    if (minTValue == INFINITY) {
-        // Return null intersection (t = -1)
-        return IntersectionWithPrimitive();
-    } else {
-        return intersections[minIndex];
-    }
-}
-
-/** Return the smallest non-negative value, or -1 if none exsits */
-float ImplicitShape::nonNegativeMin(std::vector<float> values) {
+/** Return the smallest non-negative of the first count values, or -1 if none exists */
+float ImplicitShape::nonNegativeMin(const float *values, int count) const {
     float min = INFINITY;
-    for (int i = 0; i < values.size(); i++) {
+    for (int i = 0; i < count; i++) {
         float val = values[i];
         if (val >= EPSILON && val < min) {
             min = val;
@@ -70,27 +23,29 @@ float ImplicitShape::nonNegativeMin(std::vector<float> values) {
 
 /**
  *  Solve a quadratic equation defined by coefficients a, b, and c.
- *  Returns 0, 1, or 2 real roots
+ *  Writes 0, 1, or 2 real roots to roots and returns how many there are
  */
-std::vector<float> ImplicitShape::solveQuadratic(float a, float b, float c) {
-    std::vector<float> roots;
+int ImplicitShape::solveQuadratic(float a, float b, float c, float roots[2]) const {
     float discriminant = b * b - 4 * a *c;
     if (discriminant > 0) {
         // Two real roots for positive discriminant
-        roots.push_back((-b + sqrt(discriminant)) / (2*a));
-        roots.push_back((-b - sqrt(discriminant)) / (2*a));
-    } else if (abs(discriminant) < EPSILON) {
+        float root = sqrt(discriminant);
+        roots[0] = (-b + root) / (2*a);
+        roots[1] = (-b - root) / (2*a);
+        return 2;
+    } else if (discriminant == 0) {
         // One real root for discriminant = 0
-        roots.push_back((-b + sqrt(discriminant)) / (2*a));
+        roots[0] = -b / (2*a);
+        return 1;
     }
-    return roots;
+    return 0;
 }
 
 /**
  *  Checks whether given point is within a horizontal circle with radius 0.5 around the origin.
  *  Useful for calculating intersections with cylinder and cone caps.
  */
-bool ImplicitShape::isWithinHorizontalCircle(glm::vec3 point) {
+bool ImplicitShape::isWithinHorizontalCircle(glm::vec3 point) const {
     float x = point.x;
     float z = point.z;
     return x * x + z * z < 0.25;
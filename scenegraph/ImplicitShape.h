@@ -4,16 +4,38 @@
 #include "RayGeometry.h"
 
 
+/**
+ *  The nearest of a shape's candidate hits. Candidates are offered one at a time, so nothing
+ *  needs to be stored; which part of the shape was hit is kept so that only the nearest
+ *  hit's normal is ever computed.
+ */
+struct NearestHit {
+    // -1 until a candidate with t >= EPSILON has been offered
+    float t;
+    int surface;
+
+    NearestHit() :
+        t(-1),
+        surface(-1)
+    {
+    }
+
+    void offer(float candidateT, int candidateSurface) {
+        if (candidateT >= EPSILON && (t < 0 || candidateT < t)) {
+            t = candidateT;
+            surface = candidateSurface;
+        }
+    }
+};
+
 class ImplicitShape
 {
 public:
     ImplicitShape();
-    Intersection nearestIntersection(std::vector<Intersection> intersections);
-    IntersectionWithPrimitive nearestIntersectionWithPrimitive(std::vector<IntersectionWithPrimitive> intersections);
-    float nonNegativeMin(std::vector<float> values);
-    std::vector<float> solveQuadratic(float a, float b, float c);
+    float nonNegativeMin(const float *values, int count) const;
+    int solveQuadratic(float a, float b, float c, float roots[2]) const;
     // Helper for cone and cylinder
-    bool isWithinHorizontalCircle(glm::vec3 point);
+    bool isWithinHorizontalCircle(glm::vec3 point) const;
 };
 
 #endif // IMPLICITSHAPE_H
@@ -7,18 +7,8 @@ ImplicitSphere::ImplicitSphere()
 
 
 /** Intersect a sphere with radius 0.5 centered at the origin */
-Intersection ImplicitSphere::intersect(Ray ray) {
-    std::vector<float> tValues;
-
-    glm::vec3 direction = ray.direction;
-    glm::vec3 eye = ray.startPoint;
-
-    float a = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
-    float b = 2 * (eye.x * direction.x + eye.y * direction.y + eye.z * direction.z);
-    float c = eye.x * eye.x + eye.y * eye.y + eye.z * eye.z - 0.25f;
-    tValues = m_implicitShape->solveQuadratic(a, b, c);
-
-    float nearestTValue =  m_implicitShape->nonNegativeMin(tValues);
+Intersection ImplicitSphere::intersect(const Ray &ray) const {
+    float nearestTValue = intersectT(ray);
     if (nearestTValue > 0) {
         glm::vec3 intersectionPoint = pointAlongRay(ray, nearestTValue);
         // Normal for sphere is same as normalized point
@@ -30,8 +20,21 @@ Intersection ImplicitSphere::intersect(Ray ray) {
     }
 }
 
+/** t-value of the nearest intersection with the sphere, or -1 if none exists */
+float ImplicitSphere::intersectT(const Ray &ray) const {
+    glm::vec3 direction = ray.direction;
+    glm::vec3 eye = ray.startPoint;
+
+    float a = direction.x * direction.x + direction.y * direction.y + direction.z * direction.z;
+    float b = 2 * (eye.x * direction.x + eye.y * direction.y + eye.z * direction.z);
+    float c = eye.x * eye.x + eye.y * eye.y + eye.z * eye.z - 0.25f;
+    float tValues[2];
+    int numTValues = m_implicitShape->solveQuadratic(a, b, c, tValues);
+    return m_implicitShape->nonNegativeMin(tValues, numTValues);
+}
+
 /** Map a position on the sphere surface to a UV coord for texture mapping */
-UV ImplicitSphere::mapToUV(glm::vec3 pos) {
+UV ImplicitSphere::mapToUV(glm::vec3 pos) const {
     float x = pos.x;
     float y = pos.y;
     float z = pos.z;
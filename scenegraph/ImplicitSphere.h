@@ -8,8 +8,9 @@ class ImplicitSphere
 {
 public:
     ImplicitSphere();
-    Intersection intersect(Ray ray);
-    UV mapToUV(glm::vec3 pos);
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
 private:
     std::unique_ptr<ImplicitShape> m_implicitShape;
 };
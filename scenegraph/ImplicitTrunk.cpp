@@ -0,0 +1,114 @@
+#include "ImplicitTrunk.h"
+#include "trees/MeshGenerator.h"
+
+ImplicitTrunk::ImplicitTrunk() :
+    m_radiusAtCenter(radius * (1.f + branchWidthDecay) / 2.f),
+    m_radiusSlope(radius * (branchWidthDecay - 1.f)),
+    m_topRadius(radius * branchWidthDecay)
+{
+    m_implicitShape = std::make_unique<ImplicitShape>();
+}
+
+
+/**
+ *  Compute intersection with the tapered trunk primitive centered at the origin
+ *  (caps at y = 0.5, -0.5, as tessellated by Trunk).
+ *  Returns t-value of intersection, or -1 if none exists.
+ */
+Intersection ImplicitTrunk::intersect(const Ray &ray) const {
+    NearestHit nearest = findNearestHit(ray);
+    if (nearest.t < 0) {
+        return Intersection();
+    }
+    glm::vec3 intersection = pointAlongRay(ray, nearest.t);
+    glm::vec3 normal;
+    if (nearest.surface == TOP_CAP) {
+        normal = glm::vec3(0, 1.0f, 0);
+    } else if (nearest.surface == BOTTOM_CAP) {
+        normal = glm::vec3(0, -1.0f, 0);
+    } else {
+        normal = getTrunkSideNormal(intersection);
+    }
+    return Intersection(nearest.t, intersection, normal);
+}
+
+/** t-value of the nearest intersection with the trunk, or -1, without computing a normal */
+float ImplicitTrunk::intersectT(const Ray &ray) const {
+    return findNearestHit(ray).t;
+}
+
+NearestHit ImplicitTrunk::findNearestHit(const Ray &ray) const {
+    NearestHit nearest;
+
+    // Check for intersection with the infinite cone the side lies on
+    float infiniteTrunkTValues[2];
+    int numTValues = intersectInfiniteTrunk(ray, infiniteTrunkTValues);
+    for (int i = 0; i < numTValues; i++) {
+        float t = infiniteTrunkTValues[i];
+        float y = ray.startPoint.y + t * ray.direction.y;
+        if (y >= -0.5 && y <= 0.5) {
+            nearest.offer(t, SIDE);
+        }
+    }
+
+    // Check for intersection with the narrower top cap
+    Plane topPlane = Plane(glm::vec3(0.f, 0.5f, 0.f), glm::vec3(0.f, 1.0f, 0.f));
+    float tTop = intersectPlane(ray, topPlane);
+    glm::vec3 topPoint = pointAlongRay(ray, tTop);
+    if (topPoint.x * topPoint.x + topPoint.z * topPoint.z < m_topRadius * m_topRadius) {
+        nearest.offer(tTop, TOP_CAP);
+    }
+
+    // Check for intersection with bottom cap
+    Plane bottomPlane = Plane(glm::vec3(0.f, -0.5f, 0.f), glm::vec3(0.f, -1.0f, 0.f));
+    float tBottom = intersectPlane(ray, bottomPlane);
+    if (m_implicitShape->isWithinHorizontalCircle(pointAlongRay(ray, tBottom))) {
+        nearest.offer(tBottom, BOTTOM_CAP);
+    }
+
+    return nearest;
+}
+
+/**
+ *  Write t-values for up to 2 intersections with the infinite cone
+ *  x^2 + z^2 = (m_radiusAtCenter + m_radiusSlope * y)^2 and return how many there are
+ */
+int ImplicitTrunk::intersectInfiniteTrunk(const Ray &ray, float tValues[2]) const {
+    glm::vec3 direction = ray.direction;
+    glm::vec3 eye = ray.startPoint;
+
+    float eyeRadius = m_radiusAtCenter + m_radiusSlope * eye.y;
+    float directionRadius = m_radiusSlope * direction.y;
+    float a = direction.x * direction.x + direction.z * direction.z
+            - directionRadius * directionRadius;
+    float b = 2 * (eye.x * direction.x + eye.z * direction.z - eyeRadius * directionRadius);
+    float c = eye.x * eye.x + eye.z * eye.z - eyeRadius * eyeRadius;
+    return m_implicitShape->solveQuadratic(a, b, c, tValues);
+}
+
+/** Get normal from the trunk side based on the gradient of its implicit equation */
+glm::vec3 ImplicitTrunk::getTrunkSideNormal(glm::vec3 point) const {
+    float sideRadius = m_radiusAtCenter + m_radiusSlope * point.y;
+    glm::vec3 normal = glm::vec3(point.x, -sideRadius * m_radiusSlope, point.z);
+    return glm::normalize(normal);
+}
+
+/** Map a position on the trunk surface to a UV coord for texture mapping */
+UV ImplicitTrunk::mapToUV(glm::vec3 pos) const {
+    float x = pos.x;
+    float y = pos.y;
+    float z = pos.z;
+    // For top base, offset by the radius so the narrower cap stays centered
+    if (abs(y - radius) < EPSILON) {
+        return UV(x + radius, z + radius);
+    }
+    // For bottom base, we reflect vertically
+    if (abs(y + radius) < EPSILON) {
+        return UV(x + radius, -z + radius);
+    }
+    // For side of trunk, we use theta and y
+    float theta = atan2(z, x);
+    float u = 1 - theta / (2 * PI);
+    float v = radius - y;
+    return UV(u, v);
+}
@@ -0,0 +1,31 @@
+#ifndef IMPLICITTRUNK_H
+#define IMPLICITTRUNK_H
+
+#include "ImplicitShape.h"
+
+
+/**
+ *  Tapered cylinder matching the Trunk shape: radius 0.5 at y = -0.5, narrowing linearly to
+ *  0.5 * branchWidthDecay at y = 0.5, with flat caps at both ends.
+ */
+class ImplicitTrunk
+{
+public:
+    ImplicitTrunk();
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
+private:
+    enum Surface { SIDE, TOP_CAP, BOTTOM_CAP };
+
+    std::unique_ptr<ImplicitShape> m_implicitShape;
+    // Side radius is m_radiusAtCenter + m_radiusSlope * y
+    float m_radiusAtCenter;
+    float m_radiusSlope;
+    float m_topRadius;
+    NearestHit findNearestHit(const Ray &ray) const;
+    int intersectInfiniteTrunk(const Ray &ray, float tValues[2]) const;
+    glm::vec3 getTrunkSideNormal(glm::vec3 point) const;
+};
+
+#endif // IMPLICITTRUNK_H
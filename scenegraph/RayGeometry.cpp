@@ -1,10 +1,25 @@
 #include "RayGeometry.h"
 
+#include <algorithm>
+#include <cmath>
+
 /** Return the point along a ray defined by the parameter t */
 glm::vec3 pointAlongRay(Ray ray, float t) {
     return ray.startPoint + t * ray.direction;
 }
 
+RayPacket::RayPacket(const Ray *rays) :
+    rays(rays)
+{
+    for (int i = 0; i < rayPacketSize; i++) {
+        originX[i] = rays[i].startPoint.x;
+        originY[i] = rays[i].startPoint.y;
+        originZ[i] = rays[i].startPoint.z;
+        inverseDirectionX[i] = 1.f / rays[i].direction.x;
+        inverseDirectionY[i] = 1.f / rays[i].direction.y;
+        inverseDirectionZ[i] = 1.f / rays[i].direction.z;
+    }
+}
 
 /** Return t-value for intersection with a plane */
 float intersectPlane(Ray ray, Plane plane) {
@@ -13,3 +28,66 @@ float intersectPlane(Ray ray, Plane plane) {
     return topTerm / bottomTerm;
 }
 
+/**
+ *  Return t-value for intersection with the triangle abc, or -1 if the ray misses it.
+ *  Uses the Moller-Trumbore test, so no plane or normal is stored per triangle.
+ */
+float intersectTriangle(const Ray &ray, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+    glm::vec3 edge1 = b - a;
+    glm::vec3 edge2 = c - a;
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (determinant == 0) {
+        return -1;
+    }
+    float inverseDeterminant = 1.f / determinant;
+    glm::vec3 fromA = ray.startPoint - a;
+    float u = glm::dot(fromA, p) * inverseDeterminant;
+    if (u < 0 || u > 1) {
+        return -1;
+    }
+    glm::vec3 q = glm::cross(fromA, edge1);
+    float v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0 || u + v > 1) {
+        return -1;
+    }
+    return glm::dot(edge2, q) * inverseDeterminant;
+}
+
+/**
+ *  Bend a ray crossing a surface with the given index of refraction (the other side being
+ *  air), setting refracted to the transmitted direction. Returns the fraction of light that is
+ *  reflected instead, using Schlick's approximation of the Fresnel equations, or 1 for total
+ *  internal reflection, in which case refracted is not set. The normal faces out of the
+ *  surface; rays against it are entering. An index of 0 or less marks a thin surface such as
+ *  a leaf, which transmits straight through without reflecting.
+ */
+float refractFresnel(glm::vec3 direction, glm::vec3 normal, float ior, glm::vec3 &refracted) {
+    glm::vec3 incident = glm::normalize(direction);
+    if (ior <= 0.f) {
+        refracted = incident;
+        return 0.f;
+    }
+    float n1 = 1.f;
+    float n2 = ior;
+    float cosIncident = -glm::dot(incident, normal);
+    if (cosIncident < 0.f) {
+        // Leaving the object
+        normal = -normal;
+        cosIncident = -cosIncident;
+        std::swap(n1, n2);
+    }
+    float eta = n1 / n2;
+    float sinTransmittedSquared = eta * eta * (1.f - cosIncident * cosIncident);
+    if (sinTransmittedSquared > 1.f) {
+        return 1.f;
+    }
+    float cosTransmitted = std::sqrt(1.f - sinTransmittedSquared);
+    refracted = eta * incident + (eta * cosIncident - cosTransmitted) * normal;
+
+    float r0 = (n1 - n2) / (n1 + n2);
+    r0 *= r0;
+    // Schlick's approximation takes the angle on the less dense side
+    float cosine = n1 <= n2 ? cosIncident : cosTransmitted;
+    return r0 + (1.f - r0) * std::pow(1.f - cosine, 5.f);
+}
@@ -24,6 +24,34 @@ struct Ray {
         direction(direction)
     {
     }
+
+    // So rays can be stored in arrays; the direction is a placeholder
+    Ray() :
+        startPoint(glm::vec3(0.f)),
+        direction(glm::vec3(0.f, 0.f, -1.f))
+    {
+    }
+};
+
+/** Number of rays traced together in a RayPacket */
+const int rayPacketSize = 4;
+
+/**
+ *  A small bundle of coherent rays, e.g. the primary rays through a 2x2 block of pixels,
+ *  traced through the BVH together. Components are stored one array per axis so the
+ *  per-ray loops over a packet compile to vector instructions.
+ */
+struct RayPacket {
+    float originX[rayPacketSize];
+    float originY[rayPacketSize];
+    float originZ[rayPacketSize];
+    float inverseDirectionX[rayPacketSize];
+    float inverseDirectionY[rayPacketSize];
+    float inverseDirectionZ[rayPacketSize];
+    const Ray *rays;
+
+    // rays must hold rayPacketSize rays and outlive the packet
+    explicit RayPacket(const Ray *rays);
 };
 
 /**
@@ -119,5 +147,7 @@ struct IntersectionWithPrimitive {
 
 glm::vec3 pointAlongRay(Ray ray, float t);
 float intersectPlane(Ray ray, Plane plane);
+float intersectTriangle(const Ray &ray, glm::vec3 a, glm::vec3 b, glm::vec3 c);
+float refractFresnel(glm::vec3 direction, glm::vec3 normal, float ior, glm::vec3 &refracted);
 
 #endif // RAYGEOMETRY_H
@@ -0,0 +1,223 @@
+#include "RayHeightfield.h"
+
+#include <limits>
+
+RayHeightfield::RayHeightfield(std::vector<float> heights, int numRows, int numCols, float halfExtent) :
+    m_heights(std::move(heights)),
+    m_numRows(numRows),
+    m_numCols(numCols),
+    m_origin(glm::vec3(-halfExtent, 0.f, -halfExtent)),
+    m_rowSpacing(2.f * halfExtent / numRows),
+    m_colSpacing(2.f * halfExtent / numCols)
+{
+    for (int row = 0; row < m_numRows; row++) {
+        for (int col = 0; col < m_numCols; col++) {
+            m_bounds.grow(getPosition(row, col));
+        }
+    }
+    buildPyramid();
+}
+
+/** Build each pyramid level from the one below until a single node covers every cell */
+void RayHeightfield::buildPyramid() {
+    m_levels.push_back({ m_numRows - 1, m_numCols - 1, -1 });
+    while (m_levels.back().rows > 1 || m_levels.back().cols > 1) {
+        int level = m_levels.size();
+        PyramidLevel below = m_levels.back();
+        m_levels.push_back({ (below.rows + 1) / 2, (below.cols + 1) / 2, static_cast<int>(m_ranges.size()) });
+        for (int row = 0; row < m_levels.back().rows; row++) {
+            for (int col = 0; col < m_levels.back().cols; col++) {
+                HeightRange range = { INFINITY, -INFINITY };
+                for (int child = 0; child < 4; child++) {
+                    int childRow = 2 * row + child / 2;
+                    int childCol = 2 * col + child % 2;
+                    if (childRow < below.rows && childCol < below.cols) {
+                        HeightRange childRange = getRange(level - 1, childRow, childCol);
+                        range.min = std::min(range.min, childRange.min);
+                        range.max = std::max(range.max, childRange.max);
+                    }
+                }
+                m_ranges.push_back(range);
+            }
+        }
+    }
+}
+
+BoundingBox RayHeightfield::getBounds() const {
+    return m_bounds;
+}
+
+/**
+ *  Compute intersection with the heightfield. The normal is interpolated across the hit
+ *  triangle from the vertex normals, as the terrain is smooth shaded.
+ *  Returns t-value of intersection, or -1 if none exists.
+ */
+Intersection RayHeightfield::intersect(const Ray &ray) const {
+    float t = intersectT(ray);
+    if (t < 0) {
+        return Intersection();
+    }
+    glm::vec3 intersection = pointAlongRay(ray, t);
+    float rowPosition = (intersection.x - m_origin.x) / m_rowSpacing;
+    float colPosition = (intersection.z - m_origin.z) / m_colSpacing;
+    int row = glm::clamp(static_cast<int>(floor(rowPosition)), 0, m_numRows - 2);
+    int col = glm::clamp(static_cast<int>(floor(colPosition)), 0, m_numCols - 2);
+    float rowWeight = glm::clamp(rowPosition - row, 0.f, 1.f);
+    float colWeight = glm::clamp(colPosition - col, 0.f, 1.f);
+
+    // Barycentric weights within the cell's triangle on the hit side of the diagonal
+    glm::vec3 normal;
+    if (rowWeight >= colWeight) {
+        normal = (1 - rowWeight) * getVertexNormal(row, col)
+                + (rowWeight - colWeight) * getVertexNormal(row + 1, col)
+                + colWeight * getVertexNormal(row + 1, col + 1);
+    } else {
+        normal = (1 - colWeight) * getVertexNormal(row, col)
+                + (colWeight - rowWeight) * getVertexNormal(row, col + 1)
+                + rowWeight * getVertexNormal(row + 1, col + 1);
+    }
+    return Intersection(t, intersection, glm::normalize(normal));
+}
+
+/**
+ *  t-value of the nearest intersection with the heightfield, or -1. The pyramid is walked
+ *  depth first, skipping every node whose footprint and height range the ray misses.
+ *  Children are visited in the order the ray enters them, and their footprints do not
+ *  overlap, so the first cell with a hit holds the nearest one.
+ */
+float RayHeightfield::intersectT(const Ray &ray) const {
+    // Nodes share faces, so zero direction components are nudged to keep the slab tests from
+    // computing 0 * INFINITY for a ray that starts on one
+    glm::vec3 inverseDirection;
+    for (int axis = 0; axis < 3; axis++) {
+        float component = ray.direction[axis];
+        inverseDirection[axis] = 1.f / (component != 0 ? component : std::numeric_limits<float>::min());
+    }
+    int stackLevel[maxTraversalDepth];
+    int stackRow[maxTraversalDepth];
+    int stackCol[maxTraversalDepth];
+    int stackSize = 0;
+    stackLevel[stackSize] = m_levels.size() - 1;
+    stackRow[stackSize] = 0;
+    stackCol[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        stackSize--;
+        int level = stackLevel[stackSize];
+        int row = stackRow[stackSize];
+        int col = stackCol[stackSize];
+        if (BVH::intersectBox(getNodeBounds(level, row, col), ray.startPoint, inverseDirection,
+                              INFINITY) == INFINITY) {
+            continue;
+        }
+        if (level == 0) {
+            float t = intersectCell(ray, row, col);
+            if (t >= 0) {
+                return t;
+            }
+            continue;
+        }
+
+        // Sort the children by entry t, then push the farthest first so the nearest is next
+        const PyramidLevel &below = m_levels[level - 1];
+        int childRows[4];
+        int childCols[4];
+        float childT[4];
+        int numChildren = 0;
+        for (int child = 0; child < 4; child++) {
+            int childRow = 2 * row + child / 2;
+            int childCol = 2 * col + child % 2;
+            if (childRow >= below.rows || childCol >= below.cols) {
+                continue;
+            }
+            float t = BVH::intersectBox(getNodeBounds(level - 1, childRow, childCol),
+                                        ray.startPoint, inverseDirection, INFINITY);
+            if (t == INFINITY) {
+                continue;
+            }
+            int i = numChildren++;
+            for (; i > 0 && childT[i - 1] < t; i--) {
+                childRows[i] = childRows[i - 1];
+                childCols[i] = childCols[i - 1];
+                childT[i] = childT[i - 1];
+            }
+            childRows[i] = childRow;
+            childCols[i] = childCol;
+            childT[i] = t;
+        }
+        for (int i = 0; i < numChildren && stackSize < maxTraversalDepth; i++) {
+            stackLevel[stackSize] = level - 1;
+            stackRow[stackSize] = childRows[i];
+            stackCol[stackSize++] = childCols[i];
+        }
+    }
+    return -1;
+}
+
+/** Lowest and highest height over the cells under a pyramid node */
+RayHeightfield::HeightRange RayHeightfield::getRange(int level, int row, int col) const {
+    if (level == 0) {
+        float corners[4] = { getHeight(row, col), getHeight(row + 1, col),
+                             getHeight(row, col + 1), getHeight(row + 1, col + 1) };
+        HeightRange range = { corners[0], corners[0] };
+        for (int i = 1; i < 4; i++) {
+            range.min = std::min(range.min, corners[i]);
+            range.max = std::max(range.max, corners[i]);
+        }
+        return range;
+    }
+    const PyramidLevel &pyramidLevel = m_levels[level];
+    return m_ranges[pyramidLevel.offset + row * pyramidLevel.cols + col];
+}
+
+/** World space box around the part of the heightfield under a pyramid node */
+BoundingBox RayHeightfield::getNodeBounds(int level, int row, int col) const {
+    HeightRange range = getRange(level, row, col);
+    int firstRow = row << level;
+    int firstCol = col << level;
+    int endRow = std::min((row + 1) << level, m_levels[0].rows);
+    int endCol = std::min((col + 1) << level, m_levels[0].cols);
+    return BoundingBox(glm::vec3(m_origin.x + firstRow * m_rowSpacing, range.min, m_origin.z + firstCol * m_colSpacing),
+                       glm::vec3(m_origin.x + endRow * m_rowSpacing, range.max, m_origin.z + endCol * m_colSpacing));
+}
+
+/** Nearest t >= EPSILON at which the ray hits either triangle of a grid cell, or -1 */
+float RayHeightfield::intersectCell(const Ray &ray, int row, int col) const {
+    glm::vec3 corner = getPosition(row, col);
+    glm::vec3 oppositeCorner = getPosition(row + 1, col + 1);
+    float tValues[2] = {
+        intersectTriangle(ray, corner, getPosition(row + 1, col), oppositeCorner),
+        intersectTriangle(ray, corner, oppositeCorner, getPosition(row, col + 1))
+    };
+    float t = -1;
+    for (int i = 0; i < 2; i++) {
+        if (tValues[i] >= EPSILON && (t < 0 || tValues[i] < t)) {
+            t = tValues[i];
+        }
+    }
+    return t;
+}
+
+float RayHeightfield::getHeight(int row, int col) const {
+    row = glm::clamp(row, 0, m_numRows - 1);
+    col = glm::clamp(col, 0, m_numCols - 1);
+    return m_heights[row * m_numCols + col];
+}
+
+glm::vec3 RayHeightfield::getPosition(int row, int col) const {
+    return glm::vec3(m_origin.x + row * m_rowSpacing, getHeight(row, col), m_origin.z + col * m_colSpacing);
+}
+
+/** Normal at a vertex from the central differences of its neighbours' heights */
+glm::vec3 RayHeightfield::getVertexNormal(int row, int col) const {
+    float slopeX = (getHeight(row + 1, col) - getHeight(row - 1, col)) / (2 * m_rowSpacing);
+    float slopeZ = (getHeight(row, col + 1) - getHeight(row, col - 1)) / (2 * m_colSpacing);
+    return glm::normalize(glm::vec3(-slopeX, 1.f, -slopeZ));
+}
+
+/** Map a position on the heightfield to a UV coord spanning the whole grid once */
+UV RayHeightfield::mapToUV(glm::vec3 pos) const {
+    float u = (pos.x - m_bounds.min.x) / (m_bounds.max.x - m_bounds.min.x);
+    float v = (pos.z - m_bounds.min.z) / (m_bounds.max.z - m_bounds.min.z);
+    return UV(u, v);
+}
@@ -0,0 +1,70 @@
+#ifndef RAYHEIGHTFIELD_H
+#define RAYHEIGHTFIELD_H
+
+#include "RayGeometry.h"
+#include "BVH.h"
+
+#include <vector>
+
+/**
+ * @class RayHeightfield
+ *
+ * A regular grid of heights, such as the terrain, for the ray tracer. Each grid cell is split
+ * into two triangles along the same diagonal the terrain mesh uses. Rays are traced through a
+ * min/max pyramid over the cells: level 0 is the cells themselves, and each node of a level
+ * above covers 2x2 nodes of the level below and stores the lowest and highest height under
+ * them. Whole blocks of cells the ray passes above or below are skipped at once, so a ray
+ * visits O(log N) nodes instead of every cell under it.
+ * Heights are given in world space; the heightfield has no transform of its own.
+ */
+class RayHeightfield
+{
+public:
+    // heights holds numRows * numCols vertex heights, row by row. Vertex (row, col) lies at
+    // x = -halfExtent + row * 2 * halfExtent / numRows, z likewise for col and numCols.
+    RayHeightfield(std::vector<float> heights, int numRows, int numCols, float halfExtent);
+
+    BoundingBox getBounds() const;
+    Intersection intersect(const Ray &ray) const;
+    float intersectT(const Ray &ray) const;
+    UV mapToUV(glm::vec3 pos) const;
+
+private:
+    struct HeightRange {
+        float min;
+        float max;
+    };
+
+    // Size of one pyramid level in nodes, and where its ranges start in m_ranges
+    struct PyramidLevel {
+        int rows;
+        int cols;
+        int offset;
+    };
+
+    // Nodes waiting to be visited: at most 3 per level plus the root
+    static const int maxTraversalDepth = 64;
+
+    void buildPyramid();
+    HeightRange getRange(int level, int row, int col) const;
+    BoundingBox getNodeBounds(int level, int row, int col) const;
+    float getHeight(int row, int col) const;
+    glm::vec3 getPosition(int row, int col) const;
+    glm::vec3 getVertexNormal(int row, int col) const;
+    float intersectCell(const Ray &ray, int row, int col) const;
+
+    std::vector<float> m_heights;
+    int m_numRows;
+    int m_numCols;
+    glm::vec3 m_origin;
+    float m_rowSpacing;
+    float m_colSpacing;
+    BoundingBox m_bounds;
+
+    // From the cells up to a single root node. Only levels 1 and up have ranges stored in
+    // m_ranges; level 0 ranges are read straight from the cell corner heights.
+    std::vector<PyramidLevel> m_levels;
+    std::vector<HeightRange> m_ranges;
+};
+
+#endif // RAYHEIGHTFIELD_H
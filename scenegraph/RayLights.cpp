@@ -0,0 +1,181 @@
+#include "RayLights.h"
+
+#include <cmath>
+
+// Relative contribution of each channel to how bright a light looks
+const glm::vec3 luminanceWeights = glm::vec3(0.299f, 0.587f, 0.114f);
+
+/**
+ *  Distance at which a light of the given color falls below minLightContribution under the
+ *  attenuation 1 / (c + l d + q d^2), INFINITY if it never does, or 0 if it never rises above it.
+ */
+static float getInfluenceRadius(glm::vec3 color, glm::vec3 function) {
+    float brightest = std::max(color.r, std::max(color.g, color.b));
+    if (brightest < minLightContribution) {
+        return 0.f;
+    }
+    // Solve c + l d + q d^2 = brightest / minLightContribution for d
+    float c = function.x - brightest / minLightContribution;
+    float l = function.y;
+    float q = function.z;
+    if (c > 0.f) {
+        return 0.f;
+    }
+    if (q > 0.f) {
+        return (-l + std::sqrt(l * l - 4.f * q * c)) / (2.f * q);
+    }
+    if (q == 0.f && l > 0.f) {
+        return -c / l;
+    }
+    return INFINITY;
+}
+
+RayLightTable::RayLightTable()
+{
+}
+
+/** Bake every light this tracer supports and build the BVH over the ones with a finite reach */
+void RayLightTable::build(const std::vector<CS123SceneLightData> &lights) {
+    m_lights.clear();
+    m_unboundedLights.clear();
+    m_boundedLights.clear();
+    std::vector<BoundingBox> bounds;
+    for (const CS123SceneLightData &data : lights) {
+        RayLight light;
+        light.type = data.type;
+        light.color = glm::vec3(data.color);
+        light.function = data.function;
+        light.position = glm::vec3(data.pos);
+        light.direction = glm::vec3(0.f);
+        light.cosInner = -1.f;
+        light.cosOuter = -1.f;
+        switch (data.type) {
+            case LightType::LIGHT_POINT:
+                light.influenceRadius = getInfluenceRadius(light.color, light.function);
+                break;
+            case LightType::LIGHT_SPOT:
+                light.direction = glm::normalize(glm::vec3(data.dir));
+                light.cosInner = std::cos(data.angle * PI / 180.f);
+                light.cosOuter = std::cos((data.angle + data.penumbra) * PI / 180.f);
+                light.influenceRadius = getInfluenceRadius(light.color, light.function);
+                break;
+            case LightType::LIGHT_DIRECTIONAL:
+                light.direction = glm::normalize(glm::vec3(data.dir));
+                light.influenceRadius = INFINITY;
+                break;
+            default:
+                // Area lights are not supported
+                continue;
+        }
+        if (light.influenceRadius <= 0.f) {
+            continue;
+        }
+
+        int lightIndex = m_lights.size();
+        m_lights.push_back(light);
+        if (light.influenceRadius == INFINITY) {
+            m_unboundedLights.push_back(lightIndex);
+        } else {
+            m_boundedLights.push_back(lightIndex);
+            bounds.push_back(BoundingBox(light.position - glm::vec3(light.influenceRadius),
+                                         light.position + glm::vec3(light.influenceRadius)));
+        }
+    }
+    m_bvh.build(bounds);
+}
+
+int RayLightTable::size() const {
+    return m_lights.size();
+}
+
+/**
+ *  The light's direction, distance and intensity at a point, with the same attenuation the
+ *  Phong model has always used. Returns false if it is too dim there to matter.
+ */
+bool RayLightTable::sampleLight(const RayLight &light, glm::vec3 point, RayLightSample &sample) const {
+    if (light.type == LightType::LIGHT_DIRECTIONAL) {
+        sample.surfaceToLight = -light.direction;
+        sample.distance = INFINITY;
+        sample.intensity = light.color;
+    } else {
+        sample.surfaceToLight = glm::normalize(light.position - point);
+        sample.distance = glm::distance(point, light.position);
+        float distance = sample.distance;
+        float rawAttenuation = 1.0f /
+                (light.function.x + light.function.y * distance + light.function.z * distance * distance);
+        sample.intensity = std::min(rawAttenuation, 1.0f) * light.color;
+        if (light.type == LightType::LIGHT_SPOT) {
+            // Smooth falloff from the edge of the fully lit cone to the edge of the penumbra
+            float cosAngle = glm::dot(-sample.surfaceToLight, light.direction);
+            float falloff = cosAngle >= light.cosInner ? 1.f : 0.f;
+            if (light.cosInner > light.cosOuter) {
+                falloff = glm::clamp((cosAngle - light.cosOuter) / (light.cosInner - light.cosOuter), 0.f, 1.f);
+                falloff = falloff * falloff * (3.f - 2.f * falloff);
+            }
+            sample.intensity *= falloff;
+        }
+    }
+    return std::max(sample.intensity.r, std::max(sample.intensity.g, sample.intensity.b))
+            >= minLightContribution;
+}
+
+/** visit(sample) for every light bright enough at the point, unbounded lights first */
+template <typename VisitFunction>
+void RayLightTable::forEachReachingLight(glm::vec3 point, VisitFunction visit) const {
+    RayLightSample sample;
+    for (int lightIndex : m_unboundedLights) {
+        if (sampleLight(m_lights[lightIndex], point, sample)) {
+            visit(sample);
+        }
+    }
+    m_bvh.forEachContaining(point, [&](int i) {
+        if (sampleLight(m_lights[m_boundedLights[i]], point, sample)) {
+            visit(sample);
+        }
+    });
+}
+
+/**
+ *  Collect the lights reaching a point. If there are more than maxShadedLights, they are
+ *  chosen by systematic sampling: maxShadedLights evenly spaced marks, offset by u, are laid
+ *  along the running sum of the lights' luminance, and each light is taken once for every
+ *  mark that falls on it. A light taken k times is weighted by k times the spacing over its
+ *  luminance, which keeps the expected total unchanged. Dim lights are mostly skipped, and
+ *  every light brighter than the spacing is always taken.
+ */
+int RayLightTable::gatherLights(glm::vec3 point, float u, RayLightSample samples[maxShadedLights]) const {
+    int numReaching = 0;
+    float totalLuminance = 0.f;
+    forEachReachingLight(point, [&](const RayLightSample &sample) {
+        if (numReaching < maxShadedLights) {
+            samples[numReaching] = sample;
+        }
+        numReaching++;
+        totalLuminance += glm::dot(sample.intensity, luminanceWeights);
+    });
+    if (numReaching <= maxShadedLights) {
+        return numReaching;
+    }
+
+    float spacing = totalLuminance / maxShadedLights;
+    float nextMark = u * spacing;
+    float runningLuminance = 0.f;
+    int numSamples = 0;
+    int totalMarks = 0;
+    forEachReachingLight(point, [&](const RayLightSample &sample) {
+        float luminance = glm::dot(sample.intensity, luminanceWeights);
+        runningLuminance += luminance;
+        int numMarks = 0;
+        while (nextMark < runningLuminance && totalMarks < maxShadedLights) {
+            numMarks++;
+            totalMarks++;
+            nextMark += spacing;
+        }
+        if (numMarks > 0) {
+            samples[numSamples] = sample;
+            samples[numSamples].intensity *= numMarks * spacing / luminance;
+            numSamples++;
+        }
+    });
+    return numSamples;
+}
@@ -0,0 +1,78 @@
+#ifndef RAYLIGHTS_H
+#define RAYLIGHTS_H
+
+#include "BVH.h"
+#include "CS123SceneData.h"
+
+#include <vector>
+
+/** Light reaching a point with no channel above this is ignored; one step of an 8-bit pixel */
+const float minLightContribution = 1.f / 255.f;
+
+/**
+ *  The most lights shaded at one point. Where more than this reach a point, this many are
+ *  picked at random in proportion to their intensity there, and weighted so that the
+ *  expected sum is unchanged.
+ */
+const int maxShadedLights = 8;
+
+/**
+ *  A light baked for the ray tracer. Spot lights use the light's angle as the half angle of
+ *  the fully lit cone and its penumbra as the width of the soft edge around it, in degrees.
+ */
+struct RayLight {
+    LightType type;
+    glm::vec3 color;
+    glm::vec3 function;
+    glm::vec3 position;
+    // Unit direction the light shines in; directional and spot lights only
+    glm::vec3 direction;
+    // Spot lights: cosines of the half angles of the fully lit cone and of the penumbra's edge
+    float cosInner;
+    float cosOuter;
+    // Beyond this distance the attenuated light is below minLightContribution, or INFINITY
+    float influenceRadius;
+};
+
+/** The light one RayLight sheds on a point, before shadows and the surface are considered */
+struct RayLightSample {
+    glm::vec3 surfaceToLight;
+    // Distance to the light, or INFINITY for directional lights
+    float distance;
+    // Color after attenuation, spot falloff and any sampling weight
+    glm::vec3 intensity;
+};
+
+/**
+ * @class RayLightTable
+ *
+ * The lights of a scene with the influence radius their attenuation gives them, plus a BVH
+ * over the bounds of the lights that have one, so that shading a point only looks at the
+ * lights that can reach it. It has no Qt dependencies, and queries only read the table.
+ */
+class RayLightTable
+{
+public:
+    RayLightTable();
+
+    void build(const std::vector<CS123SceneLightData> &lights);
+    int size() const;
+
+    // Fills samples with the lights that reach point, picking maxShadedLights of them by
+    // intensity if there are more. u in [0, 1) drives the picking. Returns the sample count.
+    int gatherLights(glm::vec3 point, float u, RayLightSample samples[maxShadedLights]) const;
+
+private:
+    bool sampleLight(const RayLight &light, glm::vec3 point, RayLightSample &sample) const;
+    template <typename VisitFunction>
+    void forEachReachingLight(glm::vec3 point, VisitFunction visit) const;
+
+    std::vector<RayLight> m_lights;
+    // Lights that reach everywhere, such as directional lights, and are never culled
+    std::vector<int> m_unboundedLights;
+    // Over the influence spheres of the other lights, indexed into m_boundedLights
+    BVH m_bvh;
+    std::vector<int> m_boundedLights;
+};
+
+#endif // RAYLIGHTS_H
@@ -0,0 +1,248 @@
+#include "RayPrimitives.h"
+
+#include <new>
+
+RayPrimitiveTable::RayPrimitiveTable() :
+    m_records(nullptr),
+    m_size(0)
+{
+    m_implicitSphere = std::make_unique<ImplicitSphere>();
+    m_implicitCylinder = std::make_unique<ImplicitCylinder>();
+    m_implicitCone = std::make_unique<ImplicitCone>();
+    m_implicitCube = std::make_unique<ImplicitCube>();
+    m_implicitTrunk = std::make_unique<ImplicitTrunk>();
+    m_implicitLeaf = std::make_unique<ImplicitLeaf>();
+}
+
+/** Bake one record per primitive and build the BVH over their world space bounds */
+void RayPrimitiveTable::build(const std::vector<CS123ScenePrimitive> &primitives,
+                              const std::vector<glm::mat4> &matrices,
+                              std::shared_ptr<const RayHeightfield> heightfield) {
+    m_heightfield = heightfield;
+    m_size = primitives.size();
+    m_storage.reset(new char[m_size * sizeof(RayPrimitive) + cacheLineSize]);
+    void *aligned = m_storage.get();
+    size_t space = m_size * sizeof(RayPrimitive) + cacheLineSize;
+    RayPrimitive *records = static_cast<RayPrimitive *>(
+                std::align(cacheLineSize, m_size * sizeof(RayPrimitive), aligned, space));
+    m_records = records;
+
+    std::vector<BoundingBox> primitiveBounds(m_size);
+    for (int i = 0; i < m_size; i++) {
+        RayPrimitive &record = *new (&records[i]) RayPrimitive();
+        record.objectToWorld = matrices[i];
+        record.worldToObject = glm::inverse(matrices[i]);
+        record.normalMatrix = glm::transpose(glm::inverse(glm::mat3(matrices[i])));
+        record.bounds = transformedBounds(getObjectBounds(primitives[i].type), matrices[i]);
+        record.type = primitives[i].type;
+        record.materialIndex = i;
+        primitiveBounds[i] = record.bounds;
+    }
+    m_bvh.build(primitiveBounds);
+}
+
+void RayPrimitiveTable::attach(const RayPrimitive *records, int size, const BVH::Node *nodes, int numNodes,
+                               const int *primitiveIndices) {
+    m_heightfield = nullptr;
+    m_storage.reset();
+    m_records = records;
+    m_size = size;
+    m_bvh.attach(nodes, numNodes, primitiveIndices, size);
+}
+
+/** Object space bounds of a primitive type; the implicit shapes all fill the unit cube */
+BoundingBox RayPrimitiveTable::getObjectBounds(PrimitiveType type) const {
+    switch (type) {
+        case PrimitiveType::PRIMITIVE_LEAF:
+            // Padded in z so the flat leaf still has a volume to traverse
+            return BoundingBox(glm::vec3(0.f, -leafMaxHalfWidth, -EPSILON),
+                               glm::vec3(1.f, leafMaxHalfWidth, EPSILON));
+        case PrimitiveType::PRIMITIVE_TERRAIN:
+            return m_heightfield->getBounds();
+        default:
+            return BoundingBox(glm::vec3(-radius), glm::vec3(radius));
+    }
+}
+
+int RayPrimitiveTable::size() const {
+    return m_size;
+}
+
+const RayPrimitive &RayPrimitiveTable::operator[](int primitiveIndex) const {
+    return m_records[primitiveIndex];
+}
+
+const RayPrimitive *RayPrimitiveTable::getRecords() const {
+    return m_records;
+}
+
+const BVH &RayPrimitiveTable::getBVH() const {
+    return m_bvh;
+}
+
+int RayPrimitiveTable::closestHit(const Ray &ray, bool useBVH, Intersection &nearest,
+                                  RayStats *stats) const {
+    float tBest = INFINITY;
+    int nearestPrimitive = -1;
+    int numTests = 0;
+    int numHits = 0;
+    auto testPrimitive = [&](int i, float &tClosest) {
+        numTests++;
+        Intersection intersection = intersect(ray, i);
+        if (intersection.t >= EPSILON && intersection.t < tClosest) {
+            numHits++;
+            tClosest = intersection.t;
+            nearestPrimitive = i;
+            nearest = intersection;
+            return true;
+        }
+        return false;
+    };
+
+    if (useBVH) {
+        m_bvh.closestHit(ray, tBest, testPrimitive, stats ? &stats->nodesVisited : nullptr);
+    } else {
+        for (int i = 0; i < m_size; i++) {
+            testPrimitive(i, tBest);
+        }
+    }
+    if (stats) {
+        stats->primitiveTests += numTests;
+        stats->primitiveHits += numHits;
+    }
+    return nearestPrimitive;
+}
+
+void RayPrimitiveTable::closestHit(const RayPacket &packet, int nearestPrimitive[rayPacketSize],
+                                   Intersection nearest[rayPacketSize], RayStats *stats) const {
+    float tBest[rayPacketSize];
+    for (int i = 0; i < rayPacketSize; i++) {
+        tBest[i] = INFINITY;
+        nearestPrimitive[i] = -1;
+    }
+    int numTests = 0;
+    int numHits = 0;
+    m_bvh.closestHit(packet, tBest, [&](int i, int ray, float &tClosest) {
+        numTests++;
+        Intersection intersection = intersect(packet.rays[ray], i);
+        if (intersection.t >= EPSILON && intersection.t < tClosest) {
+            numHits++;
+            tClosest = intersection.t;
+            nearestPrimitive[ray] = i;
+            nearest[ray] = intersection;
+            return true;
+        }
+        return false;
+    }, stats ? &stats->nodesVisited : nullptr);
+    if (stats) {
+        stats->primitiveTests += numTests;
+        stats->primitiveHits += numHits;
+    }
+}
+
+/** Occlusion query for shadow rays: no nearest hit is tracked and no normal or UV is computed */
+bool RayPrimitiveTable::anyHit(const Ray &ray, float tMax, bool useBVH, RayStats *stats) const {
+    int numTests = 0;
+    auto occludes = [&](int i, float tLimit) {
+        numTests++;
+        float t = intersectT(ray, i);
+        return t >= EPSILON && t < tLimit;
+    };
+
+    bool isOccluded = false;
+    if (useBVH) {
+        isOccluded = m_bvh.anyHit(ray, tMax, occludes, stats ? &stats->nodesVisited : nullptr);
+    } else {
+        for (int i = 0; i < m_size && !isOccluded; i++) {
+            isOccluded = occludes(i, tMax);
+        }
+    }
+    if (stats) {
+        stats->primitiveTests += numTests;
+        stats->primitiveHits += isOccluded ? 1 : 0;
+    }
+    return isOccluded;
+}
+
+/**
+ *  Intersect a world space ray with one primitive. The ray direction is transformed but not
+ *  normalized, so the returned t is also the world space t.
+ */
+Intersection RayPrimitiveTable::intersect(const Ray &ray, int primitiveIndex) const {
+    const RayPrimitive &record = m_records[primitiveIndex];
+    Ray objectSpaceRay = toObjectSpace(ray, record);
+
+    switch (record.type) {
+        case PrimitiveType::PRIMITIVE_CYLINDER:
+            return m_implicitCylinder->intersect(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_CONE:
+            return m_implicitCone->intersect(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_CUBE:
+            return m_implicitCube->intersect(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_SPHERE:
+        case PrimitiveType::PRIMITIVE_FRUIT:
+            return m_implicitSphere->intersect(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_TRUNK:
+            return m_implicitTrunk->intersect(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_LEAF:
+            return m_implicitLeaf->intersect(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_TERRAIN:
+            return m_heightfield->intersect(objectSpaceRay);
+        default:
+            return Intersection();
+    }
+}
+
+float RayPrimitiveTable::intersectT(const Ray &ray, int primitiveIndex) const {
+    const RayPrimitive &record = m_records[primitiveIndex];
+    Ray objectSpaceRay = toObjectSpace(ray, record);
+
+    switch (record.type) {
+        case PrimitiveType::PRIMITIVE_CYLINDER:
+            return m_implicitCylinder->intersectT(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_CONE:
+            return m_implicitCone->intersectT(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_CUBE:
+            return m_implicitCube->intersectT(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_SPHERE:
+        case PrimitiveType::PRIMITIVE_FRUIT:
+            return m_implicitSphere->intersectT(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_TRUNK:
+            return m_implicitTrunk->intersectT(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_LEAF:
+            return m_implicitLeaf->intersectT(objectSpaceRay);
+        case PrimitiveType::PRIMITIVE_TERRAIN:
+            return m_heightfield->intersectT(objectSpaceRay);
+        default:
+            return -1;
+    }
+}
+
+Ray RayPrimitiveTable::toObjectSpace(const Ray &ray, const RayPrimitive &record) {
+    glm::vec3 objectSpaceDirection = glm::mat3(record.worldToObject) * ray.direction;
+    glm::vec3 objectSpaceEye = glm::vec3(record.worldToObject * glm::vec4(ray.startPoint, 1.0f));
+    return Ray(objectSpaceEye, objectSpaceDirection);
+}
+
+/** Texture coordinates of an object space point on the given primitive */
+UV RayPrimitiveTable::mapToUV(int primitiveIndex, glm::vec3 objectSpacePos) const {
+    switch (m_records[primitiveIndex].type) {
+        case PrimitiveType::PRIMITIVE_CYLINDER:
+            return m_implicitCylinder->mapToUV(objectSpacePos);
+        case PrimitiveType::PRIMITIVE_CONE:
+            return m_implicitCone->mapToUV(objectSpacePos);
+        case PrimitiveType::PRIMITIVE_CUBE:
+            return m_implicitCube->mapToUV(objectSpacePos);
+        case PrimitiveType::PRIMITIVE_SPHERE:
+        case PrimitiveType::PRIMITIVE_FRUIT:
+            return m_implicitSphere->mapToUV(objectSpacePos);
+        case PrimitiveType::PRIMITIVE_TRUNK:
+            return m_implicitTrunk->mapToUV(objectSpacePos);
+        case PrimitiveType::PRIMITIVE_LEAF:
+            return m_implicitLeaf->mapToUV(objectSpacePos);
+        case PrimitiveType::PRIMITIVE_TERRAIN:
+            return m_heightfield->mapToUV(objectSpacePos);
+        default:
+            return UV(0, 0);
+    }
+}
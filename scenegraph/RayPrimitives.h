@@ -0,0 +1,99 @@
+#ifndef RAYPRIMITIVES_H
+#define RAYPRIMITIVES_H
+
+#include "RayGeometry.h"
+#include "BVH.h"
+#include "CS123SceneData.h"
+#include "ImplicitSphere.h"
+#include "ImplicitCylinder.h"
+#include "ImplicitCone.h"
+#include "ImplicitCube.h"
+#include "ImplicitTrunk.h"
+#include "ImplicitLeaf.h"
+#include "RayHeightfield.h"
+#include "RayStats.h"
+
+#include <memory>
+#include <vector>
+
+/** Size of a cache line, which every RayPrimitive record is aligned to */
+const int cacheLineSize = 64;
+
+/**
+ *  Everything the ray tracer needs to know about one primitive, baked once per scene so that
+ *  no matrix is inverted while rendering. The matrix used on every ray-primitive test comes
+ *  first, so it fills exactly one cache line.
+ */
+struct alignas(cacheLineSize) RayPrimitive {
+    glm::mat4 worldToObject;
+    glm::mat4 objectToWorld;
+    // Inverse transpose of the upper 3x3 of objectToWorld, for transforming normals
+    glm::mat3 normalMatrix;
+    BoundingBox bounds;
+    PrimitiveType type;
+    // Index of the primitive's material and texture in the scene's per-primitive arrays
+    int materialIndex;
+};
+
+/**
+ * @class RayPrimitiveTable
+ *
+ * A flat, cache-aligned array of RayPrimitive records plus the BVH built over their bounds.
+ * It has no Qt or GL dependencies, so it can also be driven from headless benchmarks.
+ * Queries only read the table and are safe to run from several threads at once.
+ */
+class RayPrimitiveTable
+{
+public:
+    RayPrimitiveTable();
+
+    // heightfield is the geometry of any PRIMITIVE_TERRAIN primitives and may be null otherwise
+    void build(const std::vector<CS123ScenePrimitive> &primitives,
+               const std::vector<glm::mat4> &matrices,
+               std::shared_ptr<const RayHeightfield> heightfield = nullptr);
+    // Use records and a BVH saved from an earlier build, with no heightfield, instead of
+    // building. The arrays must outlive the table.
+    void attach(const RayPrimitive *records, int size, const BVH::Node *nodes, int numNodes,
+                const int *primitiveIndices);
+
+    int size() const;
+    const RayPrimitive &operator[](int primitiveIndex) const;
+    const RayPrimitive *getRecords() const;
+    const BVH &getBVH() const;
+
+    // Nearest hit with t >= EPSILON through the BVH, or by testing every primitive if useBVH is
+    // false. Returns the primitive index, or -1 on a miss; nearest is only set on a hit.
+    // The queries add the nodes they visit and the primitives they test to stats if given.
+    int closestHit(const Ray &ray, bool useBVH, Intersection &nearest, RayStats *stats = nullptr) const;
+    // closestHit for every ray of a packet, always through the BVH
+    void closestHit(const RayPacket &packet, int nearestPrimitive[rayPacketSize],
+                    Intersection nearest[rayPacketSize], RayStats *stats = nullptr) const;
+    // Whether any primitive is hit with t in [EPSILON, tMax); stops at the first such hit
+    bool anyHit(const Ray &ray, float tMax, bool useBVH, RayStats *stats = nullptr) const;
+    // Hit with one primitive, in object space but with the world space t
+    Intersection intersect(const Ray &ray, int primitiveIndex) const;
+    // As intersect, but only the t-value, or -1 on a miss
+    float intersectT(const Ray &ray, int primitiveIndex) const;
+    UV mapToUV(int primitiveIndex, glm::vec3 objectSpacePos) const;
+
+private:
+    static Ray toObjectSpace(const Ray &ray, const RayPrimitive &record);
+    BoundingBox getObjectBounds(PrimitiveType type) const;
+
+    // Over-allocated so the records can start on a cache line boundary; empty if the records
+    // were attached
+    std::unique_ptr<char[]> m_storage;
+    const RayPrimitive *m_records;
+    int m_size;
+    BVH m_bvh;
+
+    std::unique_ptr<ImplicitSphere> m_implicitSphere;
+    std::unique_ptr<ImplicitCylinder> m_implicitCylinder;
+    std::unique_ptr<ImplicitCone> m_implicitCone;
+    std::unique_ptr<ImplicitCube> m_implicitCube;
+    std::unique_ptr<ImplicitTrunk> m_implicitTrunk;
+    std::unique_ptr<ImplicitLeaf> m_implicitLeaf;
+    std::shared_ptr<const RayHeightfield> m_heightfield;
+};
+
+#endif // RAYPRIMITIVES_H
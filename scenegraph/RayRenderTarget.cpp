@@ -0,0 +1,203 @@
+#include "RayRenderTarget.h"
+
+#include <cstring>
+#include <iostream>
+
+const char tileFileMagic[4] = { 'R', 'T', 'I', 'L' };
+
+RayRenderTarget::RayRenderTarget(int width, int height) :
+    m_width(width),
+    m_height(height)
+{
+}
+
+RayRenderTarget::~RayRenderTarget()
+{
+}
+
+int RayRenderTarget::getWidth() const {
+    return m_width;
+}
+
+int RayRenderTarget::getHeight() const {
+    return m_height;
+}
+
+bool RayRenderTarget::isProgressive() const {
+    return false;
+}
+
+bool RayRenderTarget::finish() {
+    return true;
+}
+
+
+RayImageTarget::RayImageTarget(RGBA *pixels, int width, int height, bool progressive) :
+    RayRenderTarget(width, height),
+    m_pixels(pixels),
+    m_progressive(progressive)
+{
+}
+
+bool RayImageTarget::isProgressive() const {
+    return m_progressive;
+}
+
+void RayImageTarget::writeTile(const RayTile &tile, const RGBA *pixels) {
+    for (int row = 0; row < tile.height; row++) {
+        memcpy(&m_pixels[(tile.y + row) * getWidth() + tile.x], &pixels[row * tile.width],
+               tile.width * sizeof(RGBA));
+    }
+}
+
+
+RayTileFileTarget::RayTileFileTarget(const std::string &filename, int width, int height) :
+    RayRenderTarget(width, height),
+    m_filename(filename),
+    m_offset(0)
+{
+}
+
+bool RayTileFileTarget::begin() {
+    m_file.open(m_filename, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        std::cerr << "could not open " << m_filename << " for writing" << std::endl;
+        return false;
+    }
+    RayTileFileHeader header;
+    header.version = rayTileFileVersion;
+    header.width = getWidth();
+    header.height = getHeight();
+    m_file.write(tileFileMagic, sizeof(tileFileMagic));
+    m_file.write(reinterpret_cast<const char *>(&header), sizeof(RayTileFileHeader));
+    m_offset = sizeof(tileFileMagic) + sizeof(RayTileFileHeader);
+    return m_file.good();
+}
+
+void RayTileFileTarget::writeTile(const RayTile &tile, const RGBA *pixels) {
+    RayTileFileEntry entry;
+    entry.x = tile.x;
+    entry.y = tile.y;
+    entry.width = tile.width;
+    entry.height = tile.height;
+    size_t size = tile.width * tile.height * sizeof(RGBA);
+
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    entry.offset = m_offset;
+    m_file.write(reinterpret_cast<const char *>(pixels), size);
+    m_offset += size;
+    m_index.push_back(entry);
+}
+
+bool RayTileFileTarget::finish() {
+    uint32_t numEntries = m_index.size();
+    m_file.write(reinterpret_cast<const char *>(m_index.data()), numEntries * sizeof(RayTileFileEntry));
+    m_file.write(reinterpret_cast<const char *>(&numEntries), sizeof(numEntries));
+    m_file.close();
+    if (m_file.fail()) {
+        std::cerr << "could not write " << m_filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+RayTileFileReader::RayTileFileReader()
+{
+    memset(&m_header, 0, sizeof(RayTileFileHeader));
+}
+
+bool RayTileFileReader::open(const std::string &filename) {
+    m_filename = filename;
+    m_index.clear();
+    m_file.open(filename, std::ios::binary);
+    if (!m_file) {
+        std::cerr << "could not open " << filename << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(tileFileMagic)];
+    m_file.read(magic, sizeof(magic));
+    m_file.read(reinterpret_cast<char *>(&m_header), sizeof(RayTileFileHeader));
+    m_file.seekg(0, std::ios::end);
+    uint64_t fileSize = m_file.tellg();
+    uint64_t headerSize = sizeof(tileFileMagic) + sizeof(RayTileFileHeader);
+    if (!m_file || memcmp(magic, tileFileMagic, sizeof(tileFileMagic)) != 0
+            || m_header.version != rayTileFileVersion || fileSize < headerSize + sizeof(uint32_t)) {
+        std::cerr << filename << " is not a tile file" << std::endl;
+        return false;
+    }
+
+    // The index is found from the count at the end of the file
+    uint32_t numEntries;
+    m_file.seekg(fileSize - sizeof(numEntries));
+    m_file.read(reinterpret_cast<char *>(&numEntries), sizeof(numEntries));
+    uint64_t indexSize = static_cast<uint64_t>(numEntries) * sizeof(RayTileFileEntry);
+    if (!m_file || indexSize > fileSize - headerSize - sizeof(numEntries)) {
+        std::cerr << filename << " has a damaged index" << std::endl;
+        return false;
+    }
+    uint64_t indexOffset = fileSize - sizeof(numEntries) - indexSize;
+    m_index.resize(numEntries);
+    m_file.seekg(indexOffset);
+    m_file.read(reinterpret_cast<char *>(m_index.data()), indexSize);
+    if (!m_file || !isIndexValid(indexOffset)) {
+        std::cerr << filename << " has a damaged index, or tiles that do not cover the image "
+                  << "exactly once" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int RayTileFileReader::getWidth() const {
+    return m_header.width;
+}
+
+int RayTileFileReader::getHeight() const {
+    return m_header.height;
+}
+
+/** Whether every tile's pixels lie before the index and the tiles cover the image exactly once */
+bool RayTileFileReader::isIndexValid(uint64_t indexOffset) const {
+    uint64_t width = m_header.width;
+    uint64_t height = m_header.height;
+    uint64_t tilesStart = sizeof(tileFileMagic) + sizeof(RayTileFileHeader);
+    std::vector<bool> covered(width * height, false);
+    uint64_t numCovered = 0;
+    for (const RayTileFileEntry &entry : m_index) {
+        uint64_t size = static_cast<uint64_t>(entry.width) * entry.height * sizeof(RGBA);
+        if (entry.x + static_cast<uint64_t>(entry.width) > width
+                || entry.y + static_cast<uint64_t>(entry.height) > height
+                || entry.offset < tilesStart || entry.offset > indexOffset
+                || size > indexOffset - entry.offset) {
+            return false;
+        }
+        for (uint64_t row = entry.y; row < entry.y + entry.height; row++) {
+            for (uint64_t col = entry.x; col < entry.x + entry.width; col++) {
+                if (covered[row * width + col]) {
+                    return false;
+                }
+                covered[row * width + col] = true;
+            }
+        }
+        numCovered += static_cast<uint64_t>(entry.width) * entry.height;
+    }
+    return numCovered == width * height;
+}
+
+bool RayTileFileReader::read(RayRenderTarget &target) {
+    std::vector<RGBA> pixels;
+    for (const RayTileFileEntry &entry : m_index) {
+        RayTile tile = { static_cast<int>(entry.x), static_cast<int>(entry.y),
+                         static_cast<int>(entry.width), static_cast<int>(entry.height) };
+        pixels.resize(static_cast<size_t>(entry.width) * entry.height);
+        m_file.seekg(entry.offset);
+        m_file.read(reinterpret_cast<char *>(pixels.data()), pixels.size() * sizeof(RGBA));
+        if (!m_file) {
+            std::cerr << "could not read " << m_filename << std::endl;
+            return false;
+        }
+        target.writeTile(tile, pixels.data());
+    }
+    return target.finish();
+}
@@ -0,0 +1,142 @@
+#ifndef RAYRENDERTARGET_H
+#define RAYRENDERTARGET_H
+
+#include "RGBA.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** A rectangle of pixels rendered as one unit of work */
+struct RayTile {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+/**
+ * @class RayRenderTarget
+ *
+ * Where RayScene puts the pixels it renders. Each tile is handed over as soon as it is
+ * finished, so a target does not have to hold the whole image. writeTile is called from the
+ * render worker threads, concurrently for different tiles.
+ */
+class RayRenderTarget {
+public:
+    RayRenderTarget(int width, int height);
+    virtual ~RayRenderTarget();
+
+    int getWidth() const;
+    int getHeight() const;
+
+    // Whether intermediate results, i.e. a low resolution preview and every pixel before it is
+    // supersampled, are written too, for a target that is shown while it renders
+    virtual bool isProgressive() const;
+    // tile.width * tile.height pixels in row-major order. A later write of a tile replaces it.
+    virtual void writeTile(const RayTile &tile, const RGBA *pixels) = 0;
+    // Called once the render has finished or was cancelled; false if the output failed
+    virtual bool finish();
+
+private:
+    int m_width;
+    int m_height;
+};
+
+/**
+ * @class RayImageTarget
+ *
+ * Copies tiles into a width * height image owned by the caller, such as the 2D canvas.
+ */
+class RayImageTarget : public RayRenderTarget {
+public:
+    RayImageTarget(RGBA *pixels, int width, int height, bool progressive);
+
+    bool isProgressive() const override;
+    void writeTile(const RayTile &tile, const RGBA *pixels) override;
+
+private:
+    RGBA *m_pixels;
+    bool m_progressive;
+};
+
+/**
+ *  Tile file layout:
+ *    header   "RTIL", version, width, height (uint32 each)
+ *    tiles    the RGBA pixels of each tile, row-major, in the order the tiles finished
+ *    index    one RayTileFileEntry per tile
+ *    count    the number of index entries (uint32)
+ *  Only the index is kept in memory while rendering; it is written by finish(). A reader
+ *  finds it from the count at the end of the file.
+ */
+struct RayTileFileHeader {
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct RayTileFileEntry {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    // Byte offset of the tile's pixels from the start of the file
+    uint64_t offset;
+};
+
+const uint32_t rayTileFileVersion = 1;
+
+/**
+ * @class RayTileFileTarget
+ *
+ * Streams finished tiles straight to a tile file, so an image of any size can be rendered
+ * without its framebuffer ever being in memory.
+ */
+class RayTileFileTarget : public RayRenderTarget {
+public:
+    RayTileFileTarget(const std::string &filename, int width, int height);
+
+    // Opens the file and writes the header
+    bool begin();
+    void writeTile(const RayTile &tile, const RGBA *pixels) override;
+    // Writes the index and closes the file
+    bool finish() override;
+
+private:
+    std::ofstream m_file;
+    std::string m_filename;
+    std::mutex m_fileMutex;
+    std::vector<RayTileFileEntry> m_index;
+    uint64_t m_offset;
+};
+
+/**
+ * @class RayTileFileReader
+ *
+ * Reads back a tile file written by RayTileFileTarget, e.g. to assemble it into an image.
+ * Only the index is held in memory; the tiles are read one at a time.
+ */
+class RayTileFileReader {
+public:
+    RayTileFileReader();
+
+    // Reads the header and index, checking that every tile lies within the file and the image
+    // and that the tiles cover every pixel exactly once
+    bool open(const std::string &filename);
+    int getWidth() const;
+    int getHeight() const;
+    // Writes every tile to target, which must be the size of the image
+    bool read(RayRenderTarget &target);
+
+private:
+    bool isIndexValid(uint64_t indexOffset) const;
+
+    std::ifstream m_file;
+    std::string m_filename;
+    RayTileFileHeader m_header;
+    std::vector<RayTileFileEntry> m_index;
+};
+
+#endif // RAYRENDERTARGET_H
@@ -2,24 +2,34 @@
 #include "Settings.h"
 #include "RayGeometry.h"
 #include "CS123SceneData.h"
-#include "qcoreapplication.h"
 
 #include "glm/gtx/transform.hpp"
 #include "glm/gtx/string_cast.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
 
 
 RayScene::RayScene(Scene &scene) :
     Scene(scene),
     m_viewPlaneDepth(1.0f),
     m_rendering(false),
-    m_recursionDepth(0)
+    m_numThreads(0),
+    m_memoryBudget(0),
+    m_collectStats(false)
 {
-    m_implicitShape = std::make_unique<ImplicitShape>();
-    m_implicitSphere = std::make_unique<ImplicitSphere>();
-    m_implicitCylinder = std::make_unique<ImplicitCylinder>();
-    m_implicitCone = std::make_unique<ImplicitCone>();
-    m_implicitCube = std::make_unique<ImplicitCube>();
+    // The ground is traced as one more primitive, so it shares the BVH, materials and shading
+    if (m_heightfield) {
+        m_primitives.push_back(CS123ScenePrimitive(PrimitiveType::PRIMITIVE_TERRAIN, m_heightfieldMaterial));
+        m_matrices.push_back(glm::mat4(1.f));
+        m_textures.push_back(QImage());
+    }
+    m_rayPrimitives.build(m_primitives, m_matrices, m_heightfield);
+    loadTextures();
     // TODO [INTERSECT]
     // Remember that any pointers or OpenGL objects (e.g. texture IDs) will
     // be deleted when the old scene is deleted (assuming you are managing
@@ -27,257 +37,761 @@ RayScene::RayScene(Scene &scene) :
     // may need to re-allocate some things here.
 }
 
+/**
+ *  Rebuild the scene from a mapped cache. Only the materials are copied out of it, into the
+ *  scene's primitives; the baked records, the BVH and the texels are used where they are.
+ */
+RayScene::RayScene(std::shared_ptr<const RaySceneCache> cache) :
+    m_cache(cache),
+    m_viewPlaneDepth(1.0f),
+    m_rendering(false),
+    m_numThreads(0),
+    m_memoryBudget(0),
+    m_collectStats(false)
+{
+    m_globalData = cache->getHeader().global;
+    int numLights;
+    const CS123SceneLightData *lights = cache->getSection<CS123SceneLightData>(
+                RaySceneCacheSection::CACHE_LIGHTS, numLights);
+    m_lights.assign(lights, lights + numLights);
+
+    int numTextures, numTexels;
+    const RayCachedTexture *textures = cache->getSection<RayCachedTexture>(
+                RaySceneCacheSection::CACHE_TEXTURES, numTextures);
+    const glm::vec4 *texels = cache->getSection<glm::vec4>(RaySceneCacheSection::CACHE_TEXELS, numTexels);
+    for (int i = 0; i < numTextures; i++) {
+        m_rayTextures.push_back(std::make_unique<RayTexture>(&texels[textures[i].firstTexel],
+                                                             textures[i].width, textures[i].height));
+    }
+
+    int numPrimitives, numNodes, numIndices;
+    const RayPrimitive *records = cache->getSection<RayPrimitive>(
+                RaySceneCacheSection::CACHE_PRIMITIVES, numPrimitives);
+    const RayCachedMaterial *materials = cache->getSection<RayCachedMaterial>(
+                RaySceneCacheSection::CACHE_MATERIALS, numPrimitives);
+    const BVH::Node *nodes = cache->getSection<BVH::Node>(RaySceneCacheSection::CACHE_BVH_NODES, numNodes);
+    const int *indices = cache->getSection<int>(RaySceneCacheSection::CACHE_BVH_INDICES, numIndices);
+    auto toFileMap = [&](const RayCachedFileMap &cached) {
+        CS123SceneFileMap map;
+        map.isUsed = cached.isUsed != 0;
+        map.filename = cache->getString(cached.filename);
+        map.repeatU = cached.repeatU;
+        map.repeatV = cached.repeatV;
+        return map;
+    };
+    for (int i = 0; i < numPrimitives; i++) {
+        const RayCachedMaterial &cached = materials[i];
+        CS123SceneMaterial material;
+        material.cDiffuse = cached.cDiffuse;
+        material.cAmbient = cached.cAmbient;
+        material.cReflective = cached.cReflective;
+        material.cSpecular = cached.cSpecular;
+        material.cTransparent = cached.cTransparent;
+        material.cEmissive = cached.cEmissive;
+        material.textureMap = toFileMap(cached.textureMap);
+        material.bumpMap = toFileMap(cached.bumpMap);
+        material.blend = cached.blend;
+        material.shininess = cached.shininess;
+        material.ior = cached.ior;
+        m_primitives.push_back(CS123ScenePrimitive(cached.type, material));
+        m_primitives.back().meshfile = cache->getString(cached.meshfile);
+        m_matrices.push_back(records[i].objectToWorld);
+        m_primitiveTextures.push_back(cached.textureIndex >= 0 ? m_rayTextures[cached.textureIndex].get()
+                                                               : nullptr);
+    }
+    // The textures are already decoded, so no QImages are kept
+    m_textures.resize(numPrimitives);
+    m_rayPrimitives.attach(records, numPrimitives, nodes, numNodes, indices);
+}
+
 RayScene::~RayScene()
 {
 }
 
 /**
- *  Main ray tracing loop. For each pixel, find the closest intersecting object and
- *  compute the color at the intersection point. If there is no intersecting object,
- *  set the pixel to black.
+ *  Write the cache. Every section but the materials, textures and dependencies is written
+ *  straight from the arrays the renderer uses.
+ */
+bool RayScene::writeCache(const std::string &filename, const std::string &sceneHash,
+                          const CS123SceneCameraData &camera) const {
+    if (m_heightfield) {
+        std::cerr << "scenes with a heightfield cannot be cached" << std::endl;
+        return false;
+    }
+    RaySceneCacheWriter writer;
+
+    std::map<const RayTexture *, int> textureIndices;
+    std::vector<RayCachedTexture> textures;
+    std::vector<glm::vec4> texels;
+    for (const std::unique_ptr<RayTexture> &texture : m_rayTextures) {
+        textureIndices[texture.get()] = textures.size();
+        textures.push_back({ texture->getWidth(), texture->getHeight(), texels.size() });
+        texels.insert(texels.end(), texture->getTexels(),
+                      texture->getTexels() + texture->getWidth() * texture->getHeight());
+    }
+
+    std::vector<RayCachedMaterial> materials(m_primitives.size());
+    std::map<std::string, std::string> textureHashes;
+    auto toCachedFileMap = [&](const CS123SceneFileMap &map) {
+        RayCachedFileMap cached;
+        cached.isUsed = map.isUsed;
+        cached.filename = writer.addString(map.isUsed ? map.filename : std::string());
+        cached.repeatU = map.repeatU;
+        cached.repeatV = map.repeatV;
+        return cached;
+    };
+    for (int i = 0; i < m_primitives.size(); i++) {
+        const CS123ScenePrimitive &primitive = m_primitives[i];
+        const CS123SceneMaterial &material = primitive.material;
+        RayCachedMaterial &cached = materials[i];
+        memset(&cached, 0, sizeof(RayCachedMaterial));
+        cached.type = primitive.type;
+        cached.meshfile = writer.addString(primitive.meshfile);
+        cached.cDiffuse = material.cDiffuse;
+        cached.cAmbient = material.cAmbient;
+        cached.cReflective = material.cReflective;
+        cached.cSpecular = material.cSpecular;
+        cached.cTransparent = material.cTransparent;
+        cached.cEmissive = material.cEmissive;
+        cached.textureMap = toCachedFileMap(material.textureMap);
+        cached.bumpMap = toCachedFileMap(material.bumpMap);
+        cached.blend = material.blend;
+        cached.shininess = material.shininess;
+        cached.ior = material.ior;
+        cached.textureIndex = m_primitiveTextures[i] ? textureIndices[m_primitiveTextures[i]] : -1;
+        if (material.textureMap.isUsed) {
+            textureHashes[material.textureMap.filename] = RaySceneCache::hashFile(material.textureMap.filename);
+        }
+    }
+
+    // Texture maps that could not be read are recorded with an empty hash, which never
+    // matches, so the cache is not used until they can be
+    std::vector<RayCachedDependency> dependencies;
+    for (const auto &textureHash : textureHashes) {
+        RayCachedDependency dependency;
+        memset(&dependency, 0, sizeof(RayCachedDependency));
+        dependency.filename = writer.addString(textureHash.first);
+        memcpy(dependency.hash, textureHash.second.data(),
+               std::min<size_t>(textureHash.second.size(), contentHashLength));
+        dependencies.push_back(dependency);
+    }
+
+    const BVH &bvh = m_rayPrimitives.getBVH();
+    writer.setSection(RaySceneCacheSection::CACHE_LIGHTS, m_lights.data(),
+                      m_lights.size() * sizeof(CS123SceneLightData));
+    writer.setSection(RaySceneCacheSection::CACHE_PRIMITIVES, m_rayPrimitives.getRecords(),
+                      m_rayPrimitives.size() * sizeof(RayPrimitive));
+    writer.setSection(RaySceneCacheSection::CACHE_MATERIALS, materials.data(),
+                      materials.size() * sizeof(RayCachedMaterial));
+    writer.setSection(RaySceneCacheSection::CACHE_BVH_NODES, bvh.getNodes(),
+                      bvh.getNumNodes() * sizeof(BVH::Node));
+    writer.setSection(RaySceneCacheSection::CACHE_BVH_INDICES, bvh.getPrimitiveIndices(),
+                      bvh.getNumPrimitiveIndices() * sizeof(int));
+    writer.setSection(RaySceneCacheSection::CACHE_TEXTURES, textures.data(),
+                      textures.size() * sizeof(RayCachedTexture));
+    writer.setSection(RaySceneCacheSection::CACHE_TEXELS, texels.data(), texels.size() * sizeof(glm::vec4));
+    writer.setSection(RaySceneCacheSection::CACHE_DEPENDENCIES, dependencies.data(),
+                      dependencies.size() * sizeof(RayCachedDependency));
+
+    RaySceneCacheHeader header;
+    memset(&header, 0, sizeof(RaySceneCacheHeader));
+    memcpy(header.sceneHash, sceneHash.data(), std::min<size_t>(sceneHash.size(), contentHashLength));
+    header.global = m_globalData;
+    header.camera = camera;
+    return writer.write(filename, header);
+}
+
+/**
+ *  Decode every texture map once, before rendering starts. Primitives whose materials name
+ *  the same file share one RayTexture.
+ */
+void RayScene::loadTextures() {
+    std::map<std::string, const RayTexture *> texturesByFile;
+    m_primitiveTextures.assign(m_primitives.size(), nullptr);
+    for (int i = 0; i < m_primitives.size() && i < m_textures.size(); i++) {
+        if (m_textures[i].isNull()) {
+            continue;
+        }
+        const std::string &filename = m_primitives[i].material.textureMap.filename;
+        auto cached = texturesByFile.find(filename);
+        if (cached != texturesByFile.end()) {
+            m_primitiveTextures[i] = cached->second;
+            continue;
+        }
+        // 32-bit scanlines are never padded, so the pixels can be read as one array
+        QImage image = m_textures[i].convertToFormat(QImage::Format_ARGB32);
+        m_rayTextures.push_back(std::make_unique<RayTexture>(
+                                    reinterpret_cast<const uint32_t *>(image.constBits()),
+                                    image.width(), image.height()));
+        m_primitiveTextures[i] = m_rayTextures.back().get();
+        texturesByFile[filename] = m_primitiveTextures[i];
+    }
+}
+
+/**
+ *  The statistics the current thread counts into while it renders a tile, or null when they
+ *  are not being collected. Each render worker points this at a RayStats of its own.
+ */
+static thread_local RayStats *threadStats = nullptr;
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Whether lights of a type are switched on */
+static bool isLightEnabled(LightType type) {
+    switch (type) {
+        case LightType::LIGHT_POINT:
+            return settings.usePointLights;
+        case LightType::LIGHT_DIRECTIONAL:
+            return settings.useDirectionalLights;
+        case LightType::LIGHT_SPOT:
+            return settings.useSpotLights;
+        default:
+            return false;
+    }
+}
+
+/**
+ *  A value in [0, 1) that looks random but only depends on a point, so that picking lights
+ *  needs no random state shared between threads and renders are repeatable.
+ */
+static float hashToUnitInterval(glm::vec3 point) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 3; i++) {
+        uint32_t bits;
+        memcpy(&bits, &point[i], sizeof(bits));
+        hash = (hash ^ bits) * 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return (hash >> 8) * (1.f / 16777216.f);
+}
+
+/** Split rows [firstRow, endRow) of an image into tiles at most tileHeight rows high */
+static void addTiles(std::vector<RayTile> &tiles, int width, int firstRow, int endRow, int tileHeight) {
+    for (int y = firstRow; y < endRow; y += tileHeight) {
+        for (int x = 0; x < width; x += rayTileSize) {
+            tiles.push_back({ x, y, std::min(rayTileSize, width - x), std::min(tileHeight, endRow - y) });
+        }
+    }
+}
+
+/**
+ *  Main ray tracing loop. The image is rendered progressively so that a usable picture
+ *  appears quickly and is refined while the user watches:
+ *    1. a preview tracing one ray per previewBlockSize x previewBlockSize block of pixels,
+ *    2. one ray through the center of every pixel,
+ *    3. with super sampling or anti-aliasing on, extra stratified samples for just the pixels
+ *       whose neighbourhood varies a lot after pass 2, i.e. edges and fine texture.
+ *  Targets that are not progressive only receive the final pixels, and skip pass 1. Passes 2
+ *  and 3 are run band by band, with bands as tall as the memory budget allows.
+ *  Rendering can be cancelled between any two tiles of any pass.
  */
-void RayScene::renderRayScene(Canvas2D *canvas, CS123SceneCameraData *camera, int width, int height) {
+void RayScene::renderRayScene(CS123SceneCameraData *camera, RayRenderTarget &target,
+                              const std::function<void()> &onProgress) {
     m_rendering = true;
-    canvas->resize(width, height);
+    m_stats = RayStats();
+    auto renderStart = std::chrono::steady_clock::now();
+    int width = target.getWidth();
+    int height = target.getHeight();
 
     // Convert degrees to radians
-    float aspectRatio = static_cast<float>(canvas->width()) / canvas->height();
-    float heightAngle = camera->heightAngle * PI / 180.0f;
-    float widthAngle = heightAngle * aspectRatio;
+    float aspectRatio = static_cast<float>(width) / height;
+    RayCamera rayCamera;
+    rayCamera.heightAngle = camera->heightAngle * PI / 180.0f;
+    rayCamera.widthAngle = rayCamera.heightAngle * aspectRatio;
+    rayCamera.width = width;
+    rayCamera.height = height;
 
     // Set up camera transformations
-    glm::vec3 cameraPos = glm::vec3(camera->pos);
+    rayCamera.position = glm::vec3(camera->pos);
     glm::mat4 worldToCameraSpace = getCameraMatrix(camera);
-    glm::mat4 cameraToWorldSpace = glm::inverse(worldToCameraSpace);
-    glm::mat3 cameraToWorldSpace3 = glm::mat3(cameraToWorldSpace);
-
-    RGBA* pixels = canvas->data();
-    for (int col = 0; col < width; col++) {
-        for (int row = 0; row < height; row++) {
-            // Check if rendering has been cancelled
-            if (!m_rendering) return;
-            // Reset recursion depth for new pixel
-            m_recursionDepth = 0;
-            // Generate ray through view plane
-            glm::vec3 cameraSpaceDirection = getRayCameraDirection(
-                        widthAngle, heightAngle, width, height, col, row);
-            // Transform to world space and trace ray
-            glm::vec3 worldSpaceDirection = cameraToWorldSpace3 * cameraSpaceDirection;
-            glm::vec4 color = traceRay(Ray(cameraPos, worldSpaceDirection));
-            int redInt = static_cast<int>(color[0] * 255.0f);
-            int greenInt = static_cast<int>(color[1] * 255.0f);
-            int blueInt = static_cast<int>(color[2] * 255.0f);
-            canvas->setPixelColor(pixels, row, col, RGBA(redInt, greenInt, blueInt, 255));
+    rayCamera.cameraToWorld = glm::mat3(glm::inverse(worldToCameraSpace));
+
+    std::vector<CS123SceneLightData> enabledLights;
+    for (const CS123SceneLightData &light : m_lights) {
+        if (isLightEnabled(light.type)) {
+            enabledLights.push_back(light);
+        }
+    }
+    m_rayLights.build(enabledLights);
+
+    if (target.isProgressive()) {
+        auto passStart = std::chrono::steady_clock::now();
+        std::vector<RayTile> tiles;
+        addTiles(tiles, width, 0, height, rayTileSize);
+        renderPass(tiles, [&](const RayTile &tile) {
+            renderPreviewTile(rayCamera, tile, target);
+        }, onProgress);
+        m_stats.previewSeconds += secondsSince(passStart);
+    }
+
+    bool refine = settings.useSuperSampling || settings.useAntiAliasing;
+    int samplesPerSide = settings.useSuperSampling ? std::max(1, settings.numSuperSamples)
+                                                   : antiAliasingSamples;
+    int bandHeight = getBandHeight(width, height);
+    for (int bandStart = 0; bandStart < height && m_rendering; bandStart += bandHeight) {
+        int bandEnd = std::min(height, bandStart + bandHeight);
+        std::vector<RayTile> tiles;
+        addTiles(tiles, width, bandStart, bandEnd, rayTileSize);
+        auto passStart = std::chrono::steady_clock::now();
+        if (!refine) {
+            renderPass(tiles, [&](const RayTile &tile) {
+                renderTile(rayCamera, tile, nullptr, &target);
+            }, onProgress);
+            m_stats.centerSeconds += secondsSince(passStart);
+            continue;
+        }
+
+        // The rows just outside the band are traced again for the neighbourhood of its edge
+        // pixels, but never written to the target
+        RayColorBand band;
+        band.width = width;
+        band.firstRow = std::max(0, bandStart - 1);
+        band.colors.resize(width * (std::min(height, bandEnd + 1) - band.firstRow));
+        std::vector<RayTile> centerTiles = tiles;
+        addTiles(centerTiles, width, band.firstRow, bandStart, 1);
+        addTiles(centerTiles, width, bandEnd, std::min(height, bandEnd + 1), 1);
+        renderPass(centerTiles, [&](const RayTile &tile) {
+            bool inBand = tile.y >= bandStart && tile.y < bandEnd;
+            renderTile(rayCamera, tile, &band, inBand && target.isProgressive() ? &target : nullptr);
+        }, onProgress);
+        m_stats.centerSeconds += secondsSince(passStart);
+        passStart = std::chrono::steady_clock::now();
+        renderPass(tiles, [&](const RayTile &tile) {
+            refineTile(rayCamera, tile, band, samplesPerSide, target);
+        }, onProgress);
+        m_stats.refineSeconds += secondsSince(passStart);
+    }
+    m_stats.renderSeconds = secondsSince(renderStart);
+}
+
+/** Rows per band, a multiple of the tile size, so that a band's colors fit the memory budget */
+int RayScene::getBandHeight(int width, int height) const {
+    if (m_memoryBudget == 0) {
+        return height;
+    }
+    if (m_memoryBudget < getMinimumMemoryBudget(width)) {
+        std::cerr << "memory budget of " << m_memoryBudget << " bytes is below the "
+                  << getMinimumMemoryBudget(width) << " needed for one band of tiles; rendering "
+                  << "in bands of " << rayTileSize << " rows" << std::endl;
+    }
+    size_t bytesPerRow = width * sizeof(glm::vec4);
+    int rows = static_cast<int>(m_memoryBudget / bytesPerRow) - 2;
+    return std::max(rayTileSize, rows / rayTileSize * rayTileSize);
+}
+
+/**
+ *  Render every tile of one pass. Worker threads claim tiles from a shared counter, so faster
+ *  threads simply take more tiles. Workers report each finished tile, and the calling thread
+ *  passes on progress as tiles come in until all are done or rendering is cancelled. When
+ *  statistics are collected, each worker counts into its own RayStats, and they are added to
+ *  the render's once the workers have finished.
+ */
+void RayScene::renderPass(const std::vector<RayTile> &tiles,
+                          const std::function<void(const RayTile &)> &renderTile,
+                          const std::function<void()> &onProgress) {
+    if (!m_rendering) {
+        return;
+    }
+
+    int numThreads = m_numThreads;
+    if (numThreads <= 0) {
+        numThreads = 1;
+        if (settings.useMultiThreading) {
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+    numThreads = std::min(numThreads, static_cast<int>(tiles.size()));
+
+    std::atomic<int> nextTile(0);
+    std::mutex completedMutex;
+    std::condition_variable tileCompleted;
+    int numCompleted = 0;
+
+    std::vector<RayStats> workerStats(numThreads);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < numThreads; i++) {
+        workers.emplace_back([&, i]() {
+            RayStats stats;
+            threadStats = m_collectStats ? &stats : nullptr;
+            while (m_rendering) {
+                int tileIndex = nextTile++;
+                if (tileIndex >= tiles.size()) {
+                    break;
+                }
+                auto tileStart = std::chrono::steady_clock::now();
+                renderTile(tiles[tileIndex]);
+                if (threadStats) {
+                    stats.countTile(secondsSince(tileStart));
+                }
+                {
+                    std::lock_guard<std::mutex> lock(completedMutex);
+                    numCompleted++;
+                }
+                tileCompleted.notify_one();
+            }
+            threadStats = nullptr;
+            workerStats[i] = stats;
+        });
+    }
+
+    // Report progress as tiles complete; the GUI repaints and handles events here, which is
+    // how a render gets cancelled
+    int numShown = 0;
+    while (numShown < tiles.size() && m_rendering) {
+        {
+            std::unique_lock<std::mutex> lock(completedMutex);
+            tileCompleted.wait_for(lock, std::chrono::milliseconds(30),
+                                   [&]() { return numCompleted > numShown; });
+            numShown = numCompleted;
+        }
+        onProgress();
+    }
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (const RayStats &stats : workerStats) {
+        m_stats.add(stats);
+    }
+    onProgress();
+}
+
+/** Trace one ray per block of the tile and fill the whole block with its color */
+void RayScene::renderPreviewTile(const RayCamera &camera, const RayTile &tile, RayRenderTarget &target) {
+    RGBA pixels[rayTileSize * rayTileSize];
+    for (int blockRow = 0; blockRow < tile.height; blockRow += previewBlockSize) {
+        for (int blockCol = 0; blockCol < tile.width; blockCol += previewBlockSize) {
+            int blockWidth = std::min(previewBlockSize, tile.width - blockCol);
+            int blockHeight = std::min(previewBlockSize, tile.height - blockRow);
+            Ray ray = getPrimaryRay(camera, tile.x + blockCol + 0.5f * blockWidth,
+                                    tile.y + blockRow + 0.5f * blockHeight);
+            RGBA color = toRGBA(traceRay(ray));
+            for (int row = blockRow; row < blockRow + blockHeight; row++) {
+                for (int col = blockCol; col < blockCol + blockWidth; col++) {
+                    pixels[row * tile.width + col] = color;
+                }
+            }
         }
-        // Update canvas
-        canvas->update();
-        QCoreApplication::processEvents();
     }
+    target.writeTile(tile, pixels);
 }
 
 /**
- *  Trace a ray, returning the color at the intersection point, or black
- *  if there is no intersection. Recursively computes inter-object reflection by
- *  tracing reflected rays until max recursion depth is reached or no intersection
- *  is found.
+ *  Trace one ray through the center of each pixel of a tile, keeping the colors in the band
+ *  for the refinement pass if there is one, and writing the pixels to the target if given.
+ *  With the BVH enabled, the rays through each 2x2 block of pixels are intersected as one
+ *  packet; shading, and every secondary ray it spawns, is then done one ray at a time.
  */
-glm::vec4 RayScene::traceRay(Ray ray) {
+void RayScene::renderTile(const RayCamera &camera, const RayTile &tile, RayColorBand *band,
+                          RayRenderTarget *target) {
+    RGBA pixels[rayTileSize * rayTileSize];
+    auto store = [&](int col, int row, glm::vec4 color) {
+        if (band) {
+            band->at(col, row) = color;
+        }
+        pixels[(row - tile.y) * tile.width + col - tile.x] = toRGBA(color);
+    };
+
+    if (!settings.useKDTree) {
+        for (int row = tile.y; row < tile.y + tile.height; row++) {
+            for (int col = tile.x; col < tile.x + tile.width; col++) {
+                store(col, row, traceRay(getPrimaryRay(camera, col + 0.5f, row + 0.5f)));
+            }
+        }
+    } else {
+        for (int row = tile.y; row < tile.y + tile.height; row += 2) {
+            for (int col = tile.x; col < tile.x + tile.width; col += 2) {
+                // Blocks hanging off the edge of the tile repeat their first pixel in the missing lanes
+                int blockCols[rayPacketSize];
+                int blockRows[rayPacketSize];
+                Ray rays[rayPacketSize];
+                for (int i = 0; i < rayPacketSize; i++) {
+                    blockCols[i] = col + i % 2;
+                    blockRows[i] = row + i / 2;
+                    if (blockCols[i] >= tile.x + tile.width || blockRows[i] >= tile.y + tile.height) {
+                        blockCols[i] = col;
+                        blockRows[i] = row;
+                    }
+                    rays[i] = getPrimaryRay(camera, blockCols[i] + 0.5f, blockRows[i] + 0.5f);
+                }
+
+                int nearestPrimitive[rayPacketSize];
+                Intersection nearest[rayPacketSize];
+                m_rayPrimitives.closestHit(RayPacket(rays), nearestPrimitive, nearest, threadStats);
+                for (int i = 0; i < rayPacketSize; i++) {
+                    if (i > 0 && blockCols[i] == col && blockRows[i] == row) {
+                        continue;
+                    }
+                    IntersectionWithPrimitive intersection = withPrimitive(nearestPrimitive[i], nearest[i]);
+                    store(blockCols[i], blockRows[i], shadeIntersection(rays[i], intersection));
+                }
+            }
+        }
+    }
+
+    if (target) {
+        target->writeTile(tile, pixels);
+    }
+}
+
+/**
+ *  Supersample the pixels of a tile that need it, averaging a samplesPerSide x samplesPerSide
+ *  stratified grid of rays with the pixel's center sample from the previous pass, and write
+ *  the finished tile to the target.
+ */
+void RayScene::refineTile(const RayCamera &camera, const RayTile &tile, RayColorBand &band,
+                          int samplesPerSide, RayRenderTarget &target) {
+    RGBA pixels[rayTileSize * rayTileSize];
+    float stratumSize = 1.f / samplesPerSide;
+    for (int row = tile.y; row < tile.y + tile.height; row++) {
+        for (int col = tile.x; col < tile.x + tile.width; col++) {
+            glm::vec4 sum = band.at(col, row);
+            int numSamples = 1;
+            if (needsSupersampling(camera, band, col, row)) {
+                for (int sampleRow = 0; sampleRow < samplesPerSide; sampleRow++) {
+                    for (int sampleCol = 0; sampleCol < samplesPerSide; sampleCol++) {
+                        float x = col + (sampleCol + 0.5f) * stratumSize;
+                        float y = row + (sampleRow + 0.5f) * stratumSize;
+                        sum += traceRay(getPrimaryRay(camera, x, y));
+                    }
+                }
+                numSamples += samplesPerSide * samplesPerSide;
+            }
+            pixels[(row - tile.y) * tile.width + col - tile.x] = toRGBA(sum / static_cast<float>(numSamples));
+        }
+    }
+    target.writeTile(tile, pixels);
+}
+
+/** Whether the luminance of the 3x3 neighbourhood of a pixel varies enough to supersample it */
+bool RayScene::needsSupersampling(const RayCamera &camera, RayColorBand &band, int col, int row) {
+    const glm::vec3 luminanceWeights = glm::vec3(0.299f, 0.587f, 0.114f);
+    float sum = 0.f;
+    float sumOfSquares = 0.f;
+    int count = 0;
+    int lastRow = std::min(camera.height - 1, row + 1);
+    int lastCol = std::min(camera.width - 1, col + 1);
+    for (int neighborRow = std::max(0, row - 1); neighborRow <= lastRow; neighborRow++) {
+        for (int neighborCol = std::max(0, col - 1); neighborCol <= lastCol; neighborCol++) {
+            float luminance = glm::dot(glm::vec3(band.at(neighborCol, neighborRow)), luminanceWeights);
+            sum += luminance;
+            sumOfSquares += luminance * luminance;
+            count++;
+        }
+    }
+    float mean = sum / count;
+    return sumOfSquares / count - mean * mean > adaptiveVarianceThreshold;
+}
+
+/** World space ray from the camera through a point on the image, in pixel coordinates */
+Ray RayScene::getPrimaryRay(const RayCamera &camera, float x, float y) {
+    // Generate ray through view plane
+    glm::vec3 cameraSpaceDirection = getRayCameraDirection(
+                camera.widthAngle, camera.heightAngle, camera.width, camera.height, x, y);
+    // Transform to world space
+    glm::vec3 worldSpaceDirection = camera.cameraToWorld * cameraSpaceDirection;
+    return Ray(camera.position, worldSpaceDirection);
+}
+
+/** Convert a color with [0, 1] channels to an opaque image pixel */
+RGBA RayScene::toRGBA(glm::vec4 color) {
+    int redInt = static_cast<int>(color[0] * 255.0f);
+    int greenInt = static_cast<int>(color[1] * 255.0f);
+    int blueInt = static_cast<int>(color[2] * 255.0f);
+    return RGBA(redInt, greenInt, blueInt, 255);
+}
+
+/** Trace a ray, returning the color seen along it, or black if there is no intersection */
+glm::vec4 RayScene::traceRay(const Ray &ray) {
     // Find and store the nearest intersection with a primitive object
     IntersectionWithPrimitive nearestIntersection = rayObjectIntersection(ray);
+    return shadeIntersection(ray, nearestIntersection);
+}
+
+/**
+ *  Color seen along a ray whose nearest intersection has already been found, including
+ *  mirror reflections and, for transparent materials, refraction. Transparent hits split the
+ *  light between a reflected and a refracted ray by the Fresnel reflectance. The resulting
+ *  tree of rays is followed with an explicit stack: each hit is shaded once into a node, and
+ *  a secondary ray is only traced while its throughput is above minRayContribution, its
+ *  path has fewer than maxRecursionDepth bounces, and the tree has room. The nodes are then
+ *  folded from the last back to the first, clamping at every hit as a recursive tracer would.
+ */
+glm::vec4 RayScene::shadeIntersection(const Ray &ray, const IntersectionWithPrimitive &nearestIntersection) {
+    if (threadStats) {
+        threadStats->countRay(RayType::RAY_PRIMARY, nearestIntersection.t >= EPSILON);
+    }
     // If no valid intersection, return black
     if (nearestIntersection.t < EPSILON) {
         return glm::vec4(0.f);
     }
-    // Otherwise, recursively compute color at intersection point
-    else {
-        int primitiveIndex = nearestIntersection.primitiveIndex;
-        glm::vec3 objectSpacePos = nearestIntersection.objectSpacePos;
-        // Transform object-space normal to world-space
-        glm::vec3 objectSpaceNormal = nearestIntersection.objectSpaceNormal;
-        glm::mat4 ctm = m_matrices[primitiveIndex];
-        glm::mat3 inverseCtm3 = glm::inverse(glm::mat3(ctm));
-        glm::mat3 normalToWorldSpace = glm::transpose(inverseCtm3);
-        glm::vec3 worldSpaceNormal = glm::normalize(normalToWorldSpace * objectSpaceNormal);
-        // Transform intersection point to world-space
-        glm::vec3 worldSpacePos = glm::vec3(ctm * glm::vec4(objectSpacePos, 1.0f));
+
+    RayTreeNode nodes[maxRayTreeSize];
+    // Every node adds at most two rays
+    RaySecondary pending[2 * maxRayTreeSize + 1];
+    int numNodes = 0;
+    int numPending = 0;
+    pending[numPending++] = { ray, -1, glm::vec3(1.f), glm::vec3(1.f), 0, RayType::RAY_PRIMARY };
+
+    while (numPending > 0 && numNodes < maxRayTreeSize) {
+        RaySecondary current = pending[--numPending];
+        // The camera ray's hit is already known
+        IntersectionWithPrimitive intersection = numNodes == 0 ? nearestIntersection
+                                                               : rayObjectIntersection(current.ray);
+        if (threadStats && numNodes > 0) {
+            threadStats->countRay(current.type, intersection.t >= EPSILON);
+        }
+        if (intersection.t < EPSILON) {
+            continue;
+        }
+
+        const RayPrimitive &record = m_rayPrimitives[intersection.primitiveIndex];
+        // Transform object-space normal and intersection point to world-space
+        glm::vec3 worldSpaceNormal = glm::normalize(record.normalMatrix * intersection.objectSpaceNormal);
+        glm::vec3 worldSpacePos = glm::vec3(record.objectToWorld * glm::vec4(intersection.objectSpacePos, 1.0f));
         // Get texture color from texture map and UV
-        CS123SceneMaterial material = m_primitives[primitiveIndex].material;
+        const CS123SceneMaterial &material = m_primitives[record.materialIndex].material;
         glm::vec4 textureColor;
-        QImage texture = m_textures[primitiveIndex];
-        if (!texture.isNull()) {
-            textureColor = getTextureColor(texture, material.textureMap,
-                                           nearestIntersection.uv);
+        const RayTexture *texture = m_primitiveTextures[record.materialIndex];
+        if (texture && settings.useTextureMapping) {
+            textureColor = getTextureColor(*texture, material.textureMap, intersection.uv);
         } else {
             textureColor = glm::vec4(0.f);
         }
-        // Compute recursive reflections
-        glm::vec4 reflectedColor = glm::vec4(0);
-        glm::vec3 eye = ray.startPoint;
+
+        int nodeIndex = numNodes++;
+        RayTreeNode &node = nodes[nodeIndex];
+        node.localColor = lightingEquation(worldSpacePos, worldSpaceNormal, material,
+                                           current.ray.startPoint, textureColor);
+        node.childColor = glm::vec3(0.f);
+        node.weight = current.weight;
+        node.parent = current.parent;
+        if (current.depth >= maxRecursionDepth) {
+            continue;
+        }
+
+        glm::vec3 reflectedWeight = glm::vec3(0.f);
         if (settings.useReflection) {
-            Ray reflectedRay = Ray(worldSpacePos,
-                                   glm::reflect(ray.direction, worldSpaceNormal));
-            // Check whether this point will contribute non-negligible reflectance
-            glm::vec4 maxPossibleReflection = lightingEquation(worldSpacePos,
-                                                               worldSpaceNormal,
-                                                               material,
-                                                               eye, textureColor,
-                                                               glm::vec4(1, 1, 1, 1));
-            bool significantReflectance =
-                    glm::length(glm::vec3(maxPossibleReflection)) > minReflectedContribution;
-            if (significantReflectance && m_recursionDepth < maxRecursionDepth) {
-                m_recursionDepth++;
-                reflectedColor = traceRay(reflectedRay);
+            reflectedWeight = m_globalData.ks * glm::vec3(material.cReflective);
+        }
+        glm::vec3 refractedWeight = glm::vec3(0.f);
+        glm::vec3 refractedDirection = current.ray.direction;
+        glm::vec3 transparency = m_globalData.kt * glm::vec3(material.cTransparent);
+        if (settings.useRefraction && glm::length(transparency) > 0.f) {
+            float reflectance = refractFresnel(current.ray.direction, worldSpaceNormal, material.ior,
+                                               refractedDirection);
+            reflectedWeight += reflectance * transparency;
+            refractedWeight = (1.f - reflectance) * transparency;
+        }
+
+        auto followRay = [&](const Ray &secondaryRay, glm::vec3 weight, RayType type) {
+            glm::vec3 throughput = current.throughput * weight;
+            if (glm::length(throughput) > minRayContribution) {
+                pending[numPending++] = { secondaryRay, nodeIndex, weight, throughput, current.depth + 1, type };
             }
+        };
+        Ray reflectedRay = Ray(worldSpacePos, glm::reflect(current.ray.direction, worldSpaceNormal));
+        Ray refractedRay = Ray(worldSpacePos, refractedDirection);
+        // Push the weaker ray first, so the stronger one is traced first if the tree fills up
+        if (glm::length(reflectedWeight) < glm::length(refractedWeight)) {
+            followRay(reflectedRay, reflectedWeight, RayType::RAY_REFLECTION);
+            followRay(refractedRay, refractedWeight, RayType::RAY_REFRACTION);
+        } else {
+            followRay(refractedRay, refractedWeight, RayType::RAY_REFRACTION);
+            followRay(reflectedRay, reflectedWeight, RayType::RAY_REFLECTION);
         }
-        // Finally, compute color from lighting equation
-        return lightingEquation(worldSpacePos, worldSpaceNormal, material,
-                                     eye, textureColor, reflectedColor);
     }
+
+    // Children always come after their parent, so this visits them first
+    for (int i = numNodes - 1; i > 0; i--) {
+        glm::vec3 color = glm::min(nodes[i].localColor + nodes[i].childColor, glm::vec3(1.f));
+        nodes[nodes[i].parent].childColor += nodes[i].weight * color;
+    }
+    return glm::vec4(glm::min(nodes[0].localColor + nodes[0].childColor, glm::vec3(1.f)), 1.f);
 }
 
 /**
- *  For each primitive, check if the ray intersects it. Return an Intersection containing
- *  the t-value of the closest intersected object.
+ *  Find the nearest primitive the ray hits. With settings.useKDTree the BVH is traversed,
+ *  otherwise every primitive is tested. Returns an intersection with t = -1 on a miss.
  */
 IntersectionWithPrimitive RayScene::rayObjectIntersection(Ray ray) {
-    std::vector<IntersectionWithPrimitive> intersections;
-    for (int i = 0; i < m_primitives.size(); i++) {
-        // Cumulative transformation matrix
-        glm::mat4 ctm = m_matrices[i];
-        glm::mat4 inverseCtm = glm::inverse(ctm);
-        // Convert to object space using inverse of the CTM
-        glm::vec3 objectSpaceDirection = glm::mat3(inverseCtm) * ray.direction;
-        glm::vec3 objectSpaceEye = glm::vec3(inverseCtm * glm::vec4(ray.startPoint, 1.0f));
-        Ray objectSpaceRay = Ray(objectSpaceEye, objectSpaceDirection);
-        // Check for intersection
-        CS123ScenePrimitive primitive = m_primitives[i];
-        if (primitive.type == PrimitiveType::PRIMITIVE_CYLINDER) {
-            Intersection intersection = m_implicitCylinder->intersect(objectSpaceRay);
-            UV uv = m_implicitCylinder->mapToUV(intersection.objectSpacePos);
-            intersections.push_back(IntersectionWithPrimitive(intersection, i, uv));
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_CONE) {
-            Intersection intersection = m_implicitCone->intersect(objectSpaceRay);
-            UV uv = m_implicitCone->mapToUV(intersection.objectSpacePos);
-            intersections.push_back(IntersectionWithPrimitive(intersection, i, uv));
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_CUBE) {
-            Intersection intersection = m_implicitCube->intersect(objectSpaceRay);
-            UV uv = m_implicitCube->mapToUV(intersection.objectSpacePos);
-            intersections.push_back(IntersectionWithPrimitive(intersection, i, uv));
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_SPHERE) {
-            Intersection intersection = m_implicitSphere->intersect(objectSpaceRay);
-            UV uv = m_implicitSphere->mapToUV(intersection.objectSpacePos);
-            intersections.push_back(IntersectionWithPrimitive(intersection, i, uv));
-        }
+    Intersection nearestIntersection;
+    int nearestPrimitive = m_rayPrimitives.closestHit(ray, settings.useKDTree, nearestIntersection,
+                                                      threadStats);
+    return withPrimitive(nearestPrimitive, nearestIntersection);
+}
+
+/** Attach the primitive index and texture coordinates to a nearest hit, or -1 for a miss */
+IntersectionWithPrimitive RayScene::withPrimitive(int primitiveIndex, const Intersection &intersection) {
+    if (primitiveIndex < 0) {
+        return IntersectionWithPrimitive();
     }
-    IntersectionWithPrimitive nearestIntersection =
-            m_implicitShape->nearestIntersectionWithPrimitive(intersections);
-    return nearestIntersection;
+    // Only the nearest hit is ever shaded, so only it needs texture coordinates
+    UV uv = m_rayPrimitives.mapToUV(primitiveIndex, intersection.objectSpacePos);
+    return IntersectionWithPrimitive(intersection, primitiveIndex, uv);
 }
 
 /**
- *  Compute color at point of intersection based on Phong illumination model.
- *  Uses scene lights, global data, object material, and normal vector at intersection.
+ *  Compute the color at a point of intersection based on the Phong illumination model,
+ *  apart from reflections, which the caller adds. Uses scene lights, global data, object
+ *  material, and normal vector at intersection. All three channels are computed together,
+ *  so each light's shadow ray and dot products are evaluated once per hit. Only the lights
+ *  that reach the point are shaded, at most maxShadedLights of them. Not clamped.
  */
-glm::vec4 RayScene::lightingEquation(glm::vec3 intersectionPoint,
+glm::vec3 RayScene::lightingEquation(glm::vec3 intersectionPoint,
                                      glm::vec3 normal,
-                                     CS123SceneMaterial objectMaterial,
+                                     const CS123SceneMaterial &objectMaterial,
                                      glm::vec3 eye,
-                                     glm::vec4 textureColor,
-                                     glm::vec4 reflectedColor) {
-    float red = lightingEquationForChannel(intersectionPoint, normal, objectMaterial,
-                                 eye, textureColor, reflectedColor, 0);
-    float green = lightingEquationForChannel(intersectionPoint, normal, objectMaterial,
-                                 eye, textureColor, reflectedColor, 1);
-    float blue = lightingEquationForChannel(intersectionPoint, normal, objectMaterial,
-                                 eye, textureColor, reflectedColor, 2);
-    return glm::vec4(red, green, blue, 1.f);
-}
+                                     glm::vec4 textureColor) {
+    glm::vec3 lineOfSight = glm::normalize(eye - intersectionPoint);
 
-/**
- *  Compute intensity in [0,1] for a given RGB channel at point of intersection.
- *  Uses scene lights, global data, object material, and normal vector at intersection.
- *  Based on Phong illumination model.
- */
-float RayScene::lightingEquationForChannel(
-        glm::vec3 intersectionPoint,
-        glm::vec3 normal,
-        CS123SceneMaterial objectMaterial,
-        glm::vec3 eye,
-        glm::vec4 textureColor,
-        glm::vec4 reflectedColor,
-        int channelIndex)
-{
     // Sum diffuse + specular contribution for all lights
-    float totalLightIntensity = 0;
-    for (int i = 0; i < m_lights.size(); i++) {
-        CS123SceneLightData light = m_lights[i];
-        float contribution = getLightContribution(light, intersectionPoint, normal,
-                                                  objectMaterial, eye, textureColor, channelIndex);
-        totalLightIntensity = totalLightIntensity + contribution;
+    RayLightSample lights[maxShadedLights];
+    int numLights = m_rayLights.gatherLights(intersectionPoint, hashToUnitInterval(intersectionPoint), lights);
+    glm::vec3 totalLightIntensity = glm::vec3(0.f);
+    for (int i = 0; i < numLights; i++) {
+        totalLightIntensity += getLightContribution(lights[i], intersectionPoint, normal,
+                                                    objectMaterial, lineOfSight, textureColor);
     }
 
-    // Ambient intensity in [0, 1] for this channel
-    float objectAmbient = objectMaterial.cAmbient[channelIndex];
+    // Ambient intensity in [0, 1]
+    glm::vec3 objectAmbient = glm::vec3(objectMaterial.cAmbient);
     // Global ambient coefficient
     float ka = m_globalData.ka;
-    // Object reflective intensity in [0, 1] for this channel
-    float objectReflective = objectMaterial.cReflective[channelIndex];
-    // Global specular coefficient
-    float ks = m_globalData.ks;
-    // Get reflective contribution
-    float reflectiveContribution = ks * objectReflective * reflectedColor[channelIndex];
-    // Compute overall lighting
-    float computedLighting = ka * objectAmbient
-            + totalLightIntensity + reflectiveContribution;
-    return std::min(computedLighting, 1.f);
+    return ka * objectAmbient + totalLightIntensity;
 }
 
 /**
- *  Gets the contribution (diffuse + specular) of a single light in a scene.
- *  Adds attenuation for point lights.
+ *  Gets the RGB contribution (diffuse + specular) of a single light in a scene. The sample
+ *  already carries the light's attenuation and spot falloff.
  */
-float RayScene::getLightContribution(
-        CS123SceneLightData light,
+glm::vec3 RayScene::getLightContribution(
+        const RayLightSample &light,
         glm::vec3 intersectionPoint,
         glm::vec3 normal,
-        CS123SceneMaterial objectMaterial,
-        glm::vec3 eye,
-        glm::vec4 textureColor,
-        int channelIndex)
+        const CS123SceneMaterial &objectMaterial,
+        glm::vec3 lineOfSight,
+        glm::vec4 textureColor)
 {
     // Global diffuse coefficient
     float kd = m_globalData.kd;
     // Global specular coefficient
     float ks = m_globalData.ks;
-    // Diffuse intensity in [0, 1] for this channel
-    float objectDiffuse = objectMaterial.cDiffuse[channelIndex];
-    // Specular intensity in [0, 1] for this channel
-    float objectSpecular = objectMaterial.cSpecular[channelIndex];
-
-    glm::vec3 surfaceToLight;
-    float attenuation = 1.0f;
-    if (light.type == LightType::LIGHT_POINT && settings.usePointLights) {
-        surfaceToLight = glm::normalize(glm::vec3(light.pos) - intersectionPoint);
-        // Compute attenuation for point lights
-        glm::vec3 attenuationFunc = light.function;
-        float constantAtt = attenuationFunc[0];
-        float linearAtt = attenuationFunc[1];
-        float quadraticAtt = attenuationFunc[2];
-        float distToLight = glm::distance(intersectionPoint, glm::vec3(light.pos));
-        float rawAttenuation = 1.0f /
-                (constantAtt + linearAtt * distToLight + quadraticAtt * distToLight * distToLight);
-        attenuation = std::min(rawAttenuation, 1.0f);
-    } else if (light.type == LightType::LIGHT_DIRECTIONAL && settings.useDirectionalLights) {
-        surfaceToLight = glm::normalize(-1.0f * glm::vec3(light.dir));
-    } else {
-        // No contribution from light types we don't handle
-        return 0.f;
-    }
+    // Diffuse intensity in [0, 1]
+    glm::vec3 objectDiffuse = glm::vec3(objectMaterial.cDiffuse);
+    // Specular intensity in [0, 1]
+    glm::vec3 objectSpecular = glm::vec3(objectMaterial.cSpecular);
+
+    glm::vec3 surfaceToLight = light.surfaceToLight;
 
     // Check if surface point is in shadow, return 0 contribution if so
     Ray shadowRay = Ray(intersectionPoint, surfaceToLight);
-    if (isInShadow(shadowRay, light)) {
-        return 0.f;
+    if (isInShadow(shadowRay, light.distance)) {
+        return glm::vec3(0.f);
     }
 
     // Dot product for diffuse lighting calculation
@@ -285,15 +799,14 @@ float RayScene::getLightContribution(
     // Dot product for specular lighting calculation
     glm::vec3 reflectedPointToLight =
             glm::normalize(2.0f * normal * glm::dot(normal, surfaceToLight) - surfaceToLight);
-    glm::vec3 lineOfSight = glm::normalize(eye - intersectionPoint);
     float reflectionDotLineOfSight = glm::dot(reflectedPointToLight, lineOfSight);
 
     // Add diffuse and specular contributions
-    float contribution = 0;
+    glm::vec3 contribution = glm::vec3(0.f);
     // If dot product is negative, the angle between the light and the normal is
     // greater than 90. These checks prevent adding negative light contributions.
     if (normalDotLight > EPSILON) {
-        float diffuseColor = kd * objectDiffuse;
+        glm::vec3 diffuseColor = kd * objectDiffuse;
         // Blend diffuse color with texture color if enabled
         float blend;
         if (settings.useTextureMapping) {
@@ -301,49 +814,35 @@ float RayScene::getLightContribution(
         } else {
             blend = 0.f;
         }
-        float textureIntensity = textureColor[channelIndex];
-        float diffuseTextureBlend = blend * textureIntensity + (1.f - blend) * diffuseColor;
-        contribution = contribution + diffuseTextureBlend * normalDotLight;
+        glm::vec3 diffuseTextureBlend = blend * glm::vec3(textureColor) + (1.f - blend) * diffuseColor;
+        contribution += diffuseTextureBlend * normalDotLight;
     }
     if (reflectionDotLineOfSight > EPSILON) {
         float shininess = objectMaterial.shininess;
-        float specularContribution = ks * objectSpecular *
-                std::pow(reflectionDotLineOfSight, shininess);
-        contribution = contribution + specularContribution;
+        contribution += ks * objectSpecular * std::pow(reflectionDotLineOfSight, shininess);
     }
 
-    float lightIntensity = light.color[channelIndex];
-    return attenuation * lightIntensity * contribution;
+    return light.intensity * contribution;
 }
 
 /** Convert unit-square (u, v) coords into texture image coords and return resulting color */
-glm::vec4 RayScene::getTextureColor(const QImage &texture, const CS123SceneFileMap &map, const UV &uv) {
-    float u = uv.u;
-    float v = uv.v;
-    float repeatU = map.repeatU;
-    float repeatV = map.repeatV;
-    int width = texture.width();
-    int height = texture.height();
-    int horizCoord = static_cast<int>(u * repeatU * width) % width;
-    int vertCoord = static_cast<int>(v * repeatV * height) % height;
-    QRgb color = texture.pixel(horizCoord, vertCoord);
-    float red = qRed(color) / 255.0f;
-    float green = qGreen(color) / 255.0f;
-    float blue = qBlue(color) / 255.0f;
-    return glm::vec4(red, green, blue, 1.0f);
+glm::vec4 RayScene::getTextureColor(const RayTexture &texture, const CS123SceneFileMap &map,
+                                    const UV &uv) {
+    return texture.sample(uv.u * map.repeatU, uv.v * map.repeatV);
 }
 
 /**
- *  Get direction of ray through pixel in camera coordinate space,
+ *  Get direction of ray through a point on the image, given in pixel coordinates (so the
+ *  center of pixel (col, row) is (col + 0.5, row + 0.5)), in camera coordinate space,
  *  i.e. when (u, v, w) camera space is coincident with (x, y, z) world space
  */
 glm::vec3 RayScene::getRayCameraDirection(float widthAngle, float heightAngle,
-                                          int width, int height, int col, int row) {
-    float x = (col + 0.5f) / width - 0.5f;
-    float y = 0.5f - (row + 0.5f) / height;
+                                          int width, int height, float x, float y) {
+    float viewX = x / width - 0.5f;
+    float viewY = 0.5f - y / height;
     float U = 2 * m_viewPlaneDepth * tan(widthAngle / 2.0f);
     float V = 2 * m_viewPlaneDepth * tan(heightAngle / 2.0f);
-    glm::vec3 viewPlanePoint = glm::vec3(U * x, V * y, -m_viewPlaneDepth);
+    glm::vec3 viewPlanePoint = glm::vec3(U * viewX, V * viewY, -m_viewPlaneDepth);
     return glm::normalize(viewPlanePoint);
 }
 
@@ -360,29 +859,44 @@ glm::mat4 RayScene::getCameraMatrix(CS123SceneCameraData *camera) {
     return rotateMatrix * translateMatrix;
 }
 
-/** Return whether the surface point given by the shadow ray is in shadow */
-bool RayScene::isInShadow(Ray shadowRay, CS123SceneLightData light) {
+/**
+ *  Return whether the surface point given by the shadow ray is in shadow. Only asks whether
+ *  anything lies between the point and the light, which can stop at the first blocker found.
+ *  For point and spot lights only objects on the way to the light occlude the surface; for
+ *  directional lights, at an infinite distance, any object along the shadow ray does.
+ */
+bool RayScene::isInShadow(const Ray &shadowRay, float distanceToLight) {
     if (!settings.useShadows) {
         return false;
     }
-    float shadowRayTVal = rayObjectIntersection(shadowRay).t;
-    if (light.type == LightType::LIGHT_POINT && settings.usePointLights) {
-        float distanceToLight = glm::distance(shadowRay.startPoint, glm::vec3(light.pos));
-        // For point lights, if shadow ray intersects an object on the way to the light,
-        // the surface is occluded
-        if (shadowRayTVal > EPSILON && shadowRayTVal < distanceToLight) {
-            return true;
-        }
-    } else if (light.type == LightType::LIGHT_DIRECTIONAL && settings.useDirectionalLights) {
-        // For directional lights, if shadow ray intersects any object, the surface is occluded
-        if (shadowRayTVal > EPSILON) {
-            return true;
-        }
+    bool isOccluded = m_rayPrimitives.anyHit(shadowRay, distanceToLight, settings.useKDTree, threadStats);
+    if (threadStats) {
+        threadStats->countRay(RayType::RAY_SHADOW, isOccluded);
     }
-    return false;
+    return isOccluded;
 }
 
 /** Stop the currently executing render */
 void RayScene::stopRendering() {
     m_rendering = false;
 }
+
+void RayScene::setNumThreads(int numThreads) {
+    m_numThreads = numThreads;
+}
+
+void RayScene::setMemoryBudget(size_t bytes) {
+    m_memoryBudget = bytes;
+}
+
+size_t RayScene::getMinimumMemoryBudget(int width) {
+    return (rayTileSize + 2) * static_cast<size_t>(width) * sizeof(glm::vec4);
+}
+
+void RayScene::setCollectStats(bool collectStats) {
+    m_collectStats = collectStats;
+}
+
+const RayStats &RayScene::getStats() const {
+    return m_stats;
+}
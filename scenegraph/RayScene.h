@@ -2,27 +2,96 @@
 #define RAYSCENE_H
 
 #include "Scene.h"
-#include "Canvas2D.h"
+#include "RGBA.h"
 #include "RayGeometry.h"
-#include "ImplicitShape.h"
-#include "ImplicitSphere.h"
-#include "ImplicitCylinder.h"
-#include "ImplicitCone.h"
-#include "ImplicitCube.h"
+#include "RayLights.h"
+#include "RayPrimitives.h"
+#include "RayRenderTarget.h"
+#include "RaySceneCache.h"
+#include "RayStats.h"
+#include "RayTexture.h"
 
 
+#include <atomic>
+#include <functional>
 #include <vector>
 
 
-/** The maximum amount of times to recur when computing object reflection */
+/** The maximum number of reflections and refractions along any one path from the camera */
 const int maxRecursionDepth = 10;
 
 /**
- *  Given a glm::vec3 color vector for the maximum possible reflective
- *  contribution from a point, the norm of the vector must be greater than
- *  this value is order to continue recursion.
+ *  A reflected or refracted ray is only followed while the norm of the product of the RGB
+ *  weights of every hit on its path, i.e. how much of its color can still reach the eye, is
+ *  greater than this value.
  */
-const float minReflectedContribution = 0.01;
+const float minRayContribution = 0.01;
+
+/**
+ *  The most hits shaded for one camera ray. Transparent surfaces split each path in two, so
+ *  this bounds the work per pixel however the weights fall; a mirror-only path of
+ *  maxRecursionDepth bounces always fits.
+ */
+const int maxRayTreeSize = 32;
+
+/** Width and height in pixels of the square tiles the image is split into for rendering */
+const int rayTileSize = 32;
+
+/** The preview pass traces one ray per square block of this many pixels on a side */
+const int previewBlockSize = 4;
+
+/**
+ *  Pixels whose 3x3 neighbourhood has a luminance variance above this after the first full
+ *  resolution pass are supersampled; flat regions keep their single sample.
+ */
+const float adaptiveVarianceThreshold = 0.001f;
+
+/** sqrt(samples) per refined pixel when anti-aliasing without super sampling enabled */
+const int antiAliasingSamples = 2;
+
+/** Camera setup shared by every tile of one render */
+struct RayCamera {
+    glm::vec3 position;
+    glm::mat3 cameraToWorld;
+    float widthAngle;
+    float heightAngle;
+    int width;
+    int height;
+};
+
+/** A shaded hit in the tree of rays followed from one camera ray */
+struct RayTreeNode {
+    // Ambient and direct light at the hit
+    glm::vec3 localColor;
+    // Sum of the weighted colors of the hits its reflected and refracted rays found
+    glm::vec3 childColor;
+    // Fraction of this hit's color that reaches the parent's, per channel
+    glm::vec3 weight;
+    int parent;
+};
+
+/** A reflected or refracted ray waiting to be traced */
+struct RaySecondary {
+    Ray ray;
+    int parent;
+    glm::vec3 weight;
+    // Product of the weights from the camera to this ray
+    glm::vec3 throughput;
+    int depth;
+    RayType type;
+};
+
+/**
+ *  Center sample colors of a band of image rows, kept for the refinement pass. Refining a
+ *  pixel looks at its neighbours, so the band extends one row past the rows being refined.
+ */
+struct RayColorBand {
+    int width;
+    int firstRow;
+    std::vector<glm::vec4> colors;
+
+    glm::vec4 &at(int col, int row) { return colors[(row - firstRow) * width + col]; }
+};
 
 
 /**
@@ -33,55 +102,94 @@ const float minReflectedContribution = 0.01;
 class RayScene : public Scene {
 public:
     RayScene(Scene &scene);
+    // A scene read from a cache written by writeCache, which it renders from in place
+    RayScene(std::shared_ptr<const RaySceneCache> cache);
     virtual ~RayScene();
-    void renderRayScene(Canvas2D *canvas, CS123SceneCameraData *camera, int width, int height);
+    // Saves everything built from the scene file, and the camera to render it with, to a cache
+    // for the scene with sceneHash. Scenes with a heightfield cannot be cached.
+    bool writeCache(const std::string &filename, const std::string &sceneHash,
+                    const CS123SceneCameraData &camera) const;
+    // Renders an image the size of the target into it. onProgress is called on the calling
+    // thread whenever tiles have completed, e.g. to repaint.
+    void renderRayScene(CS123SceneCameraData *camera, RayRenderTarget &target,
+                        const std::function<void()> &onProgress);
     void stopRendering();
+    // Number of worker threads to render with; 0 uses settings.useMultiThreading
+    void setNumThreads(int numThreads);
+    // Bytes the renderer may use for its own per-pixel state, or 0 for no limit. Larger images
+    // are rendered in bands of rows that each fit.
+    void setMemoryBudget(size_t bytes);
+    // The smallest budget an image of the given width fits in: one row of tiles, plus the row
+    // above and below it
+    static size_t getMinimumMemoryBudget(int width);
+    // Whether to count rays, BVH nodes and primitive tests and time every tile and pass. Off
+    // by default; counting costs a little time on every ray.
+    void setCollectStats(bool collectStats);
+    // Statistics of the last render, if they were collected
+    const RayStats &getStats() const;
 private:
-    // Implicit shape definitions
-    std::unique_ptr<ImplicitShape> m_implicitShape;
-    std::unique_ptr<ImplicitSphere> m_implicitSphere;
-    std::unique_ptr<ImplicitCylinder> m_implicitCylinder;
-    std::unique_ptr<ImplicitCone> m_implicitCone;
-    std::unique_ptr<ImplicitCube> m_implicitCube;
+    // Per-primitive transforms and bounds, baked once per scene
+    RayPrimitiveTable m_rayPrimitives;
+    // The lights of the enabled types, baked at the start of every render
+    RayLightTable m_rayLights;
+
+    // The cache the primitives, BVH and textures are mapped from, if the scene came from one
+    std::shared_ptr<const RaySceneCache> m_cache;
+
+    // Texture maps decoded once per scene, and the one each primitive uses or null
+    std::vector<std::unique_ptr<RayTexture>> m_rayTextures;
+    std::vector<const RayTexture *> m_primitiveTextures;
+    void loadTextures();
 
     // Primary ray generation
     float m_viewPlaneDepth;
     glm::vec3 getRayCameraDirection(float widthAngle, float heightAngle,
-                                    int width, int height, int col, int row);
+                                    int width, int height, float x, float y);
+    Ray getPrimaryRay(const RayCamera &camera, float x, float y);
+
+    // Progressive rendering. Each pass is split into tiles, which are safe to render from
+    // several threads at once.
+    void renderPass(const std::vector<RayTile> &tiles,
+                    const std::function<void(const RayTile &)> &renderTile,
+                    const std::function<void()> &onProgress);
+    void renderPreviewTile(const RayCamera &camera, const RayTile &tile, RayRenderTarget &target);
+    void renderTile(const RayCamera &camera, const RayTile &tile, RayColorBand *band,
+                    RayRenderTarget *target);
+    void refineTile(const RayCamera &camera, const RayTile &tile, RayColorBand &band,
+                    int samplesPerSide, RayRenderTarget &target);
+    bool needsSupersampling(const RayCamera &camera, RayColorBand &band, int col, int row);
+    int getBandHeight(int width, int height) const;
+    RGBA toRGBA(glm::vec4 color);
 
     // Ray-object intersection
     IntersectionWithPrimitive rayObjectIntersection(Ray ray);
+    IntersectionWithPrimitive withPrimitive(int primitiveIndex, const Intersection &intersection);
     glm::mat4 getCameraMatrix(CS123SceneCameraData *camera);
 
     // Lighting computation and texture mapping
-    glm::vec4 traceRay(Ray ray);
-    glm::vec4 lightingEquation(glm::vec3 intersectionPoint,
-                           glm::vec3 normal,
-                           CS123SceneMaterial objectMaterial,
-                           glm::vec3 eye,
-                           glm::vec4 textureColor,
-                           glm::vec4 reflectedColor);
-    float lightingEquationForChannel(glm::vec3 intersectionPoint,
+    glm::vec4 traceRay(const Ray &ray);
+    glm::vec4 shadeIntersection(const Ray &ray, const IntersectionWithPrimitive &nearestIntersection);
+    glm::vec3 lightingEquation(glm::vec3 intersectionPoint,
                            glm::vec3 normal,
-                           CS123SceneMaterial objectMaterial,
+                           const CS123SceneMaterial &objectMaterial,
                            glm::vec3 eye,
-                           glm::vec4 textureColor,
-                           glm::vec4 reflectedColor,
-                           int channelIndex);
-    float getLightContribution(CS123SceneLightData light,
-                               glm::vec3 intersectionPoint,
-                               glm::vec3 normal,
-                               CS123SceneMaterial objectMaterial,
-                               glm::vec3 eye,
-                               glm::vec4 textureColor,
-                               int channelIndex);
-    glm::vec4 getTextureColor(const QImage &texture,
+                           glm::vec4 textureColor);
+    glm::vec3 getLightContribution(const RayLightSample &light,
+                                   glm::vec3 intersectionPoint,
+                                   glm::vec3 normal,
+                                   const CS123SceneMaterial &objectMaterial,
+                                   glm::vec3 lineOfSight,
+                                   glm::vec4 textureColor);
+    glm::vec4 getTextureColor(const RayTexture &texture,
                               const CS123SceneFileMap &map, const UV &uv);
-    bool isInShadow(Ray shadowRay, CS123SceneLightData light);
+    bool isInShadow(const Ray &shadowRay, float distanceToLight);
 
     // State variables
-    bool m_rendering;
-    int m_recursionDepth;
+    std::atomic<bool> m_rendering;
+    int m_numThreads;
+    size_t m_memoryBudget;
+    bool m_collectStats;
+    RayStats m_stats;
 };
 
 #endif // RAYSCENE_H
@@ -0,0 +1,248 @@
+#include "RaySceneCache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <cstring>
+#include <iostream>
+
+const char sceneCacheMagic[4] = { 'R', 'S', 'C', 'C' };
+const std::string sceneCacheSuffix = ".raycache";
+
+/** Whether a cached primitive has a type RayPrimitiveTable can trace without a heightfield */
+static bool isTraceable(PrimitiveType type) {
+    switch (type) {
+        case PrimitiveType::PRIMITIVE_CUBE:
+        case PrimitiveType::PRIMITIVE_CONE:
+        case PrimitiveType::PRIMITIVE_CYLINDER:
+        case PrimitiveType::PRIMITIVE_SPHERE:
+        case PrimitiveType::PRIMITIVE_LEAF:
+        case PrimitiveType::PRIMITIVE_FRUIT:
+        case PrimitiveType::PRIMITIVE_TRUNK:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RaySceneCache::RaySceneCache() :
+    m_data(nullptr),
+    m_size(0)
+{
+}
+
+RaySceneCache::~RaySceneCache()
+{
+    // Closing the file unmaps it
+}
+
+std::string RaySceneCache::hashFile(const std::string &filename) {
+    QFile file(QString::fromStdString(filename));
+    if (!file.open(QFile::ReadOnly)) {
+        return std::string();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file)) {
+        return std::string();
+    }
+    return hash.result().toHex().toStdString();
+}
+
+std::string RaySceneCache::getCacheFilename(const std::string &directory, const std::string &sceneHash) {
+    return QDir(QString::fromStdString(directory)).filePath(
+                QString::fromStdString(sceneHash + sceneCacheSuffix)).toStdString();
+}
+
+bool RaySceneCache::open(const std::string &filename, const std::string &sceneHash) {
+    m_file = std::make_unique<QFile>(QString::fromStdString(filename));
+    m_data = nullptr;
+    m_size = 0;
+    if (!m_file->open(QFile::ReadOnly)) {
+        return false;
+    }
+    m_size = m_file->size();
+    m_data = reinterpret_cast<const char *>(m_file->map(0, m_size));
+    if (!m_data || !isValid(sceneHash)) {
+        std::cerr << "ignoring scene cache " << filename << ": out of date or unreadable" << std::endl;
+        m_file.reset();
+        m_data = nullptr;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+const RaySceneCacheHeader &RaySceneCache::getHeader() const {
+    return *reinterpret_cast<const RaySceneCacheHeader *>(m_data);
+}
+
+/** A string from CACHE_STRINGS, or an empty string if the offset is out of range */
+const char *RaySceneCache::getString(uint32_t offset) const {
+    const RayCachedSection &strings = getHeader().sections[static_cast<int>(RaySceneCacheSection::CACHE_STRINGS)];
+    if (offset >= strings.size) {
+        return "";
+    }
+    return m_data + strings.offset + offset;
+}
+
+/** Whether the mapped file is a complete cache for this scene, written by a compatible build */
+bool RaySceneCache::isValid(const std::string &sceneHash) const {
+    if (m_size < sizeof(RaySceneCacheHeader)) {
+        return false;
+    }
+    const RaySceneCacheHeader &header = getHeader();
+    return memcmp(header.magic, sceneCacheMagic, sizeof(sceneCacheMagic)) == 0
+            && header.version == raySceneCacheVersion
+            && header.primitiveRecordSize == sizeof(RayPrimitive)
+            && header.bvhNodeSize == sizeof(BVH::Node)
+            && header.lightRecordSize == sizeof(CS123SceneLightData)
+            && header.materialRecordSize == sizeof(RayCachedMaterial)
+            && sceneHash.size() == contentHashLength
+            && memcmp(header.sceneHash, sceneHash.data(), contentHashLength) == 0
+            && areSectionsValid()
+            && areDependenciesCurrent();
+}
+
+/**
+ *  Whether every section lies within the file, every index stored in one points into the
+ *  section it refers to, and every primitive has a type the table can trace and agrees with its
+ *  material, so that a damaged cache cannot make the renderer read out of bounds.
+ */
+bool RaySceneCache::areSectionsValid() const {
+    for (const RayCachedSection &section : getHeader().sections) {
+        if (section.offset % cacheSectionAlignment != 0 || section.offset > m_size
+                || section.size > m_size - section.offset) {
+            return false;
+        }
+    }
+
+    int numPrimitives, numMaterials, numNodes, numIndices, numTextures, numTexels, numStrings;
+    const RayPrimitive *primitives = getSection<RayPrimitive>(RaySceneCacheSection::CACHE_PRIMITIVES,
+                                                              numPrimitives);
+    const RayCachedMaterial *materials = getSection<RayCachedMaterial>(RaySceneCacheSection::CACHE_MATERIALS,
+                                                                       numMaterials);
+    const BVH::Node *nodes = getSection<BVH::Node>(RaySceneCacheSection::CACHE_BVH_NODES, numNodes);
+    const int *indices = getSection<int>(RaySceneCacheSection::CACHE_BVH_INDICES, numIndices);
+    const RayCachedTexture *textures = getSection<RayCachedTexture>(RaySceneCacheSection::CACHE_TEXTURES,
+                                                                    numTextures);
+    getSection<glm::vec4>(RaySceneCacheSection::CACHE_TEXELS, numTexels);
+    const char *strings = getSection<char>(RaySceneCacheSection::CACHE_STRINGS, numStrings);
+
+    if (numMaterials != numPrimitives || numIndices != numPrimitives
+            || (numStrings > 0 && strings[numStrings - 1] != '\0')) {
+        return false;
+    }
+    for (int i = 0; i < numPrimitives; i++) {
+        const RayPrimitive &record = primitives[i];
+        if (record.materialIndex < 0 || record.materialIndex >= numMaterials
+                || !isTraceable(record.type) || materials[record.materialIndex].type != record.type) {
+            return false;
+        }
+    }
+    for (int i = 0; i < numMaterials; i++) {
+        if (materials[i].textureIndex >= numTextures) {
+            return false;
+        }
+    }
+    for (int i = 0; i < numTextures; i++) {
+        if (textures[i].width <= 0 || textures[i].height <= 0 || textures[i].firstTexel > numTexels
+                || static_cast<uint64_t>(textures[i].width) * textures[i].height
+                        > numTexels - textures[i].firstTexel) {
+            return false;
+        }
+    }
+    for (int i = 0; i < numIndices; i++) {
+        if (indices[i] < 0 || indices[i] >= numPrimitives) {
+            return false;
+        }
+    }
+    for (int i = 0; i < numNodes; i++) {
+        bool isLeaf = nodes[i].count > 0;
+        if (isLeaf ? nodes[i].offset < 0 || nodes[i].offset + nodes[i].count > numIndices
+                   : nodes[i].offset <= i + 1 || nodes[i].offset >= numNodes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Whether every file the cache was built from still has the contents it had then */
+bool RaySceneCache::areDependenciesCurrent() const {
+    int numDependencies;
+    const RayCachedDependency *dependencies =
+            getSection<RayCachedDependency>(RaySceneCacheSection::CACHE_DEPENDENCIES, numDependencies);
+    for (int i = 0; i < numDependencies; i++) {
+        std::string hash = hashFile(getString(dependencies[i].filename));
+        if (hash.size() != contentHashLength
+                || memcmp(hash.data(), dependencies[i].hash, contentHashLength) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+RaySceneCacheWriter::RaySceneCacheWriter() :
+    // Offset 0 is the empty string
+    m_strings(1, '\0')
+{
+    std::fill(m_sectionData, m_sectionData + numCacheSections, nullptr);
+    std::fill(m_sectionSizes, m_sectionSizes + numCacheSections, 0);
+}
+
+void RaySceneCacheWriter::setSection(RaySceneCacheSection section, const void *data, size_t size) {
+    m_sectionData[static_cast<int>(section)] = data;
+    m_sectionSizes[static_cast<int>(section)] = size;
+}
+
+uint32_t RaySceneCacheWriter::addString(const std::string &string) {
+    if (string.empty()) {
+        return 0;
+    }
+    uint32_t offset = m_strings.size();
+    m_strings.append(string.c_str(), string.size() + 1);
+    return offset;
+}
+
+bool RaySceneCacheWriter::write(const std::string &filename, RaySceneCacheHeader header) {
+    setSection(RaySceneCacheSection::CACHE_STRINGS, m_strings.data(), m_strings.size());
+
+    memcpy(header.magic, sceneCacheMagic, sizeof(sceneCacheMagic));
+    header.version = raySceneCacheVersion;
+    header.primitiveRecordSize = sizeof(RayPrimitive);
+    header.bvhNodeSize = sizeof(BVH::Node);
+    header.lightRecordSize = sizeof(CS123SceneLightData);
+    header.materialRecordSize = sizeof(RayCachedMaterial);
+    auto align = [](uint64_t offset) {
+        return (offset + cacheSectionAlignment - 1) / cacheSectionAlignment * cacheSectionAlignment;
+    };
+    uint64_t offset = align(sizeof(RaySceneCacheHeader));
+    for (int i = 0; i < numCacheSections; i++) {
+        header.sections[i].offset = offset;
+        header.sections[i].size = m_sectionSizes[i];
+        offset = align(offset + m_sectionSizes[i]);
+    }
+
+    // QSaveFile writes to a temporary file and renames it over filename on commit
+    QSaveFile file(QString::fromStdString(filename));
+    if (!file.open(QFile::WriteOnly)) {
+        std::cerr << "could not open " << filename << " for writing" << std::endl;
+        return false;
+    }
+    const char padding[cacheSectionAlignment] = {};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(RaySceneCacheHeader));
+    uint64_t written = sizeof(RaySceneCacheHeader);
+    for (int i = 0; i < numCacheSections; i++) {
+        file.write(padding, header.sections[i].offset - written);
+        if (m_sectionSizes[i] > 0) {
+            file.write(static_cast<const char *>(m_sectionData[i]), m_sectionSizes[i]);
+        }
+        written = header.sections[i].offset + m_sectionSizes[i];
+    }
+    if (!file.commit()) {
+        std::cerr << "could not write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,177 @@
+#ifndef RAYSCENECACHE_H
+#define RAYSCENECACHE_H
+
+#include "BVH.h"
+#include "CS123SceneData.h"
+#include "RayPrimitives.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class QFile;
+
+/** The sections of a scene cache file, and what each holds */
+enum class RaySceneCacheSection {
+    CACHE_LIGHTS,       // CS123SceneLightData[]
+    CACHE_PRIMITIVES,   // RayPrimitive[], the baked records
+    CACHE_MATERIALS,    // RayCachedMaterial[], one per primitive
+    CACHE_BVH_NODES,    // BVH::Node[]
+    CACHE_BVH_INDICES,  // int[], the BVH's primitive indices
+    CACHE_TEXTURES,     // RayCachedTexture[]
+    CACHE_TEXELS,       // glm::vec4[], the decoded texels of every texture
+    CACHE_DEPENDENCIES, // RayCachedDependency[], the files other than the scene it was built from
+    CACHE_STRINGS,      // NUL-terminated strings, which the other sections refer to by offset
+    NUM_CACHE_SECTIONS
+};
+
+const int numCacheSections = static_cast<int>(RaySceneCacheSection::NUM_CACHE_SECTIONS);
+
+/** Length of a content hash: a SHA-1 digest in hex */
+const int contentHashLength = 40;
+
+const uint32_t raySceneCacheVersion = 1;
+
+/** Sections start on a cache line, so that the records can be used where they are mapped */
+const int cacheSectionAlignment = cacheLineSize;
+
+struct RayCachedSection {
+    // Byte offset from the start of the file, and size in bytes
+    uint64_t offset;
+    uint64_t size;
+};
+
+/**
+ *  Scene cache file layout:
+ *    header    RaySceneCacheHeader
+ *    sections  each RaySceneCacheSection in turn, aligned to cacheSectionAlignment
+ *  Records are stored exactly as they are laid out in memory, so a cache can only be read by
+ *  a build with the same layouts, which the header records the sizes of.
+ */
+struct RaySceneCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t primitiveRecordSize;
+    uint32_t bvhNodeSize;
+    uint32_t lightRecordSize;
+    uint32_t materialRecordSize;
+    // Hash of the scene file the cache was built from
+    char sceneHash[contentHashLength];
+    CS123SceneGlobalData global;
+    CS123SceneCameraData camera;
+    RayCachedSection sections[numCacheSections];
+};
+
+struct RayCachedFileMap {
+    uint32_t isUsed;
+    // Offset in CACHE_STRINGS
+    uint32_t filename;
+    float repeatU;
+    float repeatV;
+};
+
+/** A CS123ScenePrimitive's type and material, with its strings moved to CACHE_STRINGS */
+struct RayCachedMaterial {
+    PrimitiveType type;
+    uint32_t meshfile;
+    CS123SceneColor cDiffuse;
+    CS123SceneColor cAmbient;
+    CS123SceneColor cReflective;
+    CS123SceneColor cSpecular;
+    CS123SceneColor cTransparent;
+    CS123SceneColor cEmissive;
+    RayCachedFileMap textureMap;
+    RayCachedFileMap bumpMap;
+    float blend;
+    float shininess;
+    float ior;
+    // Index in CACHE_TEXTURES of the decoded texture map, or -1 if there is none
+    int32_t textureIndex;
+};
+
+struct RayCachedTexture {
+    int32_t width;
+    int32_t height;
+    // Index in CACHE_TEXELS of the first of the texture's width * height texels
+    uint64_t firstTexel;
+};
+
+/** A file the cache depends on, such as a texture map, and the hash of its contents then */
+struct RayCachedDependency {
+    uint32_t filename;
+    char hash[contentHashLength];
+};
+
+/**
+ * @class RaySceneCache
+ *
+ * A scene cache file mapped into memory: everything RayScene builds from a scene file, i.e.
+ * the flattened primitives and their baked records, the lights, the BVH and the decoded
+ * textures, written by RayScene::writeCache. Caches are named by the hash of the scene file's
+ * contents, so an edited scene never finds a stale cache, and hold the hashes of the texture
+ * maps they decoded, which are checked when the cache is opened. Nothing is copied when a
+ * cache is opened; RayScene renders straight from the mapped records.
+ */
+class RaySceneCache
+{
+public:
+    RaySceneCache();
+    ~RaySceneCache();
+
+    // Hex hash of a file's contents, or an empty string if it cannot be read
+    static std::string hashFile(const std::string &filename);
+    // Where the cache for a scene file with the given hash is kept in a directory
+    static std::string getCacheFilename(const std::string &directory, const std::string &sceneHash);
+
+    // Maps a cache file. False if there is none, or if it is not a valid cache for the scene
+    // with sceneHash, in which case it should be rebuilt.
+    bool open(const std::string &filename, const std::string &sceneHash);
+
+    const RaySceneCacheHeader &getHeader() const;
+    // The records of a section, and their number
+    template <typename Record>
+    const Record *getSection(RaySceneCacheSection section, int &count) const;
+    const char *getString(uint32_t offset) const;
+
+private:
+    bool isValid(const std::string &sceneHash) const;
+    bool areSectionsValid() const;
+    bool areDependenciesCurrent() const;
+
+    std::unique_ptr<QFile> m_file;
+    const char *m_data;
+    uint64_t m_size;
+};
+
+template <typename Record>
+const Record *RaySceneCache::getSection(RaySceneCacheSection section, int &count) const {
+    const RayCachedSection &entry = getHeader().sections[static_cast<int>(section)];
+    count = static_cast<int>(entry.size / sizeof(Record));
+    return reinterpret_cast<const Record *>(m_data + entry.offset);
+}
+
+/**
+ * @class RaySceneCacheWriter
+ *
+ * Collects the sections of a scene cache and writes them out. The sections are not copied, so
+ * their data must stay alive until write is called.
+ */
+class RaySceneCacheWriter
+{
+public:
+    RaySceneCacheWriter();
+
+    void setSection(RaySceneCacheSection section, const void *data, size_t size);
+    // Adds a string to CACHE_STRINGS, returning its offset there
+    uint32_t addString(const std::string &string);
+    // Fills in the header's magic, version, record sizes and section table, and replaces
+    // filename with the cache in one step, so a reader never sees half a file
+    bool write(const std::string &filename, RaySceneCacheHeader header);
+
+private:
+    const void *m_sectionData[numCacheSections];
+    size_t m_sectionSizes[numCacheSections];
+    std::string m_strings;
+};
+
+#endif // RAYSCENECACHE_H
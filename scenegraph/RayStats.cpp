@@ -0,0 +1,118 @@
+#include "RayStats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+const char *rayTypeNames[numRayTypes] = { "primary", "shadow", "reflection", "refraction" };
+
+/** a / b, or 0 if there is nothing to divide by */
+static double ratio(double a, double b) {
+    return b > 0.0 ? a / b : 0.0;
+}
+
+RayStats::RayStats() :
+    nodesVisited(0),
+    primitiveTests(0),
+    primitiveHits(0),
+    numTiles(0),
+    tileSeconds(0.0),
+    maxTileSeconds(0.0),
+    previewSeconds(0.0),
+    centerSeconds(0.0),
+    refineSeconds(0.0),
+    renderSeconds(0.0)
+{
+    std::fill(rays, rays + numRayTypes, 0);
+    std::fill(hits, hits + numRayTypes, 0);
+}
+
+void RayStats::countTile(double seconds) {
+    numTiles++;
+    tileSeconds += seconds;
+    maxTileSeconds = std::max(maxTileSeconds, seconds);
+}
+
+/** Add the counters of another thread, or another pass, to these */
+void RayStats::add(const RayStats &that) {
+    for (int i = 0; i < numRayTypes; i++) {
+        rays[i] += that.rays[i];
+        hits[i] += that.hits[i];
+    }
+    nodesVisited += that.nodesVisited;
+    primitiveTests += that.primitiveTests;
+    primitiveHits += that.primitiveHits;
+    numTiles += that.numTiles;
+    tileSeconds += that.tileSeconds;
+    maxTileSeconds = std::max(maxTileSeconds, that.maxTileSeconds);
+    previewSeconds += that.previewSeconds;
+    centerSeconds += that.centerSeconds;
+    refineSeconds += that.refineSeconds;
+    renderSeconds += that.renderSeconds;
+}
+
+uint64_t RayStats::getTotalRays() const {
+    uint64_t total = 0;
+    for (int i = 0; i < numRayTypes; i++) {
+        total += rays[i];
+    }
+    return total;
+}
+
+std::string RayStats::toJson() const {
+    std::ostringstream json;
+    double totalRays = static_cast<double>(getTotalRays());
+    json << "{\n  \"rays\": {";
+    for (int i = 0; i < numRayTypes; i++) {
+        json << (i > 0 ? ", " : " ") << "\"" << rayTypeNames[i] << "\": " << rays[i];
+    }
+    json << " },\n  \"hits\": {";
+    for (int i = 0; i < numRayTypes; i++) {
+        json << (i > 0 ? ", " : " ") << "\"" << rayTypeNames[i] << "\": " << hits[i];
+    }
+    json << " },\n  \"hitRates\": {";
+    for (int i = 0; i < numRayTypes; i++) {
+        json << (i > 0 ? ", " : " ") << "\"" << rayTypeNames[i] << "\": "
+             << ratio(static_cast<double>(hits[i]), static_cast<double>(rays[i]));
+    }
+    json << " },\n"
+         << "  \"nodesVisited\": " << nodesVisited << ",\n"
+         << "  \"nodesVisitedPerRay\": " << ratio(static_cast<double>(nodesVisited), totalRays) << ",\n"
+         << "  \"primitiveTests\": " << primitiveTests << ",\n"
+         << "  \"primitiveTestsPerRay\": " << ratio(static_cast<double>(primitiveTests), totalRays) << ",\n"
+         << "  \"primitiveHits\": " << primitiveHits << ",\n"
+         << "  \"primitiveHitRate\": "
+         << ratio(static_cast<double>(primitiveHits), static_cast<double>(primitiveTests)) << ",\n"
+         << "  \"tiles\": { \"count\": " << numTiles
+         << ", \"totalMs\": " << tileSeconds * 1000.0
+         << ", \"meanMs\": " << ratio(tileSeconds, static_cast<double>(numTiles)) * 1000.0
+         << ", \"maxMs\": " << maxTileSeconds * 1000.0 << " },\n"
+         << "  \"passes\": { \"previewMs\": " << previewSeconds * 1000.0
+         << ", \"centerMs\": " << centerSeconds * 1000.0
+         << ", \"refineMs\": " << refineSeconds * 1000.0
+         << ", \"totalMs\": " << renderSeconds * 1000.0 << " }\n"
+         << "}\n";
+    return json.str();
+}
+
+std::string RayStats::toString() const {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1);
+    double totalRays = static_cast<double>(getTotalRays());
+    text << "Rays cast: " << getTotalRays() << "\n";
+    for (int i = 0; i < numRayTypes; i++) {
+        text << "  " << rayTypeNames[i] << ": " << rays[i] << " ("
+             << 100.0 * ratio(static_cast<double>(hits[i]), static_cast<double>(rays[i]))
+             << (i == static_cast<int>(RayType::RAY_SHADOW) ? "% blocked)\n" : "% hit)\n");
+    }
+    text << "BVH nodes visited per ray: " << ratio(static_cast<double>(nodesVisited), totalRays) << "\n"
+         << "Primitive tests per ray: " << ratio(static_cast<double>(primitiveTests), totalRays)
+         << " (" << 100.0 * ratio(static_cast<double>(primitiveHits), static_cast<double>(primitiveTests))
+         << "% hit)\n"
+         << "Tiles: " << numTiles << ", mean " << ratio(tileSeconds, static_cast<double>(numTiles)) * 1000.0
+         << " ms, slowest " << maxTileSeconds * 1000.0 << " ms\n"
+         << "Passes: preview " << previewSeconds * 1000.0 << " ms, center " << centerSeconds * 1000.0
+         << " ms, refine " << refineSeconds * 1000.0 << " ms\n"
+         << "Total: " << renderSeconds * 1000.0 << " ms\n";
+    return text.str();
+}
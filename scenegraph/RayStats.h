@@ -0,0 +1,58 @@
+#ifndef RAYSTATS_H
+#define RAYSTATS_H
+
+#include <cstdint>
+#include <string>
+
+/** The kinds of ray the tracer casts, for counting */
+enum class RayType {
+    RAY_PRIMARY, RAY_SHADOW, RAY_REFLECTION, RAY_REFRACTION, NUM_RAY_TYPES
+};
+
+const int numRayTypes = static_cast<int>(RayType::NUM_RAY_TYPES);
+
+/**
+ *  Counters and timings for one render. Every render thread counts into a RayStats of its
+ *  own, and those are only added together once the threads of a pass have finished, so
+ *  counting never takes a lock or touches memory another thread writes.
+ */
+struct RayStats {
+    // Rays cast of each RayType, and how many of them hit a primitive; for shadow rays, how
+    // many were blocked
+    uint64_t rays[numRayTypes];
+    uint64_t hits[numRayTypes];
+    // BVH nodes visited by all ray and packet traversals; a packet visits a node once
+    uint64_t nodesVisited;
+    // Ray-primitive intersection tests, and those that found a hit closer than the best so far
+    // or, for shadow rays, a blocking one
+    uint64_t primitiveTests;
+    uint64_t primitiveHits;
+    // Wall time spent in each tile, summed over the threads, and the slowest tile
+    uint64_t numTiles;
+    double tileSeconds;
+    double maxTileSeconds;
+    // Wall time of each pass, summed over the bands, and of the whole render
+    double previewSeconds;
+    double centerSeconds;
+    double refineSeconds;
+    double renderSeconds;
+
+    RayStats();
+
+    void countRay(RayType type, bool hit);
+    void countTile(double seconds);
+    void add(const RayStats &that);
+
+    uint64_t getTotalRays() const;
+    // A JSON object with the raw counters plus hit rates and per-ray averages
+    std::string toJson() const;
+    // A short summary for people
+    std::string toString() const;
+};
+
+inline void RayStats::countRay(RayType type, bool hit) {
+    rays[static_cast<int>(type)]++;
+    hits[static_cast<int>(type)] += hit ? 1 : 0;
+}
+
+#endif // RAYSTATS_H
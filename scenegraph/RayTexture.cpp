@@ -0,0 +1,75 @@
+#include "RayTexture.h"
+
+#include <cmath>
+
+static int powerOfTwoMask(int size) {
+    return (size & (size - 1)) == 0 ? size - 1 : -1;
+}
+
+RayTexture::RayTexture(const uint32_t *pixels, int width, int height) :
+    m_storage(width * height),
+    m_texels(m_storage.data()),
+    m_width(width),
+    m_height(height),
+    m_widthMask(powerOfTwoMask(width)),
+    m_heightMask(powerOfTwoMask(height))
+{
+    for (int i = 0; i < width * height; i++) {
+        uint32_t pixel = pixels[i];
+        m_storage[i] = glm::vec4((pixel >> 16) & 0xff, (pixel >> 8) & 0xff, pixel & 0xff,
+                                 pixel >> 24) / 255.f;
+    }
+}
+
+RayTexture::RayTexture(const glm::vec4 *texels, int width, int height) :
+    m_texels(texels),
+    m_width(width),
+    m_height(height),
+    m_widthMask(powerOfTwoMask(width)),
+    m_heightMask(powerOfTwoMask(height))
+{
+}
+
+int RayTexture::getWidth() const {
+    return m_width;
+}
+
+int RayTexture::getHeight() const {
+    return m_height;
+}
+
+const glm::vec4 *RayTexture::getTexels() const {
+    return m_texels;
+}
+
+/** Bring a texel coordinate that may be negative or past the edge back into [0, size) */
+inline int RayTexture::wrap(int coord, int size, int mask) {
+    if (mask >= 0) {
+        return coord & mask;
+    }
+    int wrapped = coord % size;
+    return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+inline const glm::vec4 &RayTexture::getTexel(int x, int y) const {
+    return m_texels[wrap(y, m_height, m_heightMask) * m_width + wrap(x, m_width, m_widthMask)];
+}
+
+/**
+ *  Blend the four texels nearest to (u, v). Texel centers sit at half-integer coordinates,
+ *  so a texture repeated across a surface blends smoothly over the seam.
+ */
+glm::vec4 RayTexture::sample(float u, float v) const {
+    float x = u * m_width - 0.5f;
+    float y = v * m_height - 0.5f;
+    float left = std::floor(x);
+    float top = std::floor(y);
+    float horizWeight = x - left;
+    float vertWeight = y - top;
+    int col = static_cast<int>(left);
+    int row = static_cast<int>(top);
+
+    glm::vec4 topColor = glm::mix(getTexel(col, row), getTexel(col + 1, row), horizWeight);
+    glm::vec4 bottomColor = glm::mix(getTexel(col, row + 1), getTexel(col + 1, row + 1), horizWeight);
+    return glm::mix(topColor, bottomColor, vertWeight);
+}
@@ -0,0 +1,47 @@
+#ifndef RAYTEXTURE_H
+#define RAYTEXTURE_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class RayTexture
+ *
+ * A texture map decoded once into float RGBA texels for the ray tracer, so that a lookup is
+ * a few array loads with no per-texel format conversion or bounds checks. Coordinates repeat
+ * outside [0, 1), with a bit mask instead of a division for power-of-two sizes. It has no Qt
+ * dependency; RayScene converts its QImages into these.
+ */
+class RayTexture
+{
+public:
+    // pixels holds width * height 0xAARRGGBB values, row by row from the top
+    RayTexture(const uint32_t *pixels, int width, int height);
+    // Views texels decoded earlier, e.g. in a mapped scene cache, which must outlive the texture
+    RayTexture(const glm::vec4 *texels, int width, int height);
+    RayTexture(const RayTexture &that) = delete;
+    RayTexture &operator=(const RayTexture &that) = delete;
+
+    int getWidth() const;
+    int getHeight() const;
+    // width * height texels, row by row from the top
+    const glm::vec4 *getTexels() const;
+    // Bilinearly filtered color at texture coordinates (u, v), with (0, 0) the top left corner
+    glm::vec4 sample(float u, float v) const;
+
+private:
+    static int wrap(int coord, int size, int mask);
+    const glm::vec4 &getTexel(int x, int y) const;
+
+    // Storage for texels decoded here; empty if they are viewed
+    std::vector<glm::vec4> m_storage;
+    const glm::vec4 *m_texels;
+    int m_width;
+    int m_height;
+    // size - 1 for power-of-two sizes, or -1 if coordinates must be wrapped with a modulo
+    int m_widthMask;
+    int m_heightMask;
+};
+
+#endif // RAYTEXTURE_H
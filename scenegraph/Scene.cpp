@@ -21,6 +21,8 @@ Scene::Scene(Scene &scene)
     m_primitives = scene.m_primitives;
     m_matrices = scene.m_matrices;
     m_textures = scene.m_textures;
+    m_heightfield = scene.m_heightfield;
+    m_heightfieldMaterial = scene.m_heightfieldMaterial;
 }
 
 Scene::~Scene()
@@ -45,38 +47,37 @@ void Scene::parse(Scene *sceneToFill, CS123ISceneParser *parser) {
     }
 
     // Add primitive data
-    CS123SceneNode *root = parser->getRootNode();
-    glm::mat4 cumulativeMatrix = glm::mat4(1.0f);
-    sceneToFill->traverseSceneGraph(root, cumulativeMatrix);
+    const CS123SceneGraph &graph = parser->getSceneGraph();
+    if (graph.root >= 0) {
+        glm::mat4 cumulativeMatrix = glm::mat4(1.0f);
+        sceneToFill->traverseSceneGraph(graph, graph.root, cumulativeMatrix);
+    }
 }
 
 /** Recursively add primitives to scene */
-void Scene::traverseSceneGraph(CS123SceneNode *node, glm::mat4 cumulativeMatrix) {
-    std::vector<CS123SceneTransformation *> transformations = node->transformations;
+void Scene::traverseSceneGraph(const CS123SceneGraph &graph, int nodeIndex, glm::mat4 cumulativeMatrix) {
+    const CS123SceneNode &node = graph.nodes[nodeIndex];
     // Accumulate transformation matrices
-    for (int i = 0; i < transformations.size(); i++) {
-        glm::mat4 childMatrix = getMatrixForTransformation(*transformations[i]);
+    const CS123SceneTransformation *transformations = graph.transformations + node.firstTransformation;
+    for (int i = 0; i < node.numTransformations; i++) {
+        glm::mat4 childMatrix = getMatrixForTransformation(transformations[i]);
         cumulativeMatrix = cumulativeMatrix * childMatrix;
     }
     // For primitives, add to scene, along with transformation matrix and texture
-    std::vector<CS123ScenePrimitive *> primitives = node->primitives;
-    for (int i = 0; i < primitives.size(); i++) {
-        CS123ScenePrimitive primitive = *primitives[i];
-        CS123SceneFileMap textureMap = primitive.material.textureMap;
-        QImage *texture;
+    const CS123ScenePrimitive *primitives = graph.primitives + node.firstPrimitive;
+    for (int i = 0; i < node.numPrimitives; i++) {
+        const CS123SceneFileMap &textureMap = primitives[i].material.textureMap;
+        // Null image if the primitive has no texture
+        QImage texture;
         if (textureMap.isUsed) {
-            QString filename = QString::fromStdString(textureMap.filename);
-            texture = new QImage(filename);
-        } else {
-            // Null image
-            texture = new QImage();
+            texture = QImage(QString::fromStdString(textureMap.filename));
         }
-        addPrimitive(primitive, cumulativeMatrix, *texture);
+        addPrimitive(primitives[i], cumulativeMatrix, texture);
     }
     // For node with non-primitive children
-    std::vector<CS123SceneNode *> children = node->children;
-    for (int i = 0; i < children.size(); i++) {
-        traverseSceneGraph(children[i], cumulativeMatrix);
+    const int *children = graph.children + node.firstChild;
+    for (int i = 0; i < node.numChildren; i++) {
+        traverseSceneGraph(graph, children[i], cumulativeMatrix);
     }
 }
 
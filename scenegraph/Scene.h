@@ -2,11 +2,14 @@
 #define SCENE_H
 
 #include "CS123SceneData.h"
-#include "SupportCanvas3D.h"
 #include "QImage"
 
+#include <memory>
+
 class Camera;
 class CS123ISceneParser;
+class RayHeightfield;
+class SupportCanvas3D;
 
 
 /**
@@ -40,7 +43,7 @@ protected:
     virtual void setGlobal(const CS123SceneGlobalData &global);
 
     // Traverse the scene graph, adding primitives and transformations
-    void traverseSceneGraph(CS123SceneNode *node, glm::mat4 cumulativeMatrix);
+    void traverseSceneGraph(const CS123SceneGraph &graph, int nodeIndex, glm::mat4 cumulativeMatrix);
 
     glm::mat4 getMatrixForTransformation(const CS123SceneTransformation &transform);
 
@@ -50,6 +53,9 @@ protected:
     std::vector<glm::mat4> m_matrices;
     // One element per primitive; null image if primitive has no texture
     std::vector<QImage> m_textures;
+    // Ground surface the ray tracer intersects along with the primitives; null if there is none
+    std::shared_ptr<const RayHeightfield> m_heightfield;
+    CS123SceneMaterial m_heightfieldMaterial;
 
     // Called when the scroll wheel changes position.
 
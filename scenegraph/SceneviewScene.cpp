@@ -7,11 +7,17 @@
 #include "SupportCanvas3D.h"
 #include "ResourceLoader.h"
 #include "gl/shaders/CS123Shader.h"
+#include "gl/shaders/ShaderAttribLocations.h"
+#include "gl/datatype/VBO.h"
+#include "gl/datatype/VBOAttribMarker.h"
+#include "gl/datatype/FBO.h"
 #include "shapes/Cylinder.h"
 #include "shapes/Cone.h"
 #include "shapes/Cube.h"
 #include "shapes/Sphere.h"
 #include "trees/terrain.h"
+#include "scenegraph/RayHeightfield.h"
+#include "glm/gtc/matrix_access.hpp"
 #include <iostream>
 
 
@@ -29,14 +35,19 @@ SceneviewScene::SceneviewScene() :
     m_fruit(nullptr),
     m_trunk(nullptr),
     m_fruit_index(0),
+    m_fruitInstancesDirty(true),
+    m_treeInstancesDirty(true),
+    m_fruitSwayDirty(true),
     m_shapesTessellated(false)
 {
+    m_windClock.start();
 
     m_implicitShape = std::make_unique<ImplicitShape>();
     m_implicitSphere = std::make_unique<ImplicitSphere>();
 
     loadPhongShader();
     loadTerrainShader();
+    loadPickShader();
     loadWireframeShader();
     loadNormalsShader();
     loadNormalsArrowShader();
@@ -57,7 +68,7 @@ void SceneviewScene::initializeTreeScene() {
     m_terrain->openGLShape = std::make_unique<OpenGLShape>(true);
     m_terrain->openGLShape->m_vertexData = data;
     m_terrain->openGLShape->initializeOpenGLShapeProperties();
-
+    defineHeightfield();
 
     m_treeGenerator = std::make_unique<MeshGenerator>();
     defineLights();
@@ -65,6 +76,20 @@ void SceneviewScene::initializeTreeScene() {
     regenerateTree();
 }
 
+/**
+ *  Give the ray tracer the terrain's grid, with a material matching the colors of the
+ *  terrain shader: a reddish ambient term plus green diffuse
+ */
+void SceneviewScene::defineHeightfield() {
+    m_heightfield = std::make_shared<RayHeightfield>(m_terrain->getHeights(), m_terrain->getNumRows(),
+                                                     m_terrain->getNumCols(), m_terrain->getHalfExtent());
+    m_heightfieldMaterial.clear();
+    m_heightfieldMaterial.cAmbient.r = 0.3f;
+    m_heightfieldMaterial.cAmbient.g = 0.2f;
+    m_heightfieldMaterial.cAmbient.b = 0.2f;
+    m_heightfieldMaterial.cDiffuse.g = 0.6f;
+}
+
 /** Get new tree from generator and set scene data accordingly */
 void SceneviewScene::regenerateTree() {
     m_treeGenerator->generateTree();
@@ -75,27 +100,65 @@ void SceneviewScene::regenerateTree() {
 void SceneviewScene::updateSceneFromTree() {
     m_primitives.clear();
     m_matrices.clear();
+    m_textures.clear();
     m_fruitPhysics.clear();
+    m_fruitSway.clear();
+    m_trunkInstanceData.clear();
+    m_leafInstanceData.clear();
     m_fruit_index = 0;
     std::vector<CS123ScenePrimitive> treePrimitives = m_treeGenerator->getPrimitives();
     std::vector<glm::mat4> treeTransformations = m_treeGenerator->getTransformations();
+    std::vector<SwayInstanceData> treeSway = m_treeGenerator->getSway();
 
     // Adjust for terrain height
-    glm::mat4 trunkAdj = glm::translate(glm::vec3(0, m_terrain->getHeightFromWorld(glm::vec3(0.0f))-0.25, 0));
+    glm::vec3 trunkOffset = glm::vec3(0, m_terrain->getHeightFromWorld(glm::vec3(0.0f))-0.25, 0);
+    glm::mat4 trunkAdj = glm::translate(trunkOffset);
 
     for (int i = 0; i < treePrimitives.size(); i++) {
         m_primitives.push_back(treePrimitives[i]);
         m_matrices.push_back(trunkAdj * treeTransformations[i]);
+        m_textures.push_back(QImage());
+
+        // Trunk and leaves are drawn instanced, so gather their transforms and sway
+        TreeInstanceData instance;
+        for (int row = 0; row < 3; row++) {
+            instance.modelRows[row] = glm::row(m_matrices.back(), row);
+        }
+        instance.sway = treeSway[i].translated(trunkOffset);
+        if (treePrimitives[i].type == PrimitiveType::PRIMITIVE_TRUNK) {
+            m_trunkMaterial = treePrimitives[i].material;
+            m_trunkInstanceData.push_back(instance);
+        } else if (treePrimitives[i].type == PrimitiveType::PRIMITIVE_LEAF) {
+            m_leafMaterial = treePrimitives[i].material;
+            m_leafInstanceData.push_back(instance);
+        }
     }
     std::vector<CS123ScenePrimitive> fruitPrimitives = m_treeGenerator->getFruitPrimitives();
     std::vector<glm::mat4> fruitTransformations = m_treeGenerator->getFruitTransformations();
+    std::vector<SwayInstanceData> fruitSway = m_treeGenerator->getFruitSway();
     m_fruitOffset = m_primitives.size();
     for (int i = 0; i < fruitPrimitives.size(); i++) {
         m_primitives.push_back(fruitPrimitives[i]);
         m_matrices.push_back(trunkAdj * fruitTransformations[i]);
-        glm::vec3 start_pos = (trunkAdj * fruitTransformations[i] * glm::vec4(0, 0, 0, 1)).xyz();
-                auto t = std::make_unique<FruitTransformation>(start_pos);
-                m_fruitPhysics.push_back(std::move(t));
+        m_textures.push_back(QImage());
+        m_fruitPhysics.push_back(std::make_unique<FruitTransformation>(m_matrices.back()));
+        m_fruitSway.push_back(fruitSway[i].translated(trunkOffset));
+    }
+    m_fruitInstancesDirty = true;
+    m_fruitSwayDirty = true;
+    m_treeInstancesDirty = true;
+
+    updateFruitBounds();
+    m_fruitBVH.build(m_fruitBounds);
+}
+
+/** Recompute the world space bounding sphere of every fruit */
+void SceneviewScene::updateFruitBounds() {
+    m_fruitBounds.resize(m_fruitPhysics.size());
+    for (int i = 0; i < m_fruitPhysics.size(); i++) {
+        m_fruitBounds[i].center = m_fruitPhysics[i]->pos;
+        // The fruit is the implicit sphere under a uniform scale
+        m_fruitBounds[i].radius = radius * m_fruitPhysics[i]->scale;
     }
 }
 
@@ -123,6 +186,13 @@ void SceneviewScene::loadPhongShader() {
     m_phongShader = std::make_unique<CS123Shader>(vertexSource, fragmentSource);
 }
 
+/** The picking shader draws the same geometry as the Phong shader but writes IDs */
+void SceneviewScene::loadPickShader() {
+    std::string vertexSource = ResourceLoader::loadResourceFileToString(":/shaders/default.vert");
+    std::string fragmentSource = ResourceLoader::loadResourceFileToString(":/shaders/picking.frag");
+    m_pickShader = std::make_unique<Shader>(vertexSource, fragmentSource);
+}
+
 void SceneviewScene::loadTerrainShader() {
     std::string vertexSource = ResourceLoader::loadResourceFileToString(":/shaders/shaders/shader-terr.vert");
     std::string fragmentSource = ResourceLoader::loadResourceFileToString(":/shaders/shaders/shader-terr.frag");
@@ -190,6 +260,16 @@ void SceneviewScene::setSceneUniforms(SupportCanvas3D *context) {
     m_phongShader->setUniform("isShapeScene", false);
     m_phongShader->setUniform("p" , camera->getProjectionMatrix());
     m_phongShader->setUniform("v", camera->getViewMatrix());
+    m_phongShader->setUniform("useInstanceTRS", false);
+    m_phongShader->setUniform("useInstanceMatrix", false);
+    setWindUniforms(m_phongShader.get());
+}
+
+void SceneviewScene::setWindUniforms(Shader *shader) {
+    shader->setUniform("useWind", false);
+    shader->setUniform("windPhase", windAngularFrequency * m_windClock.elapsed() / 1000.f);
+    shader->setUniform("windStrength", windStrength);
+    shader->setUniform("windDirection", glm::normalize(windDirection));
 }
 
 void SceneviewScene::setMatrixUniforms(Shader *shader, SupportCanvas3D *context) {
@@ -215,6 +295,69 @@ void SceneviewScene::tessellateShapes() {
     m_leaf = std::make_unique<Leaf>();
     m_fruit = std::make_unique<Fruit>(shapesParam1, shapesParam2);
     m_trunk = std::make_unique<Trunk>(shapesParam1, shapesParam2);
+
+    // Fruit are drawn instanced, with a translation/scale vec4 and an orientation quaternion
+    // per fruit rather than a full matrix
+    const int instanceStride = sizeof(FruitInstanceData);
+    std::vector<VBOAttribMarker> instanceMarkers;
+    instanceMarkers.push_back(VBOAttribMarker(ShaderAttrib::INSTANCE_TRANSLATION_SCALE, 4, 0,
+                                              VBOAttribMarker::FLOAT, false, 1));
+    instanceMarkers.push_back(VBOAttribMarker(ShaderAttrib::INSTANCE_ORIENTATION, 4,
+                                              offsetof(FruitInstanceData, orientation),
+                                              VBOAttribMarker::FLOAT, false, 1));
+    static_assert(sizeof(FruitInstanceData) == 8 * sizeof(float),
+                  "FruitInstanceData must be tightly packed for upload");
+    m_fruitInstanceVBO = std::make_unique<VBO>(nullptr, 0, instanceMarkers,
+                                               VBO::LAYOUT_TRIANGLES, VBO::USAGE_DYNAMIC);
+    m_fruit->setInstanceBuffer(*m_fruitInstanceVBO);
+    m_fruitInstancesDirty = true;
+
+    // Hanging fruit sway with their branch, from a second per-instance buffer
+    std::vector<VBOAttribMarker> swayMarkers;
+    swayMarkers.push_back(VBOAttribMarker(ShaderAttrib::INSTANCE_SWAY_COS, 4, 0,
+                                          VBOAttribMarker::FLOAT, false, 1));
+    swayMarkers.push_back(VBOAttribMarker(ShaderAttrib::INSTANCE_SWAY_SIN, 4,
+                                          offsetof(SwayInstanceData, sinTerms),
+                                          VBOAttribMarker::FLOAT, false, 1));
+    static_assert(sizeof(SwayInstanceData) == 8 * sizeof(float),
+                  "SwayInstanceData must be tightly packed for upload");
+    m_fruitSwayVBO = std::make_unique<VBO>(nullptr, 0, swayMarkers,
+                                           VBO::LAYOUT_TRIANGLES, VBO::USAGE_DYNAMIC);
+    m_fruit->setInstanceBuffer(*m_fruitSwayVBO);
+    m_fruitSwayDirty = true;
+
+    // Trunk and leaves carry a full model matrix along with their sway
+    std::vector<VBOAttribMarker> treeMarkers;
+    const GLuint modelRows[3] = { ShaderAttrib::INSTANCE_MODEL_ROW0, ShaderAttrib::INSTANCE_MODEL_ROW1,
+                                  ShaderAttrib::INSTANCE_MODEL_ROW2 };
+    for (int row = 0; row < 3; row++) {
+        treeMarkers.push_back(VBOAttribMarker(modelRows[row], 4, row * sizeof(glm::vec4),
+                                              VBOAttribMarker::FLOAT, false, 1));
+    }
+    treeMarkers.push_back(VBOAttribMarker(ShaderAttrib::INSTANCE_SWAY_COS, 4,
+                                          offsetof(TreeInstanceData, sway),
+                                          VBOAttribMarker::FLOAT, false, 1));
+    treeMarkers.push_back(VBOAttribMarker(ShaderAttrib::INSTANCE_SWAY_SIN, 4,
+                                          offsetof(TreeInstanceData, sway) + offsetof(SwayInstanceData, sinTerms),
+                                          VBOAttribMarker::FLOAT, false, 1));
+    static_assert(sizeof(TreeInstanceData) == 20 * sizeof(float),
+                  "TreeInstanceData must be tightly packed for upload");
+    m_trunkInstanceVBO = std::make_unique<VBO>(nullptr, 0, treeMarkers,
+                                               VBO::LAYOUT_TRIANGLES, VBO::USAGE_STATIC);
+    m_leafInstanceVBO = std::make_unique<VBO>(nullptr, 0, treeMarkers,
+                                              VBO::LAYOUT_TRIANGLES, VBO::USAGE_STATIC);
+    m_trunk->setInstanceBuffer(*m_trunkInstanceVBO);
+    m_leaf->setInstanceBuffer(*m_leafInstanceVBO);
+    m_treeInstancesDirty = true;
+}
+
+/** Upload the trunk and leaf instances of a new tree */
+void SceneviewScene::uploadTreeInstances() {
+    m_trunkInstanceVBO->update(reinterpret_cast<const float *>(m_trunkInstanceData.data()),
+                               m_trunkInstanceData.size() * sizeof(TreeInstanceData) / sizeof(float));
+    m_leafInstanceVBO->update(reinterpret_cast<const float *>(m_leafInstanceData.data()),
+                              m_leafInstanceData.size() * sizeof(TreeInstanceData) / sizeof(float));
+    m_treeInstancesDirty = false;
 }
 
 void SceneviewScene::renderGeometry() {
@@ -228,35 +371,108 @@ void SceneviewScene::renderGeometry() {
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
     for (int i = 0; i < m_primitives.size(); i++) {
+        PrimitiveType type = m_primitives[i].type;
+        if (type == PrimitiveType::PRIMITIVE_FRUIT || type == PrimitiveType::PRIMITIVE_TRUNK
+                || type == PrimitiveType::PRIMITIVE_LEAF) {
+            // Tree parts are drawn instanced in renderTree() and renderFruit()
+            continue;
+        }
         glm::mat4 ctm = m_matrices[i];
         // Set model (object -> world) matrix uniform on GPU
         m_phongShader->setUniform("m", ctm);
         // Set object material
         m_phongShader->applyMaterial(m_primitives[i].material);
         // Draw the shape
-        CS123ScenePrimitive primitive = m_primitives[i];
-        if (primitive.type == PrimitiveType::PRIMITIVE_TRUNK) {
-            m_trunk->draw();
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_LEAF) {
-            m_leaf->draw();
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_FRUIT) {
-            int cur_idx = i - m_fruitOffset;
-
-            glm::mat4 new_trans = m_fruitPhysics[cur_idx]->updatePosition(m_terrain);
-            ctm = new_trans * ctm;
-            m_matrices[i] = ctm;
-            m_phongShader->setUniform("m", ctm);
-            m_fruit->draw();
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_CONE) {
-            m_cone->draw();
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_CYLINDER) {
-            m_cylinder->draw();
-        } else if (primitive.type == PrimitiveType::PRIMITIVE_CUBE) {
-            m_cube->draw();
-        } else {
-            m_sphere->draw();
+        drawShape(type);
+    }
+
+    renderTree();
+    renderFruit();
+}
+
+/** Draw the tessellated shape for a non-tree primitive type */
+void SceneviewScene::drawShape(PrimitiveType type) {
+    if (type == PrimitiveType::PRIMITIVE_CONE) {
+        m_cone->draw();
+    } else if (type == PrimitiveType::PRIMITIVE_CYLINDER) {
+        m_cylinder->draw();
+    } else if (type == PrimitiveType::PRIMITIVE_CUBE) {
+        m_cube->draw();
+    } else {
+        m_sphere->draw();
+    }
+}
+
+/** Draw the trunk and the leaves with one instanced, wind-animated draw call each */
+void SceneviewScene::renderTree() {
+    if (m_treeInstancesDirty) {
+        uploadTreeInstances();
+    }
+
+    m_phongShader->setUniform("useInstanceMatrix", true);
+    m_phongShader->setUniform("useWind", true);
+    m_phongShader->applyMaterial(m_trunkMaterial);
+    m_trunk->drawInstanced(m_trunkInstanceData.size());
+    m_phongShader->applyMaterial(m_leafMaterial);
+    m_leaf->drawInstanced(m_leafInstanceData.size());
+    m_phongShader->setUniform("useInstanceMatrix", false);
+    m_phongShader->setUniform("useWind", false);
+}
+
+/** Step the physics of every fruit and keep the fruit CTMs and picking hierarchy in sync */
+void SceneviewScene::updateFruitPhysics() {
+    bool anyMoved = false;
+    for (int i = 0; i < m_fruitPhysics.size(); i++) {
+        if (m_fruitPhysics[i]->updatePosition(*m_terrain)) {
+            anyMoved = true;
+            m_matrices[m_fruitOffset + i] = m_fruitPhysics[i]->getTransform();
+            m_fruitInstancesDirty = true;
+            // A falling fruit no longer sways with its branch
+            if (m_fruitSway[i].isSwaying()) {
+                m_fruitSway[i] = SwayInstanceData();
+                m_fruitSwayDirty = true;
+            }
         }
     }
+    if (anyMoved) {
+        updateFruitBounds();
+        m_fruitBVH.refit(m_fruitBounds);
+    }
+}
+
+/** Draw all fruit in a single instanced draw call */
+void SceneviewScene::renderFruit() {
+    updateFruitPhysics();
+    if (m_fruitPhysics.empty()) {
+        return;
+    }
+    uploadFruitInstances();
+
+    // Every fruit shares the fruit material
+    m_phongShader->applyMaterial(m_primitives[m_fruitOffset].material);
+    m_phongShader->setUniform("useInstanceTRS", true);
+    m_phongShader->setUniform("useWind", true);
+    m_fruit->drawInstanced(m_fruitPhysics.size());
+    m_phongShader->setUniform("useInstanceTRS", false);
+    m_phongShader->setUniform("useWind", false);
+}
+
+/** Re-upload fruit transforms and sway if any changed since the last upload */
+void SceneviewScene::uploadFruitInstances() {
+    if (m_fruitInstancesDirty) {
+        m_fruitInstanceData.resize(m_fruitPhysics.size());
+        for (int i = 0; i < m_fruitPhysics.size(); i++) {
+            m_fruitInstanceData[i] = m_fruitPhysics[i]->getInstanceData();
+        }
+        m_fruitInstanceVBO->update(reinterpret_cast<const float *>(m_fruitInstanceData.data()),
+                                   m_fruitInstanceData.size() * sizeof(FruitInstanceData) / sizeof(float));
+        m_fruitInstancesDirty = false;
+    }
+    if (m_fruitSwayDirty) {
+        m_fruitSwayVBO->update(reinterpret_cast<const float *>(m_fruitSway.data()),
+                               m_fruitSway.size() * sizeof(SwayInstanceData) / sizeof(float));
+        m_fruitSwayDirty = false;
+    }
 }
 
 void SceneviewScene::keyPressed(SupportCanvas3D *canvas, CS123SceneCameraData *camera, int col, int row){
@@ -294,27 +510,25 @@ glm::vec3 getRayCameraDirection(float widthAngle, float heightAngle,
     return glm::normalize(viewPlanePoint);
 }
 
+/** Find the nearest fruit along a world space ray using the fruit hierarchy */
 IntersectionWithPrimitive SceneviewScene::rayObjectIntersection(Ray ray) {
-    std::vector<IntersectionWithPrimitive> intersections;
-    for (int i = m_fruitOffset; i < m_primitives.size(); i++) {
-        // Cumulative transformation matrix
-        glm::mat4 ctm = m_matrices[i];
-        glm::mat4 inverseCtm = glm::inverse(ctm);
-        // Convert to object space using inverse of the CTM
-        glm::vec3 objectSpaceDirection = glm::mat3(inverseCtm) * ray.direction;
-        glm::vec3 objectSpaceEye = glm::vec3(inverseCtm * glm::vec4(ray.startPoint, 1.0f));
-        Ray objectSpaceRay = Ray(objectSpaceEye, objectSpaceDirection);
-        // Check for intersection
-        CS123ScenePrimitive primitive = m_primitives[i];
-        if (primitive.type == PrimitiveType::PRIMITIVE_FRUIT) {
-            Intersection intersection = m_implicitSphere->intersect(objectSpaceRay);
-            UV uv = m_implicitSphere->mapToUV(intersection.objectSpacePos);
-            intersections.push_back(IntersectionWithPrimitive(intersection, i, uv));
-        }
+    float t;
+    int fruit = m_fruitBVH.intersect(ray, t);
+    if (fruit < 0) {
+        return IntersectionWithPrimitive();
+    }
+    // The terrain hides fruit behind it, as it does for GPU picking
+    float tTerrain = m_heightfield->intersectT(ray);
+    if (tTerrain >= 0 && tTerrain < t) {
+        return IntersectionWithPrimitive();
     }
-    IntersectionWithPrimitive nearestIntersection =
-            m_implicitShape->nearestIntersectionWithPrimitive(intersections);
-    return nearestIntersection;
+    // Only the fruit that was hit needs its object space hit point
+    int primitiveIndex = m_fruitOffset + fruit;
+    glm::mat4 inverseCtm = glm::inverse(m_matrices[primitiveIndex]);
+    glm::vec3 objectSpacePos = glm::vec3(inverseCtm * glm::vec4(pointAlongRay(ray, t), 1.0f));
+    Intersection intersection(t, objectSpacePos, glm::normalize(objectSpacePos));
+    return IntersectionWithPrimitive(intersection, primitiveIndex,
+                                     m_implicitSphere->mapToUV(objectSpacePos));
 }
 
 /**
@@ -342,6 +556,10 @@ int SceneviewScene::traceRay(Ray ray) {
  */
 void SceneviewScene::pickFruit(SupportCanvas3D *canvas, CS123SceneCameraData *camera, int col, int row) {
 
+    if (settings.useGPUPicking) {
+        dropPickedFruit(pickFruitFromIds(canvas, col, row));
+        return;
+    }
 
     // Convert degrees to radians
     float aspectRatio = static_cast<float>(canvas->width()) / canvas->height();
@@ -362,11 +580,98 @@ void SceneviewScene::pickFruit(SupportCanvas3D *canvas, CS123SceneCameraData *ca
     int found_fruit = traceRay(Ray(cameraPos, worldSpaceDirection));
 
     if (found_fruit > -1){
-        if (!m_fruitPhysics[found_fruit - m_fruitOffset]->m_isRolling){
-            m_fruitPhysics[found_fruit - m_fruitOffset]->m_isFalling = true;
+        dropPickedFruit(found_fruit - m_fruitOffset);
+    }
+
+}
+
+/** Start a picked fruit falling, if it is still hanging. Takes an index into the fruit, or -1. */
+void SceneviewScene::dropPickedFruit(int fruit) {
+    if (fruit >= 0 && fruit < m_fruitPhysics.size() && !m_fruitPhysics[fruit]->m_isRolling) {
+        m_fruitPhysics[fruit]->m_isFalling = true;
+    }
+}
+
+/**
+ *  Render the IDs of everything visible into the picking FBO and read back the pixel under
+ *  the cursor. Leaves, branches and terrain are drawn as occluders, so only a fruit that is
+ *  actually visible can be picked. Returns the index of the fruit, or -1.
+ */
+int SceneviewScene::pickFruitFromIds(SupportCanvas3D *canvas, int col, int row) {
+    if (m_fruitPhysics.empty()) {
+        return -1;
+    }
+    canvas->makeCurrent();
+
+    int width = canvas->width();
+    int height = canvas->height();
+    if (!m_pickFBO || m_pickFBO->width() != width || m_pickFBO->height() != height) {
+        m_pickFBO = std::make_unique<FBO>(1, FBO::DEPTH_STENCIL_ATTACHMENT::DEPTH_ONLY, width, height,
+                                          TextureParameters::WRAP_METHOD::CLAMP_TO_EDGE,
+                                          TextureParameters::FILTER_METHOD::NEAREST, GL_UNSIGNED_INT);
+    }
+
+    GLint previousFramebuffer;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    m_pickFBO->bind();
+    const GLuint clearId[4] = { noPickId, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, clearId);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    renderPickIds(canvas);
+    GLuint id = m_pickFBO->readUnsignedInt(0, col, height - 1 - row);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+    if (id < firstFruitPickId || id - firstFruitPickId >= m_fruitPhysics.size()) {
+        return -1;
+    }
+    return id - firstFruitPickId;
+}
+
+/** Draw the scene with the picking shader, using the same transforms and wind as render() */
+void SceneviewScene::renderPickIds(SupportCanvas3D *context) {
+    Camera *camera = context->getCamera();
+    m_pickShader->bind();
+    m_pickShader->setUniform("p", camera->getProjectionMatrix());
+    m_pickShader->setUniform("v", camera->getViewMatrix());
+    m_pickShader->setUniform("useArrowOffsets", false);
+    m_pickShader->setUniform("useInstanceTRS", false);
+    m_pickShader->setUniform("useInstanceMatrix", false);
+    setWindUniforms(m_pickShader.get());
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // Everything other than fruit only occludes
+    m_pickShader->setUniform("pickIdBase", static_cast<int>(occluderPickId));
+    for (int i = 0; i < m_primitives.size(); i++) {
+        PrimitiveType type = m_primitives[i].type;
+        if (type == PrimitiveType::PRIMITIVE_FRUIT || type == PrimitiveType::PRIMITIVE_TRUNK
+                || type == PrimitiveType::PRIMITIVE_LEAF) {
+            continue;
         }
+        m_pickShader->setUniform("m", m_matrices[i]);
+        drawShape(type);
     }
+    m_pickShader->setUniform("m", glm::mat4(1.f));
+    m_terrain->openGLShape->draw();
 
+    m_pickShader->setUniform("useInstanceMatrix", true);
+    m_pickShader->setUniform("useWind", true);
+    m_trunk->drawInstanced(m_trunkInstanceData.size());
+    m_leaf->drawInstanced(m_leafInstanceData.size());
+    m_pickShader->setUniform("useInstanceMatrix", false);
+
+    // Fruit i writes firstFruitPickId + i
+    uploadFruitInstances();
+    m_pickShader->setUniform("pickIdBase", static_cast<int>(firstFruitPickId));
+    m_pickShader->setUniform("useInstanceTRS", true);
+    m_fruit->drawInstanced(m_fruitPhysics.size());
+    m_pickShader->setUniform("useInstanceTRS", false);
+    m_pickShader->setUniform("useWind", false);
+    m_pickShader->unbind();
 }
 
 void SceneviewScene::dropFruit(){
@@ -18,6 +18,7 @@
 #include "RayGeometry.h"
 #include "scenegraph/ImplicitSphere.h"
 #include "scenegraph/ImplicitShape.h"
+#include "scenegraph/SphereBVH.h"
 
 #include <memory>
 
@@ -25,11 +26,34 @@
 const int shapesParam1 = 10;
 const int shapesParam2 = 10;
 
+// Wind sway: angular frequency in radians per second, strength, and horizontal direction
+const float windAngularFrequency = 1.7f;
+const float windStrength = 1.f;
+const glm::vec3 windDirection = glm::vec3(0.8f, 0.f, 0.6f);
+
+// IDs written by the picking pass: the background, anything that can hide a fruit, and then
+// one ID per fruit starting at firstFruitPickId
+const unsigned int noPickId = 0;
+const unsigned int occluderPickId = 1;
+const unsigned int firstFruitPickId = 2;
+
+/**
+ *  Per-instance data for the static tree parts (trunk and leaves): the rows of an affine
+ *  model matrix and the wind sway of the part's parent chain. Uploaded once per tree, so the
+ *  sway animation costs no per-frame CPU work.
+ */
+struct TreeInstanceData {
+    glm::vec4 modelRows[3];
+    SwayInstanceData sway;
+};
+
 namespace CS123 { namespace GL {
 
     class Shader;
     class CS123Shader;
     class Texture2D;
+    class VBO;
+    class FBO;
 }}
 
 /**
@@ -67,6 +91,7 @@ private:
     std::unique_ptr<MeshGenerator> m_treeGenerator;
     void updateSceneFromTree();    
     void initializeTreeScene();
+    void defineHeightfield();
     void defineLights();
     void defineGlobalData();
     int m_recursionDepth;
@@ -76,6 +101,7 @@ private:
 
     void loadPhongShader();
     void loadTerrainShader();
+    void loadPickShader();
     void loadWireframeShader();
     void loadNormalsShader();
     void loadNormalsArrowShader();
@@ -84,18 +110,32 @@ private:
     void setSceneUniforms(SupportCanvas3D *context);
     void setMatrixUniforms(CS123::GL::Shader *shader, SupportCanvas3D *context);
     void setLightsInShader();
+    void setWindUniforms(CS123::GL::Shader *shader);
     void renderGeometry();
+    void renderTree();
+    void renderFruit();
+    void uploadFruitInstances();
+    void drawShape(PrimitiveType type);
+    void updateFruitPhysics();
+    void updateFruitBounds();
     void tessellateShapes();
+    void uploadTreeInstances();
 
     IntersectionWithPrimitive rayObjectIntersection(Ray ray);
     int traceRay(Ray ray);
     void pickFruit(SupportCanvas3D *canvas, CS123SceneCameraData *camera, int col, int row);
+    int pickFruitFromIds(SupportCanvas3D *canvas, int col, int row);
+    void renderPickIds(SupportCanvas3D *context);
+    void dropPickedFruit(int fruit);
 
     std::unique_ptr<CS123::GL::CS123Shader> m_phongShader;
     std::unique_ptr<CS123::GL::Shader> m_wireframeShader;
     std::unique_ptr<CS123::GL::Shader> m_normalsShader;
     std::unique_ptr<CS123::GL::Shader> m_normalsArrowShader;
     std::unique_ptr<CS123::GL::Shader> m_terrainShader;
+    std::unique_ptr<CS123::GL::Shader> m_pickShader;
+    // Integer ID buffer for GPU picking, created on the first GPU pick
+    std::unique_ptr<CS123::GL::FBO> m_pickFBO;
 
     std::unique_ptr<Cube> m_cube;
     std::unique_ptr<Sphere> m_sphere;
@@ -109,9 +149,33 @@ private:
     std::unique_ptr<ImplicitSphere> m_implicitSphere;
 
     std::vector<std::unique_ptr<FruitTransformation>> m_fruitPhysics;
+    // World space bounding spheres of the fruit and a hierarchy over them for picking
+    std::vector<BoundingSphere> m_fruitBounds;
+    SphereBVH m_fruitBVH;
     int m_fruitOffset;
     int m_fruit_index;
 
+    // Per-instance fruit transforms, re-uploaded only when a fruit has moved
+    std::vector<FruitInstanceData> m_fruitInstanceData;
+    std::unique_ptr<CS123::GL::VBO> m_fruitInstanceVBO;
+    bool m_fruitInstancesDirty;
+
+    // Per-instance trunk and leaf transforms and sway, uploaded once per tree
+    std::vector<TreeInstanceData> m_trunkInstanceData;
+    std::vector<TreeInstanceData> m_leafInstanceData;
+    std::unique_ptr<CS123::GL::VBO> m_trunkInstanceVBO;
+    std::unique_ptr<CS123::GL::VBO> m_leafInstanceVBO;
+    CS123SceneMaterial m_trunkMaterial;
+    CS123SceneMaterial m_leafMaterial;
+    bool m_treeInstancesDirty;
+
+    // Fruit sway while they hang from the tree, cleared once they start to fall
+    std::vector<SwayInstanceData> m_fruitSway;
+    std::unique_ptr<CS123::GL::VBO> m_fruitSwayVBO;
+    bool m_fruitSwayDirty;
+
+    QTime m_windClock;
+
     bool m_shapesTessellated;
 };
 
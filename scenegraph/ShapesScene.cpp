@@ -1,5 +1,6 @@
 #include "ShapesScene.h"
 #include "Camera.h"
+#include "SupportCanvas3D.h"
 #include "shapes/OpenGLShape.h"
 #include <SupportCanvas3D.h>
 #include <QFileDialog>
@@ -0,0 +1,200 @@
+#include "SphereBVH.h"
+
+#include <algorithm>
+
+// Largest number of spheres stored in one leaf
+const int maxLeafSize = 4;
+// Traversal stack size; a median split tree over any realistic sphere count is far shallower
+const int maxTraversalDepth = 64;
+// Rebuild instead of refitting once the root has grown by this factor in surface area
+const float rebuildSurfaceAreaRatio = 2.f;
+
+SphereBVH::SphereBVH() :
+    m_builtSurfaceArea(0.f)
+{
+}
+
+/** Build the hierarchy top-down, splitting at the median centroid along the longest axis */
+void SphereBVH::build(const std::vector<BoundingSphere> &spheres) {
+    m_spheres = spheres;
+    m_nodes.clear();
+    m_order.resize(spheres.size());
+    for (int i = 0; i < m_order.size(); i++) {
+        m_order[i] = i;
+    }
+    if (!m_spheres.empty()) {
+        m_nodes.reserve(2 * m_spheres.size() / maxLeafSize + 1);
+        buildRecursive(0, m_order.size());
+    }
+    m_builtSurfaceArea = rootSurfaceArea();
+}
+
+int SphereBVH::buildRecursive(int begin, int end) {
+    int nodeIndex = m_nodes.size();
+    m_nodes.push_back(Node());
+
+    if (end - begin <= maxLeafSize) {
+        m_nodes[nodeIndex].offset = begin;
+        m_nodes[nodeIndex].count = end - begin;
+        fitLeaf(m_nodes[nodeIndex]);
+        return nodeIndex;
+    }
+
+    glm::vec3 centroidMin = glm::vec3(INFINITY);
+    glm::vec3 centroidMax = glm::vec3(-INFINITY);
+    for (int i = begin; i < end; i++) {
+        centroidMin = glm::min(centroidMin, m_spheres[m_order[i]].center);
+        centroidMax = glm::max(centroidMax, m_spheres[m_order[i]].center);
+    }
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    int middle = (begin + end) / 2;
+    std::nth_element(m_order.begin() + begin, m_order.begin() + middle, m_order.begin() + end,
+                     [this, axis](int a, int b) {
+        return m_spheres[a].center[axis] < m_spheres[b].center[axis];
+    });
+
+    int left = buildRecursive(begin, middle);
+    int right = buildRecursive(middle, end);
+    Node &node = m_nodes[nodeIndex];
+    node.offset = right;
+    node.count = 0;
+    node.boundsMin = glm::min(m_nodes[left].boundsMin, m_nodes[right].boundsMin);
+    node.boundsMax = glm::max(m_nodes[left].boundsMax, m_nodes[right].boundsMax);
+    return nodeIndex;
+}
+
+void SphereBVH::fitLeaf(Node &node) const {
+    node.boundsMin = glm::vec3(INFINITY);
+    node.boundsMax = glm::vec3(-INFINITY);
+    for (int i = node.offset; i < node.offset + node.count; i++) {
+        const BoundingSphere &sphere = m_spheres[m_order[i]];
+        node.boundsMin = glm::min(node.boundsMin, sphere.center - glm::vec3(sphere.radius));
+        node.boundsMax = glm::max(node.boundsMax, sphere.center + glm::vec3(sphere.radius));
+    }
+}
+
+float SphereBVH::rootSurfaceArea() const {
+    if (m_nodes.empty()) {
+        return 0.f;
+    }
+    glm::vec3 extent = m_nodes[0].boundsMax - m_nodes[0].boundsMin;
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+/**
+ *  Update every node's bounds for the spheres' new positions. Nodes are stored in depth-first
+ *  order, so walking them backwards visits both children before their parent.
+ */
+void SphereBVH::refit(const std::vector<BoundingSphere> &spheres) {
+    if (spheres.size() != m_spheres.size()) {
+        build(spheres);
+        return;
+    }
+    m_spheres = spheres;
+    for (int i = m_nodes.size() - 1; i >= 0; i--) {
+        Node &node = m_nodes[i];
+        if (node.count > 0) {
+            fitLeaf(node);
+        } else {
+            node.boundsMin = glm::min(m_nodes[i + 1].boundsMin, m_nodes[node.offset].boundsMin);
+            node.boundsMax = glm::max(m_nodes[i + 1].boundsMax, m_nodes[node.offset].boundsMax);
+        }
+    }
+    // Fruit that fell far from where they hung stretch the old topology; start over
+    if (rootSurfaceArea() > rebuildSurfaceAreaRatio * m_builtSurfaceArea) {
+        build(spheres);
+    }
+}
+
+/** Slab test, returning the entry t of the ray into the box or INFINITY if it misses */
+static float intersectBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                          const glm::vec3 &origin, const glm::vec3 &inverseDirection, float tMax) {
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return tEnter <= tExit ? tEnter : INFINITY;
+}
+
+/** Nearest t >= EPSILON where the ray hits the sphere, or INFINITY */
+static float intersectSphere(const BoundingSphere &sphere, const Ray &ray) {
+    glm::vec3 oc = ray.startPoint - sphere.center;
+    float a = glm::dot(ray.direction, ray.direction);
+    float b = glm::dot(oc, ray.direction);
+    float c = glm::dot(oc, oc) - sphere.radius * sphere.radius;
+    float discriminant = b * b - a * c;
+    if (discriminant < 0) {
+        return INFINITY;
+    }
+    float root = sqrt(discriminant);
+    float t = (-b - root) / a;
+    if (t < EPSILON) {
+        t = (-b + root) / a;
+    }
+    return t >= EPSILON ? t : INFINITY;
+}
+
+/** Closest-hit traversal, visiting the nearer child first and culling by the best t so far */
+int SphereBVH::intersect(const Ray &ray, float &tHit) const {
+    if (m_nodes.empty()) {
+        return -1;
+    }
+    glm::vec3 inverseDirection = 1.f / ray.direction;
+    float tBest = INFINITY;
+    int hit = -1;
+
+    int stack[maxTraversalDepth];
+    int stackSize = 0;
+    if (intersectBox(m_nodes[0].boundsMin, m_nodes[0].boundsMax,
+                     ray.startPoint, inverseDirection, tBest) == INFINITY) {
+        return -1;
+    }
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const Node &node = m_nodes[stack[--stackSize]];
+        if (node.count > 0) {
+            for (int i = node.offset; i < node.offset + node.count; i++) {
+                float t = intersectSphere(m_spheres[m_order[i]], ray);
+                if (t < tBest) {
+                    tBest = t;
+                    hit = m_order[i];
+                }
+            }
+            continue;
+        }
+
+        int left = &node - m_nodes.data() + 1;
+        int right = node.offset;
+        float tLeft = intersectBox(m_nodes[left].boundsMin, m_nodes[left].boundsMax,
+                                   ray.startPoint, inverseDirection, tBest);
+        float tRight = intersectBox(m_nodes[right].boundsMin, m_nodes[right].boundsMax,
+                                    ray.startPoint, inverseDirection, tBest);
+        // Push the farther child first so the nearer one is popped next
+        if (tLeft > tRight) {
+            std::swap(left, right);
+            std::swap(tLeft, tRight);
+        }
+        if (tRight != INFINITY && stackSize < maxTraversalDepth) {
+            stack[stackSize++] = right;
+        }
+        if (tLeft != INFINITY && stackSize < maxTraversalDepth) {
+            stack[stackSize++] = left;
+        }
+    }
+
+    if (hit >= 0) {
+        tHit = tBest;
+    }
+    return hit;
+}
+
+int SphereBVH::size() const {
+    return m_spheres.size();
+}
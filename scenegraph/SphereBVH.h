@@ -0,0 +1,60 @@
+#ifndef SPHEREBVH_H
+#define SPHEREBVH_H
+
+#include "RayGeometry.h"
+
+#include <vector>
+
+/** A world space bounding sphere */
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+/**
+ * @class SphereBVH
+ *
+ * Bounding volume hierarchy over a set of spheres, used to pick fruit with the mouse. The
+ * topology is built once; when the spheres move, refit() updates the node bounds bottom-up in
+ * linear time, and the tree is only rebuilt if refitting has made it much looser. Queries
+ * use a fixed-size traversal stack and never allocate.
+ */
+class SphereBVH
+{
+public:
+    SphereBVH();
+
+    // Build a new hierarchy over the spheres, whose indices are returned by intersect()
+    void build(const std::vector<BoundingSphere> &spheres);
+    // Update bounds after the spheres have moved; the number of spheres must not change
+    void refit(const std::vector<BoundingSphere> &spheres);
+
+    // Index of the nearest sphere hit with t >= EPSILON, or -1. tHit is set on a hit.
+    int intersect(const Ray &ray, float &tHit) const;
+
+    int size() const;
+
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // Interior: index of the right child (the left child follows this node).
+        // Leaf: index of the first sphere in m_order.
+        int offset;
+        // Number of spheres in a leaf, 0 for interior nodes
+        int count;
+    };
+
+    int buildRecursive(int begin, int end);
+    void fitLeaf(Node &node) const;
+    float rootSurfaceArea() const;
+
+    std::vector<Node> m_nodes;
+    // Sphere indices, grouped so that every leaf covers a contiguous range
+    std::vector<int> m_order;
+    std::vector<BoundingSphere> m_spheres;
+    // Surface area of the root when the tree was built, to detect degraded refits
+    float m_builtSurfaceArea;
+};
+
+#endif // SPHEREBVH_H
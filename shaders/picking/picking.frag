@@ -0,0 +1,9 @@
+#version 330 core
+
+// Paired with shader.vert, so picked geometry matches what is drawn, including wind sway
+flat in uint pickId;
+out uint fragId;
+
+void main(){
+    fragId = pickId;
+}
@@ -3,10 +3,20 @@
 layout(location = 0) in vec3 position; // Position of the vertex
 layout(location = 1) in vec3 normal;   // Normal of the vertex
 layout(location = 5) in vec2 texCoord; // UV texture coordinates
+layout(location = 6) in vec4 instanceModelRow0; // Per-instance affine model matrix rows
+layout(location = 7) in vec4 instanceModelRow1;
+layout(location = 8) in vec4 instanceModelRow2;
 layout(location = 10) in float arrowOffset; // Sideways offset for billboarded normal arrows
+layout(location = 11) in vec4 instanceTranslationScale; // Per-instance position (xyz) and uniform scale (w)
+layout(location = 12) in vec4 instanceOrientation;      // Per-instance orientation quaternion (xyzw)
+layout(location = 13) in vec4 instanceSwayCos;          // Per-instance wind sway sums, see SwayInstanceData
+layout(location = 14) in vec4 instanceSwaySin;
 
 out vec3 color; // Computed color for this vertex
 out vec2 texc;
+flat out uint pickId; // ID written by the picking pass
+
+uniform int pickIdBase; // ID of the first instance in this draw call
 
 // global data
 uniform float ka;
@@ -17,6 +27,14 @@ uniform float ks;
 uniform mat4 p;
 uniform mat4 v;
 uniform mat4 m;
+uniform bool useInstanceTRS;     // Build the model matrix from per-instance attributes instead of m
+uniform bool useInstanceMatrix;  // Use the per-instance model matrix rows instead of m
+
+// Wind
+uniform bool useWind;          // Bend the instance by its per-instance sway sums
+uniform float windPhase;       // Angular frequency times time, shared by every branch
+uniform float windStrength;
+uniform vec3 windDirection;    // Unit horizontal direction the wind blows towards
 
 // Light data
 const int MAX_LIGHTS = 10;
@@ -37,14 +55,52 @@ uniform bool isShapeScene;
 uniform bool useLighting;     // Whether to calculate lighting using lighting equation
 uniform bool useArrowOffsets; // True if rendering the arrowhead of a normal for Shapes
 
+// Model matrix for a translation, unit quaternion rotation, and uniform scale
+mat4 modelFromTRS(vec4 translationScale, vec4 q) {
+    vec3 q2 = q.xyz * 2.0;
+    float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+    float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+    float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+    mat3 rotation = mat3(1.0 - (yy + zz), xy + wz, xz - wy,
+                         xy - wz, 1.0 - (xx + zz), yz + wx,
+                         xz + wy, yz - wx, 1.0 - (xx + yy));
+    mat3 scaledRotation = rotation * translationScale.w;
+    return mat4(vec4(scaledRotation[0], 0), vec4(scaledRotation[1], 0), vec4(scaledRotation[2], 0),
+                vec4(translationScale.xyz, 1));
+}
+
+// Displacement of a world space point swaying with every branch in its parent chain. Each
+// branch k rotates by A_k sin(windPhase + phi_k) about its pivot p_k; the instance carries
+// the sums of A_k cos(phi_k) (p_k, 1) and A_k sin(phi_k) (p_k, 1).
+vec3 windOffset(vec3 p_worldSpace, vec4 swayCos, vec4 swaySin) {
+    float s = sin(windPhase);
+    float c = cos(windPhase);
+    float angle = s * swayCos.w + c * swaySin.w;
+    vec3 anglePivot = s * swayCos.xyz + c * swaySin.xyz;
+    vec3 axis = cross(vec3(0, 1, 0), windDirection);
+    return windStrength * cross(axis, angle * p_worldSpace - anglePivot);
+}
+
 void main() {
     texc = texCoord * repeatUV;
+    pickId = uint(pickIdBase + gl_InstanceID);
+
+    mat4 model = m;
+    if (useInstanceTRS) {
+        model = modelFromTRS(instanceTranslationScale, instanceOrientation);
+    } else if (useInstanceMatrix) {
+        model = transpose(mat4(instanceModelRow0, instanceModelRow1, instanceModelRow2, vec4(0, 0, 0, 1)));
+    }
+
+    vec4 position_worldSpace = model * vec4(position, 1.0);
+    if (useWind) {
+        position_worldSpace.xyz += windOffset(position_worldSpace.xyz, instanceSwayCos, instanceSwaySin);
+    }
 
-    vec4 position_cameraSpace = v * m * vec4(position, 1.0);
-    vec4 normal_cameraSpace = vec4(normalize(mat3(transpose(inverse(v * m))) * normal), 0);
+    vec4 position_cameraSpace = v * position_worldSpace;
+    vec4 normal_cameraSpace = vec4(normalize(mat3(transpose(inverse(v * model))) * normal), 0);
 
-    vec4 position_worldSpace = m * vec4(position, 1.0);
-    vec4 normal_worldSpace = vec4(normalize(mat3(transpose(inverse(m))) * normal), 0);
+    vec4 normal_worldSpace = vec4(normalize(mat3(transpose(inverse(model))) * normal), 0);
 
     if (useArrowOffsets) {
         // Figure out the axis to use in order for the triangle to be billboarded correctly
@@ -32,6 +32,20 @@ void OpenGLShape::draw() {
     }
 }
 
+void OpenGLShape::drawInstanced(int instanceCount) {
+    if (m_VAO && instanceCount > 0) {
+        m_VAO->bind();
+        m_VAO->drawInstanced(instanceCount);
+        m_VAO->unbind();
+    }
+}
+
+void OpenGLShape::setInstanceBuffer(const VBO &instanceBuffer) {
+    if (m_VAO) {
+        m_VAO->addInstanceBuffer(instanceBuffer);
+    }
+}
+
 void OpenGLShape::initializeOpenGLShapeProperties() {
     const int numFloatsPerVertex = 6;
     const int numVertices = m_vertexData.size() / numFloatsPerVertex;
@@ -22,6 +22,7 @@ inline void insertVec3(std::vector<float> &data, glm::vec3 v){
 
 namespace CS123 { namespace GL {
 class VAO;
+class VBO;
 }}
 
 class OpenGLShape
@@ -31,6 +32,10 @@ public:
     OpenGLShape(bool t_strip);
     virtual ~OpenGLShape();
     void draw();
+    void drawInstanced(int instanceCount);
+
+    // Attaches a VBO of per-instance attributes, used with drawInstanced()
+    void setInstanceBuffer(const CS123::GL::VBO &instanceBuffer);
 
     /**
      * initializes the relavant openGL properties for the shape
@@ -0,0 +1,66 @@
+#include "FruitSimulation.h"
+
+#include "glm/gtc/constants.hpp"
+#include "glm/gtx/transform.hpp"
+#include <random>
+
+// Fruit are spawned within this distance of the tree along x and z
+const float spawnExtent = 3.f;
+
+FruitSimulation::FruitSimulation() :
+    m_terrain(std::make_unique<Terrain>())
+{
+}
+
+/**
+ *  Spawn fruit from a seed. Positions, spins and initial velocities come from a seeded
+ *  generator rather than rand(), so the same seed always produces the same batch.
+ */
+void FruitSimulation::spawnFruit(unsigned int seed, int numFruit) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> horizontal(-spawnExtent, spawnExtent);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    m_fruit.reserve(m_fruit.size() + numFruit);
+    for (int i = 0; i < numFruit; i++) {
+        glm::vec3 pos = glm::vec3(horizontal(generator), 0.f, horizontal(generator));
+        pos.y = m_terrain->getHeightFromWorld(pos) + 1.f + 2.f * unit(generator);
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator))
+                                        + glm::vec3(0.01f));
+        float angle = 2.f * glm::pi<float>() * unit(generator);
+        addFruit(glm::translate(pos) * glm::rotate(angle, axis) * glm::scale(glm::vec3(fruit_radius)));
+
+        FruitTransformation &fruit = *m_fruit.back();
+        fruit.vel = glm::vec3(unit(generator) - 0.5f, 0.f, unit(generator) - 0.5f);
+        fruit.m_isFalling = true;
+    }
+}
+
+void FruitSimulation::addFruit(glm::mat4 startTransform) {
+    m_fruit.push_back(std::make_unique<FruitTransformation>(startTransform));
+}
+
+void FruitSimulation::clear() {
+    m_fruit.clear();
+}
+
+int FruitSimulation::step() {
+    int numMoved = 0;
+    for (std::unique_ptr<FruitTransformation> &fruit : m_fruit) {
+        if (fruit->updatePosition(*m_terrain)) {
+            numMoved++;
+        }
+    }
+    return numMoved;
+}
+
+int FruitSimulation::getNumFruit() const {
+    return m_fruit.size();
+}
+
+FruitTransformation &FruitSimulation::getFruit(int i) {
+    return *m_fruit[i];
+}
+
+const FruitTransformation &FruitSimulation::getFruit(int i) const {
+    return *m_fruit[i];
+}
@@ -0,0 +1,39 @@
+#ifndef FRUITSIMULATION_H
+#define FRUITSIMULATION_H
+
+#include "trees/terrain.h"
+#include "trees/FruitTransformation.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * @class FruitSimulation
+ *
+ * Fruit physics over the terrain without any OpenGL state, so the simulation can be stepped,
+ * recorded and benchmarked headlessly. Uses the same FruitTransformation::updatePosition step
+ * as SceneviewScene.
+ */
+class FruitSimulation
+{
+public:
+    FruitSimulation();
+
+    // Drop numFruit fruit at random positions and spins above the terrain, seeded for repeatability
+    void spawnFruit(unsigned int seed, int numFruit);
+    void addFruit(glm::mat4 startTransform);
+    void clear();
+
+    // Advance every fruit by one physics step, returning the number of fruit that moved
+    int step();
+
+    int getNumFruit() const;
+    FruitTransformation &getFruit(int i);
+    const FruitTransformation &getFruit(int i) const;
+
+private:
+    std::unique_ptr<Terrain> m_terrain;
+    std::vector<std::unique_ptr<FruitTransformation>> m_fruit;
+};
+
+#endif // FRUITSIMULATION_H
@@ -0,0 +1,155 @@
+#include "FruitTrace.h"
+#include "FruitSimulation.h"
+#include "FruitTransformation.h"
+
+#include <cstring>
+#include <iostream>
+
+// Size of one serialized FruitTraceState
+const size_t stateSize = 10 * sizeof(float) + sizeof(uint8_t);
+const char traceMagic[4] = { 'F', 'R', 'T', 'R' };
+
+void FruitTraceState::capture(const FruitTransformation &fruit) {
+    for (int i = 0; i < 3; i++) {
+        pos[i] = fruit.pos[i];
+        vel[i] = fruit.vel[i];
+    }
+    orientation[0] = fruit.orientation.x;
+    orientation[1] = fruit.orientation.y;
+    orientation[2] = fruit.orientation.z;
+    orientation[3] = fruit.orientation.w;
+    flags = (fruit.m_isFalling ? FALLING : 0) | (fruit.m_isRolling ? ROLLING : 0);
+}
+
+void FruitTraceState::restore(FruitTransformation &fruit) const {
+    fruit.pos = glm::vec3(pos[0], pos[1], pos[2]);
+    fruit.vel = glm::vec3(vel[0], vel[1], vel[2]);
+    fruit.orientation = glm::quat(orientation[3], orientation[0], orientation[1], orientation[2]);
+    fruit.m_isFalling = (flags & FALLING) != 0;
+    fruit.m_isRolling = (flags & ROLLING) != 0;
+}
+
+/** Bitwise comparison, so that -0.f and 0.f (or two NaNs) are told apart like in the file */
+bool FruitTraceState::operator==(const FruitTraceState &that) const {
+    return memcmp(pos, that.pos, sizeof(pos)) == 0
+            && memcmp(vel, that.vel, sizeof(vel)) == 0
+            && memcmp(orientation, that.orientation, sizeof(orientation)) == 0
+            && flags == that.flags;
+}
+
+static void serializeState(const FruitTraceState &state, char *out) {
+    memcpy(out, state.pos, sizeof(state.pos));
+    memcpy(out + 3 * sizeof(float), state.vel, sizeof(state.vel));
+    memcpy(out + 6 * sizeof(float), state.orientation, sizeof(state.orientation));
+    memcpy(out + 10 * sizeof(float), &state.flags, sizeof(state.flags));
+}
+
+static void deserializeState(const char *in, FruitTraceState &state) {
+    memcpy(state.pos, in, sizeof(state.pos));
+    memcpy(state.vel, in + 3 * sizeof(float), sizeof(state.vel));
+    memcpy(state.orientation, in + 6 * sizeof(float), sizeof(state.orientation));
+    memcpy(&state.flags, in + 10 * sizeof(float), sizeof(state.flags));
+}
+
+void captureFrame(const FruitSimulation &simulation, std::vector<FruitTraceState> &states) {
+    states.resize(simulation.getNumFruit());
+    for (int i = 0; i < simulation.getNumFruit(); i++) {
+        states[i].capture(simulation.getFruit(i));
+    }
+}
+
+void restoreFrame(FruitSimulation &simulation, const std::vector<FruitTraceState> &states) {
+    for (int i = 0; i < simulation.getNumFruit() && i < states.size(); i++) {
+        states[i].restore(simulation.getFruit(i));
+    }
+}
+
+
+FruitTraceWriter::FruitTraceWriter(const std::string &filename) :
+    m_filename(filename)
+{
+    memset(&m_header, 0, sizeof(FruitTraceHeader));
+}
+
+/** Open the trace file and write the header and per-fruit scales */
+bool FruitTraceWriter::begin(uint32_t seed, const FruitSimulation &simulation) {
+    m_file.open(m_filename, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        std::cerr << "could not open " << m_filename << " for writing" << std::endl;
+        return false;
+    }
+    m_header.version = fruitTraceVersion;
+    m_header.seed = seed;
+    m_header.numFruit = simulation.getNumFruit();
+    m_header.numFrames = 0;
+    m_file.write(traceMagic, sizeof(traceMagic));
+    m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(FruitTraceHeader));
+    for (int i = 0; i < simulation.getNumFruit(); i++) {
+        float scale = simulation.getFruit(i).scale;
+        m_file.write(reinterpret_cast<const char *>(&scale), sizeof(float));
+    }
+    m_frameBuffer.resize(m_header.numFruit * stateSize);
+    return m_file.good();
+}
+
+bool FruitTraceWriter::writeFrame(const FruitSimulation &simulation) {
+    FruitTraceState state;
+    for (int i = 0; i < simulation.getNumFruit(); i++) {
+        state.capture(simulation.getFruit(i));
+        serializeState(state, &m_frameBuffer[i * stateSize]);
+    }
+    m_file.write(m_frameBuffer.data(), m_frameBuffer.size());
+    m_header.numFrames++;
+    return m_file.good();
+}
+
+bool FruitTraceWriter::finish() {
+    m_file.seekp(sizeof(traceMagic));
+    m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(FruitTraceHeader));
+    m_file.close();
+    return !m_file.fail();
+}
+
+
+FruitTraceReader::FruitTraceReader(const std::string &filename) :
+    m_filename(filename)
+{
+    memset(&m_header, 0, sizeof(FruitTraceHeader));
+}
+
+/** Open the trace and read its header and per-fruit scales */
+bool FruitTraceReader::open() {
+    m_file.open(m_filename, std::ios::binary);
+    if (!m_file) {
+        std::cerr << "could not open " << m_filename << std::endl;
+        return false;
+    }
+    char magic[sizeof(traceMagic)];
+    m_file.read(magic, sizeof(magic));
+    m_file.read(reinterpret_cast<char *>(&m_header), sizeof(FruitTraceHeader));
+    if (!m_file || memcmp(magic, traceMagic, sizeof(magic)) != 0) {
+        std::cerr << m_filename << " is not a fruit trace" << std::endl;
+        return false;
+    }
+    if (m_header.version != fruitTraceVersion) {
+        std::cerr << m_filename << " has unsupported trace version " << m_header.version << std::endl;
+        return false;
+    }
+    m_scales.resize(m_header.numFruit);
+    m_file.read(reinterpret_cast<char *>(m_scales.data()), m_header.numFruit * sizeof(float));
+    m_frameBuffer.resize(m_header.numFruit * stateSize);
+    return m_file.good();
+}
+
+/** Read the next frame, returning false at the end of the trace */
+bool FruitTraceReader::readFrame(std::vector<FruitTraceState> &states) {
+    m_file.read(m_frameBuffer.data(), m_frameBuffer.size());
+    if (!m_file) {
+        return false;
+    }
+    states.resize(m_header.numFruit);
+    for (unsigned int i = 0; i < m_header.numFruit; i++) {
+        deserializeState(&m_frameBuffer[i * stateSize], states[i]);
+    }
+    return true;
+}
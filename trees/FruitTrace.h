@@ -0,0 +1,84 @@
+#ifndef FRUITTRACE_H
+#define FRUITTRACE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class FruitTransformation;
+class FruitSimulation;
+
+/**
+ *  The recorded state of one fruit for one frame: everything updatePosition() reads, so that
+ *  restoring a frame and stepping reproduces the next frame bit for bit. Serialized field by
+ *  field (41 bytes) so the file layout does not depend on struct padding.
+ */
+struct FruitTraceState {
+    float pos[3];
+    float vel[3];
+    float orientation[4];   // x, y, z, w
+    uint8_t flags;
+
+    static const uint8_t FALLING = 1;
+    static const uint8_t ROLLING = 2;
+
+    void capture(const FruitTransformation &fruit);
+    void restore(FruitTransformation &fruit) const;
+    bool operator==(const FruitTraceState &that) const;
+};
+
+/**
+ *  Binary trace layout:
+ *    header   "FRTR", version, seed, numFruit, numFrames (uint32 each)
+ *    scales   numFruit floats (constant per fruit)
+ *    frames   numFrames blocks of numFruit FruitTraceState records
+ *  Frame 0 is the state before the first step.
+ */
+struct FruitTraceHeader {
+    uint32_t version;
+    uint32_t seed;
+    uint32_t numFruit;
+    uint32_t numFrames;
+};
+
+const uint32_t fruitTraceVersion = 1;
+
+class FruitTraceWriter {
+public:
+    FruitTraceWriter(const std::string &filename);
+
+    bool begin(uint32_t seed, const FruitSimulation &simulation);
+    bool writeFrame(const FruitSimulation &simulation);
+    // Patches the frame count into the header and closes the file
+    bool finish();
+
+private:
+    std::ofstream m_file;
+    std::string m_filename;
+    FruitTraceHeader m_header;
+    std::vector<char> m_frameBuffer;
+};
+
+class FruitTraceReader {
+public:
+    FruitTraceReader(const std::string &filename);
+
+    bool open();
+    const FruitTraceHeader &getHeader() const { return m_header; }
+    const std::vector<float> &getScales() const { return m_scales; }
+    bool readFrame(std::vector<FruitTraceState> &states);
+
+private:
+    std::ifstream m_file;
+    std::string m_filename;
+    FruitTraceHeader m_header;
+    std::vector<float> m_scales;
+    std::vector<char> m_frameBuffer;
+};
+
+// Capture every fruit in the simulation, or restore every fruit from one frame
+void captureFrame(const FruitSimulation &simulation, std::vector<FruitTraceState> &states);
+void restoreFrame(FruitSimulation &simulation, const std::vector<FruitTraceState> &states);
+
+#endif // FRUITTRACE_H
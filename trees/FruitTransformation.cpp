@@ -1,28 +1,33 @@
 #include "FruitTransformation.h"
 #include <iostream>
 
-FruitTransformation::FruitTransformation(glm::vec3 start_pos) :
+/**
+ *  Decompose the fruit's starting CTM into position, orientation, and uniform scale,
+ *  which are integrated separately from then on so the transform never accumulates drift.
+ */
+FruitTransformation::FruitTransformation(glm::mat4 startTransform) :
     m_isFalling(false),
     m_isRolling(false),
-    pos(start_pos),
-    vel(glm::vec3(0.f))
+    pos(glm::vec3(startTransform[3])),
+    vel(glm::vec3(0.f)),
+    scale(glm::length(glm::vec3(startTransform[0])))
 {
-
-
-
+    orientation = glm::normalize(glm::quat_cast(glm::mat3(startTransform) / scale));
 }
 
 FruitTransformation::~FruitTransformation(){
 
 }
 
-glm::mat4 FruitTransformation::updatePosition(std::unique_ptr<Terrain> &terr){
+/**
+ *  Advance the fruit by one physics step over the terrain.
+ *  Returns whether the fruit moved, i.e. whether its transform needs to be re-uploaded.
+ */
+bool FruitTransformation::updatePosition(Terrain &terr){
 
     glm::vec3 new_pos;
-    glm::quat rot;
-    glm::mat4 transform = glm::mat4(1.f);
 
-    float ter_pos = terr->getHeightFromWorld(pos);
+    float ter_pos = terr.getHeightFromWorld(pos);
     glm::vec3 norm;
 
     if (m_isFalling){
@@ -32,7 +37,7 @@ glm::mat4 FruitTransformation::updatePosition(std::unique_ptr<Terrain> &terr){
         if (new_pos.y - 0.10 <= ter_pos){ // Add radius
 
             if (!m_isRolling){
-                norm = glm::normalize(terr->getNormalFromWorld(pos));
+                norm = glm::normalize(terr.getNormalFromWorld(pos));
                 glm::vec3 refl_vel = glm::reflect(vel, norm);
                 vel = 0.3f * refl_vel;
 
@@ -49,21 +54,15 @@ glm::mat4 FruitTransformation::updatePosition(std::unique_ptr<Terrain> &terr){
 
         glm::vec3 up = glm::vec3(0., 1., 0.);
         glm::vec3 down = -up;
-        norm = glm::normalize(terr->getNormalFromWorld(pos));
-
-        glm::vec3 rotAxis = glm::normalize(glm::cross(vel, norm));
-
-        rot = glm::angleAxis(glm::degrees(vel.length() * dt / fruit_radius), rotAxis);
-        // Not working for now
-        /*transform = glm::translate(transform, -pos);
-        transform = glm::toMat4(rot) * transform;
-        transform = glm::translate(transform, pos);*/
+        norm = glm::normalize(terr.getNormalFromWorld(pos));
 
         new_pos = pos + dt * vel;
         if (new_pos.y - 0.05 < ter_pos){
             new_pos.y = ter_pos + 0.05;
             vel.y = 0.001;
         }
+        integrateRolling(new_pos - pos, norm);
+
         glm::vec3 accel;
         if (new_pos.y - 0.16 > ter_pos){
             m_isFalling = true;
@@ -85,10 +84,40 @@ glm::mat4 FruitTransformation::updatePosition(std::unique_ptr<Terrain> &terr){
 
 
     } else {
-        return glm::mat4(1.0f);
+        return false;
     }
 
-    transform = glm::translate(transform, new_pos - pos);
     pos = new_pos;
-    return transform;
+    return true;
+}
+
+/**
+ *  Roll the fruit without slipping: the tangential part of the displacement turns the
+ *  fruit about the axis perpendicular to both the motion and the contact normal.
+ */
+void FruitTransformation::integrateRolling(glm::vec3 displacement, glm::vec3 norm) {
+    glm::vec3 tangent = displacement - glm::dot(displacement, norm) * norm;
+    float distance = glm::length(tangent);
+    float rollingRadius = 0.5f * scale;
+    if (distance < 1e-6f || rollingRadius <= 0.f) {
+        return;
+    }
+    glm::vec3 rotAxis = glm::cross(norm, tangent) / distance;
+    glm::quat rot = glm::angleAxis(distance / rollingRadius, rotAxis);
+    orientation = glm::normalize(rot * orientation);
+}
+
+/** Compose the object-to-world matrix from the fruit's position, orientation, and scale */
+glm::mat4 FruitTransformation::getTransform() const {
+    return glm::translate(glm::mat4(1.f), pos)
+            * glm::toMat4(orientation)
+            * glm::scale(glm::mat4(1.f), glm::vec3(scale));
+}
+
+/** Pack the fruit's transform for upload as per-instance vertex attributes */
+FruitInstanceData FruitTransformation::getInstanceData() const {
+    FruitInstanceData data;
+    data.translationScale = glm::vec4(pos, scale);
+    data.orientation = orientation;
+    return data;
 }
@@ -14,10 +14,20 @@ const float mu = 0.5;
 const float g = -.98;
 const float fruit_radius = .15;
 
+/**
+ *  Compact per-instance transform for a fruit, uploaded to the GPU instead of a full mat4.
+ *  Translation and uniform scale share one vec4, the orientation quaternion fills the other,
+ *  for 32 bytes per fruit.
+ */
+struct FruitInstanceData {
+    glm::vec4 translationScale;
+    glm::quat orientation;
+};
+
 class FruitTransformation
 {
 public:
-    FruitTransformation(glm::vec3 start_pos);
+    FruitTransformation(glm::mat4 startTransform);
     ~FruitTransformation();
 
     bool m_isFalling;
@@ -25,10 +35,15 @@ public:
 
     glm::vec3 pos;
     glm::vec3 vel;
+    glm::quat orientation;
+    float scale;
 
+    bool updatePosition(Terrain &terr);
+    glm::mat4 getTransform() const;
+    FruitInstanceData getInstanceData() const;
 
-    glm::mat4 updatePosition(std::unique_ptr<Terrain> &terr);
-    void setPos(glm::vec3 start_pos);
+private:
+    void integrateRolling(glm::vec3 displacement, glm::vec3 norm);
 };
 
 #endif // FRUITTRANSFORMATION_H
@@ -25,8 +25,10 @@ void MeshGenerator::generateTree() {
     // Clear old tree
     m_primitives.clear();
     m_transformations.clear();
+    m_sway.clear();
     m_fruitPrimitives.clear();
     m_fruitTransformations.clear();
+    m_fruitSway.clear();
     // Convert to mesh
     parseLSystem(lSystemString);
 }
@@ -36,6 +38,9 @@ void MeshGenerator::parseLSystem(std::string lSystemString) {
     // Stacks for storing transformation matrices
     std::stack<glm::mat4> baseCtmStack;
     std::stack<glm::mat4> branchCtmStack;
+    // Stacks for the wind sway of the parent chain and its phase
+    std::stack<SwayInstanceData> swayStack;
+    std::stack<float> swayPhaseStack;
     // Cumulative transformation matrix for current tree part
     glm::mat4 baseCtm = glm::mat4(1.0f);
     // Branches require additional scaling to get progressively smaller
@@ -44,6 +49,9 @@ void MeshGenerator::parseLSystem(std::string lSystemString) {
     glm::vec3 branchVector = glm::vec3(0, 1, 0);
     // Track recursive depth for leaves/fruit
     int recursiveDepth = 0;
+    // Sway of every branch from the trunk up to the current one
+    SwayInstanceData sway;
+    float swayPhase = 0.f;
     for (int i = 0; i < lSystemString.length(); i++) {
         // Rotation around y-axis
         glm::mat4 yRotate;
@@ -70,6 +78,8 @@ void MeshGenerator::parseLSystem(std::string lSystemString) {
             recursiveDepth++;
             baseCtmStack.push(baseCtm);
             branchCtmStack.push(branchCtm);
+            swayStack.push(sway);
+            swayPhaseStack.push(swayPhase);
             break;
         case ']':
             recursiveDepth--;
@@ -82,26 +92,38 @@ void MeshGenerator::parseLSystem(std::string lSystemString) {
                 baseCtmStack.pop();
                 branchCtm = branchCtmStack.top();
                 branchCtmStack.pop();
+                sway = swayStack.top();
+                swayStack.pop();
+                swayPhase = swayPhaseStack.top();
+                swayPhaseStack.pop();
             }
             break;
-        case 'F':
+        case 'F': {
+            // The branch rotates about its base, on top of the sway of every branch below it
+            swayPhase += getSwayPhaseOffset();
+            glm::vec3 pivot = glm::vec3(baseCtm[3]);
+            sway = sway.withLevel(pivot, baseSwayAmplitude * pow(swayDepthGain, recursiveDepth),
+                                  swayPhase);
             // Add branch to mesh
-            addPrimitive(*m_trunk, branchCtm * m_trunkPreTransform);
+            addPrimitive(*m_trunk, branchCtm * m_trunkPreTransform, sway);
             // Add fruit to mesh based on fruit density
             bool canAddFruit = recursiveDepth > minFruitRecursiveDepth
                     && recursiveDepth < maxFruitRecursiveDepth;
             if (canAddFruit && randomFloat() <= baseFruitDensity * settings.fruitDensity) {
                 glm::mat4 fruitCtm = m_fruitPostTransform * baseCtm * m_fruitPreTransform;
-                addFruitPrimitive(*m_fruit, fruitCtm);
+                addFruitPrimitive(*m_fruit, fruitCtm, sway.withLevel(
+                                      pivot, fruitSwayAmplitude, swayPhase + getSwayPhaseOffset()));
             }
             // Add leaves to mesh based on leaf density
             bool canAddLeaves = recursiveDepth > minLeafRecursiveDepth
                     && recursiveDepth < maxLeafRecursiveDepth;
             if (canAddLeaves && randomFloat() <= settings.leafDensity) {
                 glm::mat4 leafCtm = baseCtm * m_leafPreTransform;
-                addPrimitive(*m_leaf, leafCtm);
+                SwayInstanceData leafSway = sway.withLevel(
+                            pivot, leafSwayAmplitude, swayPhase + getSwayPhaseOffset());
+                addPrimitive(*m_leaf, leafCtm, leafSway);
                 glm::mat4 leafCtmRotated = leafCtm * getYRotateAnglePlus();
-                addPrimitive(*m_leaf, leafCtmRotated);
+                addPrimitive(*m_leaf, leafCtmRotated, leafSway);
             }
             // Update branch direction and size based on new ctm
             branchVector = glm::vec3(branchCtm * glm::vec4(0, 1, 0, 0));
@@ -111,6 +133,7 @@ void MeshGenerator::parseLSystem(std::string lSystemString) {
             branchCtm = translate * branchCtm;
             break;
         }
+        }
     }
 }
 
@@ -207,18 +230,26 @@ float MeshGenerator::getBranchLength() {
 }
 
 
-/** Add a primitive along with its cumulative transformation matrix */
+/** Return a random phase offset of a branch relative to its parent */
+float MeshGenerator::getSwayPhaseOffset() {
+    return randomFloat() * swayPhaseSpread;
+}
+
+
+/** Add a primitive along with its cumulative transformation matrix and wind sway */
 void MeshGenerator::addPrimitive(CS123ScenePrimitive scenePrimitive,
-                                 glm::mat4 transformation) {
+                                 glm::mat4 transformation, SwayInstanceData sway) {
     m_primitives.push_back(scenePrimitive);
     m_transformations.push_back(transformation);
+    m_sway.push_back(sway);
 }
 
-/** Add a fruit primitive along with its cumulative transformation matrix */
+/** Add a fruit primitive along with its cumulative transformation matrix and wind sway */
 void MeshGenerator::addFruitPrimitive(CS123ScenePrimitive fruitPrimitive,
-                                 glm::mat4 fruitTransformation) {
+                                 glm::mat4 fruitTransformation, SwayInstanceData sway) {
     m_fruitPrimitives.push_back(fruitPrimitive);
     m_fruitTransformations.push_back(fruitTransformation);
+    m_fruitSway.push_back(sway);
 }
 
 /** Return the vector of primitives */
@@ -240,3 +271,41 @@ std::vector<CS123ScenePrimitive> MeshGenerator::getFruitPrimitives() {
 std::vector<glm::mat4> MeshGenerator::getFruitTransformations() {
     return m_fruitTransformations;
 }
+
+/** Return the wind sway of each primitive */
+std::vector<SwayInstanceData> MeshGenerator::getSway() {
+    return m_sway;
+}
+
+/** Return the wind sway of each fruit */
+std::vector<SwayInstanceData> MeshGenerator::getFruitSway() {
+    return m_fruitSway;
+}
+
+
+SwayInstanceData::SwayInstanceData() :
+    cosTerms(0.f),
+    sinTerms(0.f)
+{
+}
+
+SwayInstanceData SwayInstanceData::withLevel(glm::vec3 pivot, float amplitude, float phase) const {
+    SwayInstanceData result = *this;
+    float c = amplitude * cos(phase);
+    float s = amplitude * sin(phase);
+    result.cosTerms += glm::vec4(c * pivot, c);
+    result.sinTerms += glm::vec4(s * pivot, s);
+    return result;
+}
+
+/** Translating the part translates every pivot, which shifts the pivot sums by the angle sums */
+SwayInstanceData SwayInstanceData::translated(glm::vec3 offset) const {
+    SwayInstanceData result = *this;
+    result.cosTerms += glm::vec4(cosTerms.w * offset, 0.f);
+    result.sinTerms += glm::vec4(sinTerms.w * offset, 0.f);
+    return result;
+}
+
+bool SwayInstanceData::isSwaying() const {
+    return cosTerms.w != 0.f || sinTerms.w != 0.f;
+}
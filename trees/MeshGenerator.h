@@ -22,6 +22,39 @@ const float thetaMinus = 0.3 * pi;
 const float baseXRotation = 0.3;
 // Amount to scale x, z size of each successive iteration
 const float branchWidthDecay = 0.7;
+// Angular sway amplitude of the trunk in the wind, in radians
+const float baseSwayAmplitude = 0.01;
+// Each branching level sways this much more than the branch it grows from
+const float swayDepthGain = 1.2;
+// Largest phase offset between a branch and its parent
+const float swayPhaseSpread = 0.6;
+// Angular flutter amplitude of leaves and fruit about their attachment point
+const float leafSwayAmplitude = 0.15;
+const float fruitSwayAmplitude = 0.08;
+
+/**
+ *  Per-instance wind sway coefficients for one tree part.
+ *
+ *  Every branch level k from the trunk down to the part rotates about its pivot p_k by
+ *  theta_k(t) = A_k * sin(wt + phi_k). For small angles the displacement of a point x is
+ *  cross(axis, sum_k theta_k(t) * (x - p_k)), and expanding the sine splits every sum into a
+ *  sin(wt) and a cos(wt) term. Storing those four sums lets the vertex shader bend the whole
+ *  parent chain exactly while each instance carries only two vec4s, and children stay
+ *  attached because their pivot's terms cancel at the pivot.
+ */
+struct SwayInstanceData {
+    // xyz: sum of A_k cos(phi_k) p_k, w: sum of A_k cos(phi_k)
+    glm::vec4 cosTerms;
+    // xyz: sum of A_k sin(phi_k) p_k, w: sum of A_k sin(phi_k)
+    glm::vec4 sinTerms;
+
+    SwayInstanceData();
+    // Add a level rotating about pivot with the given amplitude and phase
+    SwayInstanceData withLevel(glm::vec3 pivot, float amplitude, float phase) const;
+    // The same sway after the part has been translated by offset
+    SwayInstanceData translated(glm::vec3 offset) const;
+    bool isSwaying() const;
+};
 
 class MeshGenerator
 {
@@ -32,6 +65,8 @@ public:
     std::vector<glm::mat4> getTransformations();
     std::vector<CS123ScenePrimitive> getFruitPrimitives();
     std::vector<glm::mat4> getFruitTransformations();
+    std::vector<SwayInstanceData> getSway();
+    std::vector<SwayInstanceData> getFruitSway();
 private:
     std::unique_ptr<LSystem> m_lSystem;
     void initializeLSystem();
@@ -51,18 +86,23 @@ private:
     glm::mat4 m_fruitPostTransform;
     void initializeFruitPrimitive();
 
-    void addPrimitive(CS123ScenePrimitive scenePrimitive, glm::mat4 transformation);
+    void addPrimitive(CS123ScenePrimitive scenePrimitive, glm::mat4 transformation,
+                      SwayInstanceData sway);
     std::vector<CS123ScenePrimitive> m_primitives;
     std::vector<glm::mat4> m_transformations;
+    std::vector<SwayInstanceData> m_sway;
     // We store fruits separately because they use a different shader for physics effects
-    void addFruitPrimitive(CS123ScenePrimitive scenePrimitive, glm::mat4 transformation);
+    void addFruitPrimitive(CS123ScenePrimitive scenePrimitive, glm::mat4 transformation,
+                           SwayInstanceData sway);
     std::vector<CS123ScenePrimitive> m_fruitPrimitives;
     std::vector<glm::mat4> m_fruitTransformations;
+    std::vector<SwayInstanceData> m_fruitSway;
 
     float getYRotateAnglePlus();
     float getYRotateAngleMinus();
     float getXRotateAngle();
     float getBranchLength();
+    float getSwayPhaseOffset();
 };
 
 #endif // MESHGENERATOR_H
@@ -77,12 +77,11 @@ glm::vec3 Terrain::getNormal(int row, int col)
     // TODO: Compute the normal at the given row and column using the positions
     //       of the neighboring vertices.
 
-    std::vector<glm::vec3> points;
+    glm::vec3 points[8];
     glm::vec3 normal_sum = glm::vec3(0, 0, 0);
 
     glm::vec3 p1 = getPosition(row, col);
 
-    points.reserve(8);
     for (int i = 1; i > -2; i--){
         points[1 - i] = getPosition(row - 1, col + i) - p1;
     }
@@ -146,6 +145,29 @@ glm::vec3 Terrain::getNormalFromWorld(glm::vec3 pos){
     //return getNormal(r1, c1);
 }
 
+std::vector<float> Terrain::getHeights() {
+    std::vector<float> heights;
+    heights.reserve(m_numRows * m_numCols);
+    for (int row = 0; row < m_numRows; row++) {
+        for (int col = 0; col < m_numCols; col++) {
+            heights.push_back(getPosition(row, col).y);
+        }
+    }
+    return heights;
+}
+
+int Terrain::getNumRows() {
+    return m_numRows;
+}
+
+int Terrain::getNumCols() {
+    return m_numCols;
+}
+
+float Terrain::getHalfExtent() {
+    return m_numRows / scale;
+}
+
 /**
  * Initializes the terrain by storing positions and normals in a vertex buffer.
  */
@@ -25,6 +25,13 @@ public:
     float getHeightFromWorld(glm::vec3 pos);
     glm::vec3 getNormalFromWorld(glm::vec3 pos);
 
+    // Vertex heights row by row, for building a RayHeightfield over the same grid
+    std::vector<float> getHeights();
+    int getNumRows();
+    int getNumCols();
+    // The grid spans [-halfExtent, halfExtent) in x and z
+    float getHalfExtent();
+
 private:
     float randValue(int row, int col);
     glm::vec3 getPosition(int row, int col);
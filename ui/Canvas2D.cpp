@@ -61,10 +61,23 @@ void Canvas2D::setScene(RayScene *scene) {
 
 void Canvas2D::renderImage(CS123SceneCameraData *camera, int width, int height) {
     if (m_rayScene) {
-        m_rayScene->renderRayScene(this, camera, width, height);
+        resize(width, height);
+        RayImageTarget target(data(), width, height, true);
+        m_rayScene->setCollectStats(settings.useRayStats);
+        m_rayScene->renderRayScene(camera, target, [this]() {
+            update();
+            QCoreApplication::processEvents();
+        });
     }
 }
 
+std::string Canvas2D::getRenderStats() const {
+    if (!m_rayScene) {
+        return std::string();
+    }
+    return m_rayScene->getStats().toString();
+}
+
 void Canvas2D::cancelRender() {
     if (m_rayScene) {
         m_rayScene->stopRendering();
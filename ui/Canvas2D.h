@@ -2,6 +2,7 @@
 #define CANVAS2D_H
 
 #include <memory>
+#include <string>
 
 #include "SupportCanvas2D.h"
 
@@ -23,6 +24,9 @@ public:
     // UI will call this from the button on the "Ray" dock
     void renderImage(CS123SceneCameraData *camera, int width, int height);
 
+    // Summary of the ray tracer's statistics for the last render, if settings.useRayStats was on
+    std::string getRenderStats() const;
+
     // This will be called when the settings have changed
     virtual void settingsChanged();
 
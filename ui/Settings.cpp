@@ -32,6 +32,7 @@ void Settings::loadSettingsOrDefaults() {
     fruitDensity = s.value("fruitDensity", 0.7).toDouble();
     leafDensity = s.value("leafDensity", 1.0).toDouble();
     branchStochasticity = s.value("branchStochasticity", 0.5).toDouble();
+    useGPUPicking = s.value("useGPUPicking", false).toBool();
 
     // Brush
     brushType = s.value("brushType", BRUSH_LINEAR).toInt();
@@ -78,6 +79,7 @@ void Settings::loadSettingsOrDefaults() {
     useDirectionalLights = s.value("useDirectionalLights", true).toBool();
     useSpotLights = s.value("useSpotLights", true).toBool();
     useKDTree = s.value("useKDTree", true).toBool();
+    useRayStats = s.value("useRayStats", false).toBool();
 
     currentTab = s.value("currentTab", TAB_2D).toBool();
 
@@ -96,6 +98,7 @@ void Settings::saveSettings() {
 
     // Tree scene
     s.setValue("recursionDepth", recursionDepth);
+    s.setValue("useGPUPicking", useGPUPicking);
 
     // Brush
     s.setValue("brushType", brushType);
@@ -141,6 +144,7 @@ void Settings::saveSettings() {
     s.setValue("useDirectionalLights", useDirectionalLights);
     s.setValue("useSpotLights", useSpotLights);
     s.setValue("useKDTree", useKDTree);
+    s.setValue("useRayStats", useRayStats);
 
     s.setValue("currentTab", currentTab);
 }
@@ -87,6 +87,7 @@ struct Settings {
     float fruitDensity;
     float leafDensity;
     float branchStochasticity;
+    bool useGPUPicking;         // Pick fruit by reading back an ID buffer instead of ray casting
 
     // Brush
     int brushType;      // The user's selected brush @see BrushType
@@ -140,6 +141,7 @@ struct Settings {
     bool useDirectionalLights;  // Enable or disable directional lighting (extra credit).
     bool useSpotLights;         // Enable or disable spot lights (extra credit).
     bool useKDTree;
+    bool useRayStats;           // Count rays and time tiles, and show the results after a render.
 
     int getSceneMode();
     int getCameraMode();
@@ -11,6 +11,7 @@
 #include <math.h>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QSettings>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -141,6 +142,7 @@ void MainWindow::dataBind() {
     BIND(FloatBinding::bindSliderAndTextbox(
              ui->branchStochSlider, ui->branchStochTextbox,
              settings.branchStochasticity, 0.f, 1.f))
+    BIND(BoolBinding::bindCheckbox(ui->useGPUPickingCheckbox, settings.useGPUPicking))
 
     // Camtrans dock
     BIND(BoolBinding::bindCheckbox(ui->cameraOrbitCheckbox, settings.useOrbitCamera))
@@ -172,6 +174,7 @@ void MainWindow::dataBind() {
     BIND(BoolBinding::bindCheckbox(ui->raySpotLights,            settings.useSpotLights))
     BIND(BoolBinding::bindCheckbox(ui->rayMultiThreading,        settings.useMultiThreading))
     BIND(BoolBinding::bindCheckbox(ui->rayUseKDTree,             settings.useKDTree))
+    BIND(BoolBinding::bindCheckbox(ui->rayStatistics,            settings.useRayStats))
 
     BIND(ChoiceBinding::bindTabs(ui->tabWidget, settings.currentTab))
 
@@ -336,6 +339,10 @@ void MainWindow::renderImage() {
         CS123SceneCameraData camera;
         m_sceneParser->getCameraData(camera);
         ui->canvas2D->renderImage(&camera, activeTabSize.width(), activeTabSize.height());
+        if (settings.useRayStats) {
+            std::string stats = ui->canvas2D->getRenderStats();
+            QMessageBox::information(this, "Render statistics", QString::fromStdString(stats));
+        }
 
         // Swap the "stop rendering" button for the "render" button
         ui->rayRenderButton->setHidden(false);